@@ -0,0 +1,194 @@
+/* arena - linear allocators for load time and per frame scratch memory, freed all at once */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_DEFAULT_BLOCK 65536
+#define ARENA_MAX_STATS 32
+
+struct ArenaBlock {
+	struct ArenaBlock *next;
+	size_t size;	// bytes after the header
+	size_t offset;	// bytes used
+	size_t pad;	// keeps the data ARENA_ALIGN aligned
+};
+
+struct ArenaStats {
+	const char *name;
+	size_t peak;
+	size_t blocks;	// most blocks one arena of this name needed
+	int uses;	// resets and frees
+};
+
+struct Arena frameArena = { "frame", 0, 0, 0, 0, 0, 0 };
+
+// guarded by statsLock,  arenas themselves belong to one thread at a time.
+static struct ArenaStats stats[ARENA_MAX_STATS];
+static int statsCount = 0;
+static SDL_SpinLock statsLock = 0;
+
+static inline unsigned char *blockData(struct ArenaBlock *block)
+{
+	return (unsigned char *)(block + 1);
+}
+
+static size_t alignSize(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void initArena(struct Arena *arena, const char *name, unsigned int blockSize)
+{
+	memset(arena, 0, sizeof(*arena));
+	arena->name = name;
+	arena->blockSize = blockSize;
+}
+
+static struct ArenaBlock *newBlock(struct Arena *arena, size_t size)
+{
+	size_t blockSize = arena->blockSize ? arena->blockSize : ARENA_DEFAULT_BLOCK;
+	if(size < blockSize) size = blockSize;
+	struct ArenaBlock *block = (struct ArenaBlock *)malloc(sizeof(struct ArenaBlock) + size);
+	if(!block) {
+		printf("*** Out of memory growing arena %s by %lu bytes\n", arena->name ? arena->name : "?", (unsigned long)size);
+		exit(1);
+	}
+	block->next = 0;
+	block->size = size;
+	block->offset = 0;
+	return block;
+}
+
+void *arenaAlloc(struct Arena *arena, size_t size)
+{
+	size = alignSize(size ? size : 1);
+	struct ArenaBlock *block = arena->current;
+	if(!block || block->offset + size > block->size) {
+		// the blocks after current are free since the last reset or rewind,  use the next if it fits.
+		struct ArenaBlock *next = block ? block->next : arena->first;
+		if(!next || next->size < size) {
+			struct ArenaBlock *fresh = newBlock(arena, size);
+			fresh->next = next;
+			if(block) block->next = fresh;
+			else arena->first = fresh;
+			next = fresh;
+		}
+		next->offset = 0;
+		block = arena->current = next;
+	}
+	void *p = blockData(block) + block->offset;
+	block->offset += size;
+	arena->used += size;
+	if(arena->used > arena->peak) arena->peak = arena->used;
+	arena->last = p;
+	return p;
+}
+
+void *arenaCalloc(struct Arena *arena, size_t size)
+{
+	void *p = arenaAlloc(arena, size);
+	memset(p, 0, size);
+	return p;
+}
+
+// Doubles like growArray.  The newest allocation grows where it is when the block has room.
+void *arenaGrow(struct Arena *arena, void *array, int *max, int count, int size)
+{
+	if(count < *max) return array;
+	int newMax = *max < 16 ? 16 : *max * 2;
+	struct ArenaBlock *block = arena->current;
+	if(array && array == arena->last) {
+		size_t oldSize = alignSize((size_t)*max * size), newSize = alignSize((size_t)newMax * size);
+		if(block->offset - oldSize + newSize <= block->size) {
+			block->offset += newSize - oldSize;
+			arena->used += newSize - oldSize;
+			if(arena->used > arena->peak) arena->peak = arena->used;
+			*max = newMax;
+			return array;
+		}
+	}
+	void *grown = arenaAlloc(arena, (size_t)newMax * size);
+	if(array) memcpy(grown, array, (size_t)*max * size);
+	*max = newMax;
+	return grown;
+}
+
+struct ArenaMark arenaMark(struct Arena *arena)
+{
+	struct ArenaMark mark = { arena->current, arena->current ? arena->current->offset : 0, arena->used };
+	return mark;
+}
+
+void arenaRewind(struct Arena *arena, struct ArenaMark mark)
+{
+	arena->current = mark.block;
+	if(mark.block) mark.block->offset = mark.offset;
+	arena->used = mark.used;
+	arena->last = 0;
+}
+
+static void noteArena(struct Arena *arena)
+{
+	struct ArenaBlock *block;
+	size_t blocks = 0;
+	int i;
+	for(block = arena->first; block; block = block->next) blocks++;
+	if(!arena->name || (!arena->peak && !blocks)) return;
+	SDL_AtomicLock(&statsLock);
+	for(i = 0; i < statsCount && strcmp(stats[i].name, arena->name) != 0; i++);
+	if(i == statsCount && statsCount < ARENA_MAX_STATS) {
+		memset(stats + i, 0, sizeof(stats[i]));
+		stats[i].name = arena->name;
+		statsCount++;
+	}
+	if(i < statsCount) {
+		if(stats[i].peak < arena->peak) stats[i].peak = arena->peak;
+		if(stats[i].blocks < blocks) stats[i].blocks = blocks;
+		stats[i].uses++;
+	}
+	SDL_AtomicUnlock(&statsLock);
+}
+
+void resetArena(struct Arena *arena)
+{
+	noteArena(arena);
+	arena->current = 0;
+	arena->used = 0;
+	arena->last = 0;
+	// one block that would have held the lot next time,  rather than a chain of small ones.
+	if(arena->first && arena->first->next) {
+		size_t peak = arena->peak;
+		freeArena(arena);
+		arena->peak = peak;
+		arena->first = newBlock(arena, alignSize(peak));
+	}
+}
+
+void freeArena(struct Arena *arena)
+{
+	if(arena->current || arena->used) noteArena(arena);
+	struct ArenaBlock *block = arena->first;
+	while(block) {
+		struct ArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->first = arena->current = 0;
+	arena->used = arena->peak = 0;
+	arena->last = 0;
+}
+
+void reportArenas()
+{
+	int i;
+	SDL_AtomicLock(&statsLock);
+	for(i = 0; i < statsCount; i++) {
+		printf("arena %-10s peak %8.1f KB in %lu blocks over %d uses\n", stats[i].name, stats[i].peak / 1024.0, (unsigned long)stats[i].blocks, stats[i].uses);
+	}
+	SDL_AtomicUnlock(&statsLock);
+}
@@ -0,0 +1,31 @@
+/* Arenas */
+#ifndef ARENA_H
+#define ARENA_H
+
+// arena.c
+struct ArenaBlock;
+struct Arena {
+	const char *name;	// stats are kept per name, so every load arena adds up under one
+	struct ArenaBlock *first;	// blocks are kept for reuse after a reset
+	struct ArenaBlock *current;
+	unsigned int blockSize;	// smallest block to grab from malloc
+	size_t used;	// bytes handed out since the last reset
+	size_t peak;	// high water mark of used
+	void *last;	// most recent allocation, which arenaGrow can extend in place
+};
+struct ArenaMark {
+	struct ArenaBlock *block;
+	size_t offset;
+	size_t used;
+};
+extern struct Arena frameArena;	// per frame scratch for the GL thread, reset at the top of each frame
+void initArena(struct Arena *arena, const char *name, unsigned int blockSize);	// or zero it and set name, blocks default to 64 KB
+void *arenaAlloc(struct Arena *arena, size_t size);	// 16 byte aligned, exits if out of memory like growArray
+void *arenaCalloc(struct Arena *arena, size_t size);
+void *arenaGrow(struct Arena *arena, void *array, int *max, int count, int size);	// growArray for arena memory, the old copy isn't reclaimed until a reset
+struct ArenaMark arenaMark(struct Arena *arena);
+void arenaRewind(struct Arena *arena, struct ArenaMark mark);	// give back everything allocated since the mark
+void resetArena(struct Arena *arena);	// everything at once, the blocks stay for next time
+void freeArena(struct Arena *arena);	// blocks go back to malloc
+void reportArenas();	// high water marks so far, by name
+#endif
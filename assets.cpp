@@ -0,0 +1,149 @@
+/* assets - reference counted registry so that models share the images, materials and meshes they have in common */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets.h"
+
+struct Asset {
+	int kind;
+	char path[256];
+	unsigned long long hash;	// of the file contents, 0 if not known
+	void *data;
+	int refs;
+	void (*release)(void *data);
+};
+
+// guarded by assetLock,  loading itself happens outside it.
+static struct Asset *asset = 0;
+static int assetCount = 0;
+static int assetMax = 0;
+static SDL_SpinLock assetLock = 0;
+
+static struct Asset *lookupAsset(int kind, const char *path, unsigned long long hash)
+{
+	int i;
+	if(path) {
+		for(i = 0; i < assetCount; i++) {
+			if(asset[i].kind == kind && strcmp(asset[i].path, path) == 0) return asset + i;
+		}
+	}
+	if(hash) {
+		for(i = 0; i < assetCount; i++) {
+			if(asset[i].kind == kind && asset[i].hash == hash) return asset + i;
+		}
+	}
+	return 0;
+}
+
+static struct Asset *lookupData(void *data)
+{
+	int i;
+	for(i = 0; i < assetCount; i++) {
+		if(asset[i].data == data) return asset + i;
+	}
+	return 0;
+}
+
+void *findAsset(int kind, const char *path, unsigned long long hash)
+{
+	void *data = 0;
+	SDL_AtomicLock(&assetLock);
+	struct Asset *a = lookupAsset(kind, path, hash);
+	if(a) {
+		a->refs++;
+		data = a->data;
+	}
+	SDL_AtomicUnlock(&assetLock);
+	return data;
+}
+
+void *addAsset(int kind, const char *path, unsigned long long hash, void *data, void (*release)(void *data))
+{
+	SDL_AtomicLock(&assetLock);
+	// two loads of the same thing can race,  the first to get here wins.
+	struct Asset *a = lookupAsset(kind, path, hash);
+	if(a) {
+		a->refs++;
+		data = a->data;
+		SDL_AtomicUnlock(&assetLock);
+		return data;
+	}
+	if(assetCount == assetMax) {
+		assetMax = assetMax < 64 ? 64 : assetMax * 2;
+		asset = (struct Asset *)realloc(asset, sizeof(struct Asset) * assetMax);
+	}
+	a = asset + assetCount++;
+	a->kind = kind;
+	snprintf(a->path, sizeof(a->path), "%s", path ? path : "");
+	a->hash = hash;
+	a->data = data;
+	a->refs = 1;
+	a->release = release;
+	SDL_AtomicUnlock(&assetLock);
+	return data;
+}
+
+void retainAsset(void *data)
+{
+	SDL_AtomicLock(&assetLock);
+	struct Asset *a = lookupData(data);
+	if(a) a->refs++;
+	SDL_AtomicUnlock(&assetLock);
+}
+
+int releaseAsset(void *data)
+{
+	void (*release)(void *data) = 0;
+	int refs = -1;
+	SDL_AtomicLock(&assetLock);
+	struct Asset *a = lookupData(data);
+	if(a) {
+		refs = --a->refs;
+		if(refs == 0) {
+			release = a->release;
+			*a = asset[--assetCount];
+		}
+	}
+	SDL_AtomicUnlock(&assetLock);
+	if(release) release(data);
+	return refs;
+}
+
+void updateAsset(void *data, const char *path, unsigned long long hash)
+{
+	SDL_AtomicLock(&assetLock);
+	struct Asset *a = lookupData(data);
+	if(a) {
+		snprintf(a->path, sizeof(a->path), "%s", path ? path : "");
+		a->hash = hash;
+	}
+	SDL_AtomicUnlock(&assetLock);
+}
+
+int listAssets(int kind, void **data, int maxData)
+{
+	int i, count = 0;
+	SDL_AtomicLock(&assetLock);
+	for(i = 0; i < assetCount; i++) {
+		if(asset[i].kind != kind) continue;
+		if(count < maxData) data[count] = asset[i].data;
+		count++;
+	}
+	SDL_AtomicUnlock(&assetLock);
+	return count;
+}
+
+void reportAssets()
+{
+	static const char *kindName[] = { "image", "materials", "mesh" };
+	int i;
+	SDL_AtomicLock(&assetLock);
+	printf("%d assets loaded\n", assetCount);
+	for(i = 0; i < assetCount; i++) {
+		printf("  %-10s %3d refs  %016llx  %s\n", kindName[asset[i].kind], asset[i].refs, asset[i].hash, asset[i].path);
+	}
+	SDL_AtomicUnlock(&assetLock);
+}
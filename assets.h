@@ -0,0 +1,16 @@
+/* Assets */
+#ifndef ASSETS_H
+#define ASSETS_H
+
+// assets.c
+#define ASSET_IMAGE 0
+#define ASSET_MATERIALS 1	// a parsed .mtl
+#define ASSET_MESH 2	// a WavefrontMesh, shared by the WavefrontModels loaded from it
+void *findAsset(int kind, const char *path, unsigned long long hash);	// adds a reference, matches path or else a nonzero content hash, 0 if not loaded
+void *addAsset(int kind, const char *path, unsigned long long hash, void *data, void (*release)(void *data));	// registers data with one reference, or returns the copy someone else registered first
+void retainAsset(void *data);
+int releaseAsset(void *data);	// calls release when the last reference goes, returns the references left or -1 if data isn't registered
+void updateAsset(void *data, const char *path, unsigned long long hash);	// after a reload, path 0 and hash 0 hide it from findAsset while its references last
+int listAssets(int kind, void **data, int maxData);	// no references added, returns how many even past maxData
+void reportAssets();
+#endif
@@ -0,0 +1,1035 @@
+/* bench - timing runs for the loaders and renderer, started with -bench on the command line */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if !defined(_WIN32) && !defined(_PSP)
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include "main.h"
+#include "wavefront.h"
+#include "bench.h"
+#include "jobs.h"
+#include "bvh.h"
+#include "upload.h"
+#include "arena.h"
+#include "pack.h"
+#include "glprocs.h"
+#include "cull.h"
+#include "hiz.h"
+
+static const char *benchModels[] = { "utrench", "tumtum", "trenchrun", "minimaltrenchsphere", 0 };
+
+double benchTime()
+{
+	return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// best of several runs, in ms.  -1 if the model didn't load.
+static double benchLoadModel(const char *name, int flags, int runs)
+{
+	int oldFlags = wavefrontLoadFlags;
+	double best = -1;
+	int i;
+
+	wavefrontLoadFlags = flags;
+	for(i = 0; i < runs; i++) {
+		double start = benchTime();
+		struct WavefrontModel *model = loadWavefront(name);
+		double elapsed = benchTime() - start;
+		if(!model) break;
+		freeWavefront(model);
+		if(best < 0 || elapsed < best) best = elapsed;
+	}
+	wavefrontLoadFlags = oldFlags;
+	return best;
+}
+
+// -bench load [model...]: old two pass sscanf parser against the single pass parser.
+// Textures are skipped so that only the obj/mtl parsing is timed.
+static void benchLoad(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	double before[32], after[32];
+	int count = argc;
+	int i;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		before[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_LEGACY_PARSER, 5);
+		after[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE, 5);
+	}
+	// the loaders are chatty, so the table goes at the end.
+	printf("\n%-24s %12s %12s %8s\n", "model", "two pass", "single pass", "speedup");
+	for(i = 0; i < count; i++) {
+		if(before[i] < 0 || after[i] < 0) printf("%-24s %12s\n", models[i], "not found");
+		else printf("%-24s %9.2f ms %9.2f ms %7.2fx\n", models[i], before[i], after[i], before[i] / after[i]);
+	}
+}
+
+struct BenchMemory {
+	long minorFaults, majorFaults;
+	long residentKb, peakKb;
+};
+
+static void benchMemory(struct BenchMemory *mem)
+{
+	memset(mem, 0, sizeof(*mem));
+#if !defined(_WIN32) && !defined(_PSP)
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	mem->minorFaults = usage.ru_minflt;
+	mem->majorFaults = usage.ru_majflt;
+	mem->peakKb = usage.ru_maxrss;
+#endif
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/statm", "r");
+	long size = 0, resident = 0;
+	if(file) {
+		if(fscanf(file, "%ld %ld", &size, &resident) == 2) mem->residentKb = resident * (getpagesize() / 1024);
+		fclose(file);
+	}
+#endif
+}
+
+// -bench mmap [model...]: page faults and resident memory for buffered reads against the mapped obj.
+// Peak RSS only ever grows, so the buffered run goes first and the mapped peak shows only if it is higher.
+static void benchMapping(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	const char *modeName[2] = { "buffered", "mmap" };
+	int modeFlags[2] = { WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_MMAP | WAVEFRONT_NO_CACHE, WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE };
+	struct BenchMemory result[32][2][2];
+	double elapsed[32][2];
+	int count = argc;
+	int i, mode;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		for(mode = 0; mode < 2; mode++) {
+			int oldFlags = wavefrontLoadFlags;
+			wavefrontLoadFlags = modeFlags[mode];
+			benchMemory(&result[i][mode][0]);
+			double start = benchTime();
+			struct WavefrontModel *model = loadWavefront(models[i]);
+			elapsed[i][mode] = model ? benchTime() - start : -1;
+			benchMemory(&result[i][mode][1]);
+			if(model) freeWavefront(model);
+			wavefrontLoadFlags = oldFlags;
+		}
+	}
+	printf("\n%-24s %-9s %10s %12s %12s %12s %12s\n", "model", "mode", "time", "minor flt", "major flt", "rss +kb", "peak +kb");
+	for(i = 0; i < count; i++) {
+		for(mode = 0; mode < 2; mode++) {
+			struct BenchMemory *before = &result[i][mode][0], *after = &result[i][mode][1];
+			if(elapsed[i][mode] < 0) {
+				printf("%-24s %-9s %10s\n", models[i], modeName[mode], "not found");
+				continue;
+			}
+			printf("%-24s %-9s %7.2f ms %12ld %12ld %12ld %12ld\n", models[i], modeName[mode], elapsed[i][mode],
+				after->minorFaults - before->minorFaults, after->majorFaults - before->majorFaults,
+				after->residentKb - before->residentKb, after->peakKb - before->peakKb);
+		}
+	}
+}
+
+// -bench threads [model...]: mapped obj parse time by number of parsing threads.
+static void benchThreads(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	int maxThreads = jobThreads() + 1;
+	int count = argc;
+	int i, threads;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	for(i = 0; i < count; i++) {
+		double serial = -1;
+		printf("\n%-24s %8s %12s %8s\n", models[i], "threads", "time", "speedup");
+		for(threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+			int oldThreads = wavefrontLoadThreads;
+			wavefrontLoadThreads = threads;
+			double elapsed = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE, 5);
+			wavefrontLoadThreads = oldThreads;
+			if(elapsed < 0) {
+				printf("%-24s %8s\n", "", "not found");
+				break;
+			}
+			if(threads == 1) serial = elapsed;
+			printf("%-24s %8d %9.2f ms %7.2fx\n", "", threads, elapsed, serial / elapsed);
+			if(threads == maxThreads) break;
+		}
+	}
+}
+
+// -bench cache [model...]: parsing the obj against mapping the compiled .mesh.
+// One full load first so that the cache exists and is current.
+static void benchCache(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	double parsed[32], cached[32];
+	int count = argc;
+	int i;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		parsed[i] = benchLoadModel(models[i], 0, 1);
+		if(parsed[i] < 0) continue;
+		parsed[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE, 5);
+		cached[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES, 5);
+	}
+	printf("\n%-24s %12s %12s %8s\n", "model", "parse", "cached", "speedup");
+	for(i = 0; i < count; i++) {
+		if(parsed[i] < 0) printf("%-24s %12s\n", models[i], "not found");
+		else printf("%-24s %9.2f ms %9.2f ms %7.2fx\n", models[i], parsed[i], cached[i], parsed[i] / cached[i]);
+	}
+}
+
+// -bench async [model...]: the models loaded one after another against all at once on the job threads.
+static void benchAsync(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	struct WavefrontModel *model[32];
+	struct WavefrontLoad *load[32];
+	int count = argc;
+	int i;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	int oldFlags = wavefrontLoadFlags;
+	wavefrontLoadFlags |= WAVEFRONT_NO_CACHE;
+	double start = benchTime();
+	for(i = 0; i < count; i++) model[i] = loadWavefront(models[i]);
+	double blocking = benchTime() - start;
+	for(i = 0; i < count; i++) freeWavefront(model[i]);
+
+	start = benchTime();
+	for(i = 0; i < count; i++) load[i] = loadWavefrontAsync(models[i]);
+	double queued = benchTime() - start, first = -1;
+	int left = count;
+	while(left > 0) {
+		pollWavefrontLoads();
+		for(i = 0; i < count; i++) {
+			if(!load[i]) continue;
+			model[i] = finishWavefrontLoad(load + i);
+			if(load[i]) continue;
+			if(first < 0) first = benchTime() - start;
+			left--;
+		}
+		SDL_Delay(1);
+	}
+	double async = benchTime() - start;
+	for(i = 0; i < count; i++) freeWavefront(model[i]);
+	wavefrontLoadFlags = oldFlags;
+	printf("\n%d models on %d job threads\n", count, jobThreads());
+	printf("%-24s %9.2f ms\n", "blocking", blocking);
+	printf("%-24s %9.2f ms\n", "async, queued in", queued);
+	printf("%-24s %9.2f ms\n", "async, first ready", first);
+	printf("%-24s %9.2f ms %7.2fx\n", "async, all ready", async, blocking / async);
+}
+
+// -bench upload [model...]: all of the models' textures uploaded in one go with glTexImage2D,  the way
+// uploadImage does it,  against streamed through runUploads.  Waits for the GPU after each step.
+static void benchUpload(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	struct WavefrontModel *model[32];
+	Image *image[256];
+	int count = argc, imageCount = 0, bytes = 0;
+	int i, j;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		model[i] = loadWavefront(models[i]);
+		Image *found[256];
+		int n = getWavefrontImages(model[i], found, 256);
+		for(j = 0; j < n && j < 256; j++) {
+			int k;
+			for(k = 0; k < imageCount && image[k] != found[j]; k++);
+			if(k == imageCount && imageCount < 256) image[imageCount++] = found[j];
+		}
+	}
+	for(i = 0; i < imageCount; i++) bytes += image[i]->textureWidth * image[i]->textureHeight * 4;
+
+	double total = 0, worst = 0;
+	for(i = 0; i < imageCount; i++) {
+		GLuint id;
+		double start = benchTime();
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D, id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image[i]->textureWidth, image[i]->textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, image[i]->data);
+		glFinish();
+		double elapsed = benchTime() - start;
+		total += elapsed;
+		if(worst < elapsed) worst = elapsed;
+		glDeleteTextures(1, &id);
+	}
+	printf("\n%d textures,  %.1f MB\n", imageCount, bytes / 1048576.0);
+	printf("%-24s %9.2f ms in one frame\n", "glTexImage2D", total);
+
+	for(i = 0; i < imageCount; i++) queueImageUpload(image[i]);
+	int frames = 0, queued, frameBytes;
+	double streamed = 0, bandwidth;
+	worst = 0;
+	for(;;) {
+		double start = benchTime();
+		int left = runUploads();
+		glFinish();
+		double elapsed = benchTime() - start;
+		streamed += elapsed;
+		if(worst < elapsed) worst = elapsed;
+		frames++;
+		if(!left) break;
+	}
+	getUploadStats(&queued, &frameBytes, &bandwidth);
+	printf("%-24s %9.2f ms over %d frames,  worst %.2f ms with a %.1f ms budget,  %.0f MB/s\n", "streamed", streamed, frames, worst, uploadBudget, bandwidth);
+	for(i = 0; i < count; i++) freeWavefront(model[i]);
+}
+
+// Draw the model a few times and return the best ms per draw,  waiting for the GPU each time.
+static double benchDrawModel(struct WavefrontModel *model, int runs)
+{
+	double best = -1;
+	int i;
+
+	drawWavefront(model);	// first draw uploads the textures
+	glFinish();
+	for(i = 0; i < runs; i++) {
+		double start = benchTime();
+		drawWavefront(model);
+		glFinish();
+		double elapsed = benchTime() - start;
+		if(best < 0 || elapsed < best) best = elapsed;
+	}
+	return best;
+}
+
+// -bench index [model...]: memory and draw rate for one vertex per corner,  the indexed mesh in file
+// order,  the indexed mesh reordered for the vertex cache and overdraw,  and that again quantized.
+static void benchIndex(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	const char *modeName[4] = { "corners", "indexed", "sorted", "packed" };
+	int modeFlags[4] = { WAVEFRONT_NO_CACHE | WAVEFRONT_NO_INDEX, WAVEFRONT_NO_CACHE | WAVEFRONT_NO_OPTIMIZE, WAVEFRONT_NO_CACHE,
+		WAVEFRONT_NO_CACHE | WAVEFRONT_QUANTIZE };
+	int verts[32][4], indices[32][4], bytes[32][4];
+	double elapsed[32][4];
+	int count = argc;
+	int i, mode;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		for(mode = 0; mode < 4; mode++) {
+			int oldFlags = wavefrontLoadFlags;
+			wavefrontLoadFlags = modeFlags[mode];
+			struct WavefrontModel *model = loadWavefront(models[i]);
+			wavefrontLoadFlags = oldFlags;
+			getWavefrontSize(model, &verts[i][mode], &indices[i][mode], &bytes[i][mode]);
+			elapsed[i][mode] = model ? benchDrawModel(model, 20) : -1;
+			if(model) freeWavefront(model);
+		}
+	}
+	printf("\n%-24s %-8s %10s %10s %10s %10s %12s\n", "model", "mode", "verts", "indices", "kb", "draw", "Mverts/s");
+	for(i = 0; i < count; i++) {
+		for(mode = 0; mode < 4; mode++) {
+			if(elapsed[i][mode] < 0) {
+				printf("%-24s %-8s %10s\n", models[i], modeName[mode], "not found");
+				continue;
+			}
+			int drawn = indices[i][mode] ? indices[i][mode] : verts[i][mode];
+			printf("%-24s %-8s %10d %10d %10d %7.2f ms %12.2f\n", models[i], modeName[mode], verts[i][mode], indices[i][mode],
+				bytes[i][mode] / 1024, elapsed[i][mode], elapsed[i][mode] > 0 ? drawn / (elapsed[i][mode] * 1000) : 0);
+		}
+	}
+}
+
+// -bench lod [model...]: triangles,  error and draw time for each level of detail.
+static void benchLod(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	int count = argc;
+	int i, level;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	for(i = 0; i < count; i++) {
+		int oldFlags = wavefrontLoadFlags, oldLevel = wavefrontLodLevel;
+		wavefrontLoadFlags = WAVEFRONT_NO_CACHE | WAVEFRONT_LODS;
+		struct WavefrontModel *model = loadWavefront(models[i]);
+		wavefrontLoadFlags = oldFlags;
+		printf("\n%-24s %6s %10s %10s %10s\n", models[i], "level", "triangles", "error", "draw");
+		if(!model) {
+			printf("%-24s %6s\n", "", "not found");
+			continue;
+		}
+		int triangles;
+		float error;
+		int levels = getWavefrontLod(model, 0, &triangles, &error);
+		for(level = 0; level <= levels; level++) {
+			getWavefrontLod(model, level, &triangles, &error);
+			wavefrontLodLevel = level;
+			double elapsed = benchDrawModel(model, 20);
+			printf("%-24s %6d %10d %10.4f %7.2f ms\n", "", level, triangles, error, elapsed);
+		}
+		wavefrontLodLevel = oldLevel;
+		freeWavefront(model);
+	}
+}
+
+static float benchRandom(unsigned int *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return (*seed >> 8) / 16777216.0f;
+}
+
+// -bench bvh [model...]: build time and cost per query for the collision BVH.
+static void benchBvh(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	const int rays = 100000;
+	int count = argc;
+	int i, j, k;
+
+	struct BvhRay *ray = (struct BvhRay *)malloc(sizeof(struct BvhRay) * rays);
+	struct BvhHit *hit = (struct BvhHit *)malloc(sizeof(struct BvhHit) * rays);
+	int triangle[256];
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	for(i = 0; i < count; i++) {
+		int oldFlags = wavefrontLoadFlags;
+		wavefrontLoadFlags |= WAVEFRONT_NO_TEXTURES;
+		struct WavefrontModel *model = loadWavefront(models[i]);
+		wavefrontLoadFlags = oldFlags;
+		printf("\n%-24s %-14s %10s %10s\n", models[i], "query", "per query", "hits");
+		if(!model) {
+			printf("%-24s %-14s\n", "", "not found");
+			continue;
+		}
+		// rays from anywhere around the model through a point inside it.
+		float *min = getWavefrontMin(model), *max = getWavefrontMax(model);
+		unsigned int seed = 1;
+		for(j = 0; j < rays; j++) {
+			for(k = 0; k < 3; k++) {
+				float size = max[k] - min[k];
+				ray[j].origin[k] = min[k] - size + benchRandom(&seed) * size * 3;
+				ray[j].dir[k] = min[k] + benchRandom(&seed) * size - ray[j].origin[k];
+			}
+			ray[j].maxT = 2;
+		}
+		double start = benchTime();
+		castWavefrontRay(model, ray, hit);
+		printf("%-24s %-14s %7.2f ms\n", "", "build", benchTime() - start);
+
+		int hits = 0;
+		start = benchTime();
+		for(j = 0; j < rays; j++) hits += castWavefrontRay(model, ray + j, hit + j);
+		printf("%-24s %-14s %7.0f ns %10d\n", "", "nearest", (benchTime() - start) * 1e6 / rays, hits);
+		start = benchTime();
+		hits = castWavefrontRays(model, ray, rays, hit, 0);
+		printf("%-24s %-14s %7.0f ns %10d\n", "", "nearest batch", (benchTime() - start) * 1e6 / rays, hits);
+		start = benchTime();
+		hits = castWavefrontRays(model, ray, rays, hit, 1);
+		printf("%-24s %-14s %7.0f ns %10d\n", "", "any batch", (benchTime() - start) * 1e6 / rays, hits);
+
+		float radius = (max[0] - min[0] + max[1] - min[1] + max[2] - min[2]) / 300;
+		hits = 0;
+		start = benchTime();
+		for(j = 0; j < rays / 10; j++) hits += overlapWavefrontSphere(model, ray[j].origin, radius * 10, triangle, 256) > 0;
+		printf("%-24s %-14s %7.0f ns %10d\n", "", "sphere", (benchTime() - start) * 1e6 / (rays / 10), hits);
+		hits = 0;
+		start = benchTime();
+		for(j = 0; j < rays / 10; j++) hits += sweepWavefrontSphere(model, ray + j, radius, hit + j);
+		printf("%-24s %-14s %7.0f ns %10d\n", "", "swept sphere", (benchTime() - start) * 1e6 / (rays / 10), hits);
+		freeWavefront(model);
+	}
+	free(hit);
+	free(ray);
+}
+
+// -bench arena [model...]: load time with the load arena,  its high water marks,  and a frame's worth
+// of little transient lists from malloc against the frame arena.
+static void benchArena(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	int count = argc;
+	int i, j, frame;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	double load[32];
+	for(i = 0; i < count; i++) load[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE, 5);
+
+	const int frames = 1000, lists = 512;
+	void *list[512];
+	double start = benchTime();
+	for(frame = 0; frame < frames; frame++) {
+		for(j = 0; j < lists; j++) list[j] = malloc(64 + (j % 16) * 32);
+		for(j = 0; j < lists; j++) free(list[j]);
+	}
+	double heap = benchTime() - start;
+	start = benchTime();
+	for(frame = 0; frame < frames; frame++) {
+		resetArena(&frameArena);
+		for(j = 0; j < lists; j++) list[j] = arenaAlloc(&frameArena, 64 + (j % 16) * 32);
+	}
+	double arena = benchTime() - start;
+	resetArena(&frameArena);
+
+	printf("\n%-24s %12s\n", "model", "load");
+	for(i = 0; i < count; i++) {
+		if(load[i] < 0) printf("%-24s %12s\n", models[i], "not found");
+		else printf("%-24s %9.2f ms\n", models[i], load[i]);
+	}
+	printf("\n%d lists a frame,  %d frames\n", lists, frames);
+	printf("%-24s %9.3f ms a frame\n", "malloc/free", heap / frames);
+	printf("%-24s %9.3f ms a frame %7.2fx\n", "frame arena", arena / frames, heap / arena);
+	reportArenas();
+}
+
+// -bench pack [model...]: the models and their textures from loose files against from the pack,
+// which opens one file for all of them.  Needs a data.pak made with -pack.
+static void benchPack(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	double loose[32], packed[32];
+	int count = argc;
+	int i;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	int oldLoose = packLooseFiles;
+	for(i = 0; i < count; i++) {
+		packLooseFiles = 1;
+		loose[i] = benchLoadModel(models[i], WAVEFRONT_NO_CACHE, 3);
+		packLooseFiles = 0;
+		packed[i] = benchLoadModel(models[i], WAVEFRONT_NO_CACHE, 3);
+	}
+	packLooseFiles = oldLoose;
+	printf("\n%-24s %12s %12s %8s\n", "model", "loose", "packed", "speedup");
+	for(i = 0; i < count; i++) {
+		if(loose[i] < 0 || packed[i] < 0) printf("%-24s %12s\n", models[i], "not found");
+		else printf("%-24s %9.2f ms %9.2f ms %7.2fx\n", models[i], loose[i], packed[i], loose[i] / packed[i]);
+	}
+}
+
+// -bench buffers [model...]: drawing from client arrays against from buffer objects,  as ms the CPU
+// spends issuing a draw and ms until the GPU has finished it,  best of 20.
+static void benchBuffers(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	const char *modeName[2] = { "arrays", "buffers" };
+	int count = argc;
+	int i, mode, run;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	int oldBuffers = wavefrontUseBuffers;
+	printf("\n%-24s %-8s %8s %8s %12s %12s\n", "model", "mode", "draws", "binds", "cpu", "finished");
+	for(i = 0; i < count; i++) {
+		struct WavefrontModel *model = loadWavefront(models[i]);
+		if(!model) {
+			printf("%-24s %-8s %8s\n", models[i], "", "not found");
+			continue;
+		}
+		int binds, draws = getWavefrontDraws(model, &binds);
+		for(mode = 0; mode < 2; mode++) {
+			double cpu = -1, finished = -1;
+			wavefrontUseBuffers = mode;
+			drawWavefront(model);	// queues the textures, and the buffers the second time
+			while(runUploads() > 0);
+			glFinish();
+			for(run = 0; run < 20; run++) {
+				double start = benchTime();
+				drawWavefront(model);
+				double issued = benchTime();
+				glFinish();
+				double end = benchTime();
+				if(cpu < 0 || issued - start < cpu) cpu = issued - start;
+				if(finished < 0 || end - start < finished) finished = end - start;
+			}
+			printf("%-24s %-8s %8d %8d %9.3f ms %9.3f ms\n", models[i], modeName[mode], draws, binds, cpu, finished);
+		}
+		freeWavefront(model);
+	}
+	wavefrontUseBuffers = oldBuffers;
+}
+
+// -bench occlusion [model...]: what baking the ambient occlusion adds to a parse,  and loading
+// the baked result back out of the .mesh cache,  which the first run writes.
+static void benchOcclusion(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	double plain[32], baked[32], cached[32];
+	int count = argc;
+	int i;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(count > 32) count = 32;
+	for(i = 0; i < count; i++) {
+		plain[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE, 3);
+		if(plain[i] < 0) continue;
+		baked[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_NO_CACHE | WAVEFRONT_OCCLUSION, 1);
+		benchLoadModel(models[i], WAVEFRONT_OCCLUSION, 1);
+		cached[i] = benchLoadModel(models[i], WAVEFRONT_NO_TEXTURES | WAVEFRONT_OCCLUSION, 5);
+	}
+	printf("\nbaking on %d threads\n%-24s %12s %12s %12s %12s\n", jobThreads() + 1, "model", "parse", "parse+bake", "bake", "cached");
+	for(i = 0; i < count; i++) {
+		if(plain[i] < 0) printf("%-24s %12s\n", models[i], "not found");
+		else printf("%-24s %9.2f ms %9.2f ms %9.2f ms %9.2f ms\n", models[i], plain[i], baked[i], baked[i] - plain[i], cached[i]);
+	}
+}
+
+// -bench instances [model]: a grid of up to 10k copies drawn a model at a time,  batched by
+// drawWavefrontInstances without instancing,  and with it where GL has it.  ms to issue and to finish,
+// best of 5.
+static void benchInstances(int argc, char **argv)
+{
+	const char *name = argc > 0 ? argv[0] : benchModels[0];
+	static const int counts[] = { 1, 10, 100, 1000, 10000 };
+	const char *modeName[3] = { "models", "batched", "instanced" };
+	int i, mode, run, n;
+
+	struct WavefrontModel *model = loadWavefront(name);
+	if(!model) {
+		printf("%s not found\n", name);
+		return;
+	}
+	float *min = getWavefrontMin(model), *max = getWavefrontMax(model);
+	float size = 0;
+	for(i = 0; i < 3; i++) if(max[i] - min[i] > size) size = max[i] - min[i];
+	float *matrix = (float *)malloc(sizeof(float) * 16 * 10000);
+	Color *color = (Color *)malloc(sizeof(Color) * 10000);
+	for(i = 0; i < 10000; i++) {
+		float *m = matrix + 16 * i;
+		memset(m, 0, sizeof(float) * 16);
+		m[0] = m[5] = m[10] = m[15] = 1;
+		m[12] = (i % 100 - 50) * size * 1.5f;	// a 100 x 100 grid heading away from the camera
+		m[13] = -size * 2;
+		m[14] = -(i / 100 + 2) * size * 1.5f;
+		color[i] = 0xff000000u | (i & 1 ? 0x4080ff : 0xff8040);
+	}
+	int oldInstancing = wavefrontUseInstancing;
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	drawWavefront(model);	// queues the textures and buffers
+	while(runUploads() > 0);
+	printf("\n%s,  %s\n%8s %-10s %12s %12s\n", name, glInstancing ? "hardware instancing" : "no hardware instancing", "count", "mode", "cpu", "finished");
+	for(n = 0; n < (int)(sizeof(counts) / sizeof(counts[0])); n++) {
+		for(mode = 0; mode < 3; mode++) {
+			double cpu = -1, finished = -1;
+			wavefrontUseInstancing = mode == 2;
+			for(run = 0; run < 5; run++) {
+				glFinish();
+				double start = benchTime();
+				if(mode == 0) {
+					for(i = 0; i < counts[n]; i++) {
+						memcpy(getWavefrontMatrix(model), matrix + 16 * i, sizeof(float) * 16);
+						drawWavefront(model);
+					}
+				} else {
+					drawWavefrontInstances(model, matrix, color, counts[n]);
+				}
+				double issued = benchTime();
+				glFinish();
+				double end = benchTime();
+				if(cpu < 0 || issued - start < cpu) cpu = issued - start;
+				if(finished < 0 || end - start < finished) finished = end - start;
+			}
+			if(mode == 2 && !glInstancing) printf("%8d %-10s %12s\n", counts[n], modeName[mode], "not there");
+			else printf("%8d %-10s %9.3f ms %9.3f ms\n", counts[n], modeName[mode], cpu, finished);
+		}
+	}
+	glPopMatrix();
+	wavefrontUseInstancing = oldInstancing;
+	setWavefrontPos(model, 0, 0, 0);
+	free(matrix);
+	free(color);
+	freeWavefront(model);
+}
+
+// -bench queue [model...]: four copies of each model drawn one drawWavefront at a time against
+// through the render queue.  State changes count the fixed function set ups,  array set ups and
+// matrix loads,  drawWavefront makes one of each per copy.
+static void benchQueue(int argc, char **argv)
+{
+	const char **names = argc > 0 ? (const char **)argv : benchModels;
+	struct WavefrontModel *model[32];
+	int count = 0, draws[2] = { 0, 0 }, binds[2] = { 0, 0 }, changes[2] = { 0, 0 };
+	double cpu[2] = { -1, -1 }, finished[2] = { -1, -1 };
+	int i, copy, mode, run;
+
+	for(i = 0; (argc > 0 ? i < argc : names[i] != 0) && count < 32; i++) {
+		model[count] = loadWavefront(names[i]);
+		if(model[count]) count++;
+		else printf("%-24s not found\n", names[i]);
+	}
+	if(count == 0) return;
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	for(i = 0; i < count; i++) {
+		drawWavefront(model[i]);	// queues the textures and buffers
+		int modelBinds, modelDraws = getWavefrontDraws(model[i], &modelBinds);
+		draws[0] += 4 * modelDraws;
+		binds[0] += 4 * modelBinds;
+		changes[0] += 4 * 3;
+	}
+	while(runUploads() > 0);
+	for(mode = 0; mode < 2; mode++) {
+		for(run = 0; run < 10; run++) {
+			resetArena(&frameArena);
+			glFinish();
+			double start = benchTime();
+			for(copy = 0; copy < 4; copy++) {
+				for(i = 0; i < count; i++) {
+					float *min = getWavefrontMin(model[i]), *max = getWavefrontMax(model[i]);
+					setWavefrontPos(model[i], (copy - 1.5f) * (max[0] - min[0]) * 1.2f, 0, -(max[2] - min[2]) * (2 + i));
+					if(mode == 0) drawWavefront(model[i]);
+					else queueWavefront(model[i]);
+				}
+			}
+			if(mode == 1) draws[1] = drawWavefrontQueue(&binds[1], &changes[1], 0);
+			double issued = benchTime();
+			glFinish();
+			double end = benchTime();
+			if(cpu[mode] < 0 || issued - start < cpu[mode]) cpu[mode] = issued - start;
+			if(finished[mode] < 0 || end - start < finished[mode]) finished[mode] = end - start;
+		}
+	}
+	glPopMatrix();
+	printf("\n%d models,  4 copies each\n%-10s %8s %8s %8s %12s %12s\n", count, "mode", "draws", "binds", "state", "cpu", "finished");
+	for(mode = 0; mode < 2; mode++) {
+		printf("%-10s %8d %8d %8d %9.3f ms %9.3f ms\n", mode ? "queued" : "immediate", draws[mode], binds[mode], changes[mode], cpu[mode], finished[mode]);
+	}
+	for(i = 0; i < count; i++) {
+		setWavefrontPos(model[i], 0, 0, 0);
+		freeWavefront(model[i]);
+	}
+}
+
+// -bench cull [count]: boxes scattered round a camera looking down -z,  added and then culled one
+// at a time against with SIMD,  best of 10 in microseconds.
+static void benchCull(int argc, char **argv)
+{
+	int count = argc > 0 ? atoi(argv[0]) : 100000;
+	float projection[16], plane[24];
+	struct CullBoxes boxes;
+	unsigned int seed = 1;
+	int i, mode, run, found[2] = { 0, 0 };
+	double add = -1, cull[2] = { -1, -1 };
+
+	if(count < 1) count = 1;
+	float *min = (float *)malloc(sizeof(float) * 3 * count);
+	float *max = (float *)malloc(sizeof(float) * 3 * count);
+	int *visible = (int *)malloc(sizeof(int) * count);
+	for(i = 0; i < count * 3; i++) {
+		min[i] = (benchRandom(&seed) - 0.5f) * 2000;
+		max[i] = min[i] + benchRandom(&seed) * 20;
+	}
+	// gluPerspective(45, 4 / 3, 2, 4000)
+	float f = 1 / tanf(45 * 3.14159265f / 360), nearZ = 2, farZ = 4000;
+	memset(projection, 0, sizeof(projection));
+	projection[0] = f * 3 / 4;
+	projection[5] = f;
+	projection[10] = (farZ + nearZ) / (nearZ - farZ);
+	projection[11] = -1;
+	projection[14] = 2 * farZ * nearZ / (nearZ - farZ);
+	frustumPlanes(plane, projection);
+	initCullBoxes(&boxes, 0);
+	for(run = 0; run < 10; run++) {
+		double start = benchTime();
+		boxes.count = 0;
+		for(i = 0; i < count; i++) addCullBox(&boxes, min + i * 3, max + i * 3, 0);
+		double elapsed = benchTime() - start;
+		if(add < 0 || elapsed < add) add = elapsed;
+	}
+	int oldSimd = cullUseSimd;
+	for(mode = 0; mode < 2; mode++) {
+		cullUseSimd = mode;
+		for(run = 0; run < 10; run++) {
+			double start = benchTime();
+			found[mode] = cullBoxes(&boxes, plane, visible);
+			double elapsed = benchTime() - start;
+			if(cull[mode] < 0 || elapsed < cull[mode]) cull[mode] = elapsed;
+		}
+	}
+	cullUseSimd = oldSimd;
+	printf("\n%d boxes,  %.0f us to add\n%-8s %10s %12s\n", count, add * 1000, "mode", "visible", "cull");
+	printf("%-8s %10d %9.0f us\n", "scalar", found[0], cull[0] * 1000);
+	printf("%-8s %10d %9.0f us\n", "simd", found[1], cull[1] * 1000);
+	freeCullBoxes(&boxes);
+	free(min);
+	free(max);
+	free(visible);
+}
+
+// -bench hiz [model]: a 5 x 5 grid of copies queued with frustum culling only,  behind an authored
+// wall over the left half of the view,  and with the front row as occluders.  Best of 10,  the
+// occlusion costs are from that run.
+static void benchHiz(int argc, char **argv)
+{
+	const char *name = argc > 0 ? argv[0] : benchModels[0];
+	struct WavefrontModel *model = loadWavefront(name);
+	static const char *modes[] = { "frustum", "wall", "model" };
+	float projection[16];
+	int mode, run, copy;
+
+	if(!model) {
+		printf("%-24s not found\n", name);
+		return;
+	}
+	float *min = getWavefrontMin(model), *max = getWavefrontMax(model), size = 0;
+	for(copy = 0; copy < 3; copy++) if(size < max[copy] - min[copy]) size = max[copy] - min[copy];
+	float f = 1 / tanf(45 * 3.14159265f / 360), nearZ = size / 20, farZ = size * 20;
+	memset(projection, 0, sizeof(projection));
+	projection[0] = f * 3 / 4;
+	projection[5] = f;
+	projection[10] = (farZ + nearZ) / (nearZ - farZ);
+	projection[11] = -1;
+	projection[14] = 2 * farZ * nearZ / (nearZ - farZ);
+	float wall[12] = { -size * 3, -size * 3, -size * 1.5f, 0, -size * 3, -size * 1.5f, 0, size * 3, -size * 1.5f, -size * 3, size * 3, -size * 1.5f };
+	static const unsigned short wallIndex[6] = { 0, 1, 2, 0, 2, 3 };
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	drawWavefront(model);	// queues the textures and buffers
+	while(runUploads() > 0);
+	printf("\n%s,  25 copies\n%-8s %8s %8s %8s %8s %8s %10s %10s %12s\n", name, "mode", "tris", "tested", "occluded", "culled", "draws", "raster", "test", "finished");
+	for(mode = 0; mode < 3; mode++) {
+		int triangles = 0, tested = 0, occluded = 0, culled = 0, draws = 0;
+		double rasterUs = 0, testUs = 0, finished = -1;
+		for(run = 0; run < 10; run++) {
+			resetArena(&frameArena);
+			glFinish();
+			double start = benchTime();
+			beginOcclusion(projection);	// left empty for frustum
+			if(mode == 1) addOccluder(wall, sizeof(float) * 3, wallIndex, 2, 6, identity);
+			for(copy = 0; copy < 5 && mode > 1; copy++) {
+				setWavefrontPos(model, (copy - 2) * size * 1.2f, 0, -size * 2);
+				addWavefrontOccluder(model);
+			}
+			finishOcclusion();
+			for(copy = 0; copy < 25; copy++) {
+				setWavefrontPos(model, (copy % 5 - 2) * size * 1.2f, 0, -size * (2 + copy / 5 * 1.2f));
+				queueWavefront(model);
+			}
+			int queueCulled;
+			draws = drawWavefrontQueue(0, 0, &queueCulled);
+			glFinish();
+			double elapsed = benchTime() - start;
+			if(finished < 0 || elapsed < finished) {
+				finished = elapsed;
+				culled = queueCulled;
+				getOcclusionStats(&triangles, &tested, &occluded, &rasterUs, &testUs);
+			}
+		}
+		printf("%-8s %8d %8d %8d %8d %8d %7.0f us %7.0f us %9.3f ms\n", modes[mode], triangles, tested, occluded, culled, draws, rasterUs, testUs, finished);
+	}
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	setWavefrontPos(model, 0, 0, 0);
+	freeWavefront(model);
+	freeOcclusion();
+}
+
+// -bench shaders [model...]: building every shader permutation from source against loading the
+// binaries saved from the last build,  then each model drawn with fixed function against the
+// shaders,  as in -bench buffers.
+static void benchShaders(int argc, char **argv)
+{
+	const char **models = argc > 0 ? (const char **)argv : benchModels;
+	const char *modeName[2] = { "fixed", "shaders" };
+	int count = argc;
+	int i, mode, run;
+
+	if(argc == 0) for(count = 0; benchModels[count]; count++);
+	if(!glShaders) {
+		printf("no shaders here\n");
+		return;
+	}
+	double start = benchTime();
+	int built = loadWavefrontShaders(0);
+	double compiled = benchTime() - start;
+	loadWavefrontShaders(1);	// saves them if they weren't already
+	start = benchTime();
+	loadWavefrontShaders(1);
+	double loaded = benchTime() - start;
+	printf("\n%d permutations,  %.2f ms from source", built, compiled);
+	if(glProgramBinaries) printf(",  %.2f ms from saved binaries\n", loaded);
+	else printf(",  no program binaries\n");
+
+	int oldShaders = wavefrontUseShaders;
+	printf("\n%-24s %-8s %8s %12s %12s\n", "model", "mode", "draws", "cpu", "finished");
+	for(i = 0; i < count; i++) {
+		struct WavefrontModel *model = loadWavefront(models[i]);
+		if(!model) {
+			printf("%-24s %-8s %8s\n", models[i], "", "not found");
+			continue;
+		}
+		int binds, draws = getWavefrontDraws(model, &binds);
+		for(mode = 0; mode < 2; mode++) {
+			double cpu = -1, finished = -1;
+			wavefrontUseShaders = mode;
+			drawWavefront(model);	// queues the textures and buffers
+			while(runUploads() > 0);
+			glFinish();
+			for(run = 0; run < 20; run++) {
+				start = benchTime();
+				drawWavefront(model);
+				double issued = benchTime();
+				glFinish();
+				double end = benchTime();
+				if(cpu < 0 || issued - start < cpu) cpu = issued - start;
+				if(finished < 0 || end - start < finished) finished = end - start;
+			}
+			printf("%-24s %-8s %8d %9.3f ms %9.3f ms\n", models[i], modeName[mode], draws, cpu, finished);
+		}
+		freeWavefront(model);
+	}
+	wavefrontUseShaders = oldShaders;
+}
+
+// -bench record [model] [count]: count copies (4096 by default) on a square grid round the camera,
+// queued and drawn through the render queue with its culling,  sorting and recording split between
+// 1,  2,  4... jobs up to one per core.  ms until the replay has been issued and until it's finished,
+// best of 10.
+static void benchRecord(int argc, char **argv)
+{
+	const char *name = argc > 0 ? argv[0] : benchModels[0];
+	int count = argc > 1 ? atoi(argv[1]) : 4096;
+	struct WavefrontModel *model = loadWavefront(name);
+	float projection[16];
+	int i, run, threads;
+
+	if(!model) {
+		printf("%-24s not found\n", name);
+		return;
+	}
+	if(count < 1) count = 1;
+	int side = (int)ceilf(sqrtf((float)count));
+	float *min = getWavefrontMin(model), *max = getWavefrontMax(model), size = 0;
+	for(i = 0; i < 3; i++) if(size < max[i] - min[i]) size = max[i] - min[i];
+	float f = 1 / tanf(45 * 3.14159265f / 360), nearZ = size / 20, farZ = size * side * 2;
+	memset(projection, 0, sizeof(projection));
+	projection[0] = f * 3 / 4;
+	projection[5] = f;
+	projection[10] = (farZ + nearZ) / (nearZ - farZ);
+	projection[11] = -1;
+	projection[14] = 2 * farZ * nearZ / (nearZ - farZ);
+
+	int oldThreads = wavefrontQueueThreads;
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	drawWavefront(model);	// queues the textures and buffers
+	while(runUploads() > 0);
+	printf("\n%s,  %d copies\n%8s %8s %8s %12s %12s\n", name, count, "jobs", "draws", "culled", "cpu", "finished");
+	for(threads = 1; ; threads *= 2) {
+		int draws = 0, culled = 0;
+		double cpu = -1, finished = -1;
+		if(threads > jobThreads() + 1) threads = jobThreads() + 1;
+		wavefrontQueueThreads = threads;
+		for(run = 0; run < 10; run++) {
+			resetArena(&frameArena);
+			glFinish();
+			double start = benchTime();
+			for(i = 0; i < count; i++) {
+				setWavefrontPos(model, (i % side - side / 2) * size * 1.5f, -size, (i / side - side / 2) * size * 1.5f);
+				queueWavefront(model);
+			}
+			draws = drawWavefrontQueue(0, 0, &culled);
+			double issued = benchTime();
+			glFinish();
+			double end = benchTime();
+			if(cpu < 0 || issued - start < cpu) cpu = issued - start;
+			if(finished < 0 || end - start < finished) finished = end - start;
+		}
+		printf("%8d %8d %8d %9.3f ms %9.3f ms\n", threads, draws, culled, cpu, finished);
+		if(threads == jobThreads() + 1) break;
+	}
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	wavefrontQueueThreads = oldThreads;
+	setWavefrontPos(model, 0, 0, 0);
+	freeWavefront(model);
+}
+
+int runBenchmark(int argc, char **argv)
+{
+	if(argc < 1) {
+		printf("usage: vastspacewar -bench load|mmap|threads|cache|index|lod|bvh|async|upload|arena|pack|occlusion|buffers|instances|queue|cull|hiz|shaders|record|faces [model...]\n");
+		return 1;
+	}
+	if(strcmp(argv[0], "load") == 0) {
+		benchLoad(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "mmap") == 0) {
+		benchMapping(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "threads") == 0) {
+		benchThreads(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "cache") == 0) {
+		benchCache(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "index") == 0) {
+		benchIndex(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "lod") == 0) {
+		benchLod(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "bvh") == 0) {
+		benchBvh(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "async") == 0) {
+		benchAsync(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "upload") == 0) {
+		benchUpload(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "arena") == 0) {
+		benchArena(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "pack") == 0) {
+		benchPack(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "occlusion") == 0) {
+		benchOcclusion(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "buffers") == 0) {
+		benchBuffers(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "instances") == 0) {
+		benchInstances(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "queue") == 0) {
+		benchQueue(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "cull") == 0) {
+		benchCull(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "hiz") == 0) {
+		benchHiz(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "shaders") == 0) {
+		benchShaders(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "record") == 0) {
+		benchRecord(argc - 1, argv + 1);
+	} else if(strcmp(argv[0], "faces") == 0) {
+		return checkWavefrontFaces() != 0;
+	} else {
+		printf("Unknown benchmark '%s'\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,8 @@
+/* Bench */
+#ifndef BENCH_H
+#define BENCH_H
+
+// bench.c
+int runBenchmark(int argc, char **argv);	// vastspacewar -bench <name> [args]
+double benchTime();	// milliseconds, high resolution
+#endif
@@ -1,3 +1,3 @@
 #!/bin/bash
 
-g++ -o vastspacewar main.cpp `sdl2-config --cflags` `sdl2-config --libs` -lGL
+g++ -o vastspacewar main.cpp wavefront.cpp image.cpp font.cpp bench.cpp filemap.cpp jobs.cpp meshopt.cpp bvh.cpp assets.cpp glprocs.cpp upload.cpp arena.cpp pack.cpp watch.cpp shader.cpp cull.cpp hiz.cpp `sdl2-config --cflags` `sdl2-config --libs` -lSDL2_ttf -lpng -lGLU -lGL
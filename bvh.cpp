@@ -0,0 +1,647 @@
+/* bvh - triangle bounding volume hierarchy for ray and collision queries */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bvh.h"
+#include "jobs.h"
+
+#define BVH_BINS 16	// split candidates per axis
+#define BVH_MAX_LEAF 8	// a leaf may be this big if splitting doesn't pay
+#define BVH_STACK 64	// deepest the tree goes, so traversal stacks can be fixed size
+#define BVH_BATCH 64	// rays per job in bvhRayBatch
+
+struct BvhBox {
+	float min[3], max[3];
+};
+
+struct BvhBuilder {
+	struct Bvh *bvh;
+	struct BvhBox *bounds;	// per triangle
+	float *centroid;	// 3 per triangle
+	int *order;	// triangles, partitioned as the tree is built
+};
+
+static void boxEmpty(struct BvhBox *box)
+{
+	int k;
+	for(k = 0; k < 3; k++) {
+		box->min[k] = 1e30f;
+		box->max[k] = -1e30f;
+	}
+}
+
+static void boxGrow(struct BvhBox *box, const struct BvhBox *with)
+{
+	int k;
+	for(k = 0; k < 3; k++) {
+		if(box->min[k] > with->min[k]) box->min[k] = with->min[k];
+		if(box->max[k] < with->max[k]) box->max[k] = with->max[k];
+	}
+}
+
+// Half the surface area, which is all the SAH needs.
+static float boxArea(const struct BvhBox *box)
+{
+	float dx = box->max[0] - box->min[0], dy = box->max[1] - box->min[1], dz = box->max[2] - box->min[2];
+	if(dx < 0) return 0;
+	return dx * dy + dy * dz + dz * dx;
+}
+
+// Binned surface area heuristic: try BVH_BINS - 1 planes on each axis and keep the cheapest split,
+// or make a leaf if none beats intersecting everything here.
+static int bvhBuildNode(struct BvhBuilder *b, int start, int count, int depth)
+{
+	int nodeIndex = b->bvh->nodeCount++;
+	struct BvhBox box, centroidBox, binBox[BVH_BINS];
+	int binCount[BVH_BINS];
+	float rightArea[BVH_BINS];
+	int i, k, axis;
+
+	boxEmpty(&box);
+	boxEmpty(&centroidBox);
+	for(i = start; i < start + count; i++) {
+		const float *c = b->centroid + b->order[i] * 3;
+		struct BvhBox point = { { c[0], c[1], c[2] }, { c[0], c[1], c[2] } };
+		boxGrow(&box, b->bounds + b->order[i]);
+		boxGrow(&centroidBox, &point);
+	}
+	memcpy(b->bvh->node[nodeIndex].min, box.min, sizeof(box.min));
+	memcpy(b->bvh->node[nodeIndex].max, box.max, sizeof(box.max));
+
+	int bestAxis = -1, bestBin = 0, mid = count / 2;
+	float bestCost = 1e30f, leafCost = boxArea(&box) * count;
+	for(axis = 0; axis < 3 && count > 2; axis++) {
+		float low = centroidBox.min[axis], extent = centroidBox.max[axis] - low;
+		if(!(extent > 0)) continue;
+		for(k = 0; k < BVH_BINS; k++) {
+			boxEmpty(binBox + k);
+			binCount[k] = 0;
+		}
+		for(i = start; i < start + count; i++) {
+			int bin = (int)((b->centroid[b->order[i] * 3 + axis] - low) / extent * BVH_BINS);
+			if(bin > BVH_BINS - 1) bin = BVH_BINS - 1;
+			boxGrow(binBox + bin, b->bounds + b->order[i]);
+			binCount[bin]++;
+		}
+		struct BvhBox side;
+		boxEmpty(&side);
+		for(k = BVH_BINS - 1; k > 0; k--) {
+			boxGrow(&side, binBox + k);
+			rightArea[k] = boxArea(&side);
+		}
+		int left = 0;
+		boxEmpty(&side);
+		for(k = 0; k < BVH_BINS - 1; k++) {
+			boxGrow(&side, binBox + k);
+			left += binCount[k];
+			if(left == 0 || left == count) continue;
+			float cost = boxArea(&box) + boxArea(&side) * left + rightArea[k + 1] * (count - left);
+			if(cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = k;
+			}
+		}
+	}
+	if(count <= 2 || depth >= BVH_STACK - 2 || (count <= BVH_MAX_LEAF && (bestAxis < 0 || bestCost >= leafCost))) {
+		b->bvh->node[nodeIndex].first = start;
+		b->bvh->node[nodeIndex].count = count;
+		return nodeIndex;
+	}
+	if(bestAxis >= 0) {
+		// everything in bins up to bestBin goes left.
+		float low = centroidBox.min[bestAxis], extent = centroidBox.max[bestAxis] - low;
+		int j = start + count - 1;
+		i = start;
+		while(i <= j) {
+			int bin = (int)((b->centroid[b->order[i] * 3 + bestAxis] - low) / extent * BVH_BINS);
+			if(bin > BVH_BINS - 1) bin = BVH_BINS - 1;
+			if(bin <= bestBin) {
+				i++;
+			} else {
+				int swap = b->order[i];
+				b->order[i] = b->order[j];
+				b->order[j--] = swap;
+			}
+		}
+		mid = i - start;
+	}
+	// all the centroids in one place leaves nothing to split on but the count.
+	if(mid == 0 || mid == count) mid = count / 2;
+	bvhBuildNode(b, start, mid, depth + 1);
+	int right = bvhBuildNode(b, start + mid, count - mid, depth + 1);
+	b->bvh->node[nodeIndex].first = right;
+	b->bvh->node[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+int buildBvh(struct Bvh *bvh, const unsigned int *index, int indexCount, const float *position, int stride)
+{
+	struct BvhBuilder b;
+	int triCount = indexCount / 3;
+	int i, k, j;
+
+	memset(bvh, 0, sizeof(*bvh));
+	if(triCount <= 0) return 0;
+	b.bvh = bvh;
+	b.bounds = (struct BvhBox *)malloc(sizeof(struct BvhBox) * triCount);
+	b.centroid = (float *)malloc(sizeof(float) * 3 * triCount);
+	b.order = (int *)malloc(sizeof(int) * triCount);
+	bvh->corner = (float *)malloc(sizeof(float) * 9 * triCount);
+	bvh->triangle = (int *)malloc(sizeof(int) * triCount);
+	bvh->node = (struct BvhNode *)malloc(sizeof(struct BvhNode) * triCount * 2);
+	bvh->triCount = triCount;
+	for(i = 0; i < triCount; i++) {
+		boxEmpty(b.bounds + i);
+		for(j = 0; j < 3; j++) {
+			const float *p = (const float *)((const char *)position + (size_t)index[i * 3 + j] * stride);
+			struct BvhBox point = { { p[0], p[1], p[2] }, { p[0], p[1], p[2] } };
+			boxGrow(b.bounds + i, &point);
+		}
+		for(k = 0; k < 3; k++) b.centroid[i * 3 + k] = (b.bounds[i].min[k] + b.bounds[i].max[k]) / 2;
+		b.order[i] = i;
+	}
+	bvhBuildNode(&b, 0, triCount, 0);
+	bvh->node = (struct BvhNode *)realloc(bvh->node, sizeof(struct BvhNode) * bvh->nodeCount);
+
+	// copy the corners out in leaf order so a leaf's triangles sit together.
+	for(i = 0; i < triCount; i++) {
+		int t = b.order[i];
+		bvh->triangle[i] = t;
+		for(j = 0; j < 3; j++) {
+			const float *p = (const float *)((const char *)position + (size_t)index[t * 3 + j] * stride);
+			memcpy(bvh->corner + i * 9 + j * 3, p, sizeof(float) * 3);
+		}
+	}
+	free(b.order);
+	free(b.centroid);
+	free(b.bounds);
+	return 1;
+}
+
+void freeBvh(struct Bvh *bvh)
+{
+	free(bvh->node);
+	free(bvh->corner);
+	free(bvh->triangle);
+	memset(bvh, 0, sizeof(*bvh));
+}
+
+static void sub(float *out, const float *a, const float *b)
+{
+	out[0] = a[0] - b[0];
+	out[1] = a[1] - b[1];
+	out[2] = a[2] - b[2];
+}
+
+static float dot(const float *a, const float *b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(float *out, const float *a, const float *b)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void faceNormal(float *out, const float *c)
+{
+	float e1[3], e2[3];
+	sub(e1, c + 3, c);
+	sub(e2, c + 6, c);
+	cross(out, e1, e2);
+	float length = sqrtf(dot(out, out));
+	if(length > 0) {
+		out[0] /= length;
+		out[1] /= length;
+		out[2] /= length;
+	}
+}
+
+// Slab test against a box grown by pad on every side.  Returns the entry distance in *near.
+static int rayBox(const float *origin, const float *inv, const float *min, const float *max, float pad, float maxT, float *near)
+{
+	float t0 = 0, t1 = maxT;
+	int k;
+	for(k = 0; k < 3; k++) {
+		float a = (min[k] - pad - origin[k]) * inv[k], b = (max[k] + pad - origin[k]) * inv[k];
+		if(a > b) {
+			float swap = a;
+			a = b;
+			b = swap;
+		}
+		if(a > t0) t0 = a;
+		if(b < t1) t1 = b;
+		if(t0 > t1) return 0;
+	}
+	*near = t0;
+	return 1;
+}
+
+static void rayInverse(float *inv, const float *dir)
+{
+	int k;
+	for(k = 0; k < 3; k++) inv[k] = dir[k] != 0 ? 1 / dir[k] : 1e30f;	// not infinity, so 0 * inv stays 0
+}
+
+// Moller and Trumbore,  both sides.
+static int rayTriangle(const float *origin, const float *dir, const float *c, float maxT, float *t, float *u, float *v)
+{
+	float e1[3], e2[3], p[3], s[3], q[3];
+	sub(e1, c + 3, c);
+	sub(e2, c + 6, c);
+	cross(p, dir, e2);
+	float det = dot(e1, p);
+	if(det == 0) return 0;
+	float inv = 1 / det;
+	sub(s, origin, c);
+	float bu = dot(s, p) * inv;
+	if(bu < 0 || bu > 1) return 0;
+	cross(q, s, e1);
+	float bv = dot(dir, q) * inv;
+	if(bv < 0 || bu + bv > 1) return 0;
+	float bt = dot(e2, q) * inv;
+	if(bt < 0 || bt > maxT) return 0;
+	*t = bt;
+	*u = bu;
+	*v = bv;
+	return 1;
+}
+
+// Nearest hit,  or with any set the first one found.
+static int bvhRay(const struct Bvh *bvh, const struct BvhRay *ray, struct BvhHit *hit, int any)
+{
+	int stack[BVH_STACK];
+	float stackT[BVH_STACK], inv[3], best = ray->maxT, near, u = 0, v = 0, farT;
+	int top = 0, node = 0, found = -1, i;
+
+	hit->triangle = -1;
+	if(!bvh->nodeCount) return 0;
+	rayInverse(inv, ray->dir);
+	if(!rayBox(ray->origin, inv, bvh->node[0].min, bvh->node[0].max, 0, best, &near)) return 0;
+	for(;;) {
+		const struct BvhNode *n = bvh->node + node;
+		if(n->count) {
+			for(i = n->first; i < n->first + n->count; i++) {
+				float t, tu, tv;
+				if(!rayTriangle(ray->origin, ray->dir, bvh->corner + i * 9, best, &t, &tu, &tv)) continue;
+				best = t;
+				found = i;
+				u = tu;
+				v = tv;
+				if(any) break;
+			}
+			if(any && found >= 0) break;
+		} else {
+			int left = node + 1, right = n->first;
+			float leftT, rightT;
+			int hitLeft = rayBox(ray->origin, inv, bvh->node[left].min, bvh->node[left].max, 0, best, &leftT);
+			int hitRight = rayBox(ray->origin, inv, bvh->node[right].min, bvh->node[right].max, 0, best, &rightT);
+			if(hitLeft && hitRight) {
+				// nearer child first,  the other waits on the stack.
+				if(rightT < leftT) {
+					node = right;
+					right = left;
+					farT = leftT;
+				} else {
+					node = left;
+					farT = rightT;
+				}
+				stack[top] = right;
+				stackT[top++] = farT;
+				continue;
+			}
+			if(hitLeft || hitRight) {
+				node = hitLeft ? left : right;
+				continue;
+			}
+		}
+		do {
+			if(!top) goto done;
+			node = stack[--top];
+		} while(stackT[top] > best);
+	}
+done:
+	if(found < 0) return 0;
+	hit->t = best;
+	hit->triangle = bvh->triangle[found];
+	hit->u = u;
+	hit->v = v;
+	faceNormal(hit->normal, bvh->corner + found * 9);
+	return 1;
+}
+
+int bvhRayNearest(const struct Bvh *bvh, const struct BvhRay *ray, struct BvhHit *hit)
+{
+	return bvhRay(bvh, ray, hit, 0);
+}
+
+int bvhRayAny(const struct Bvh *bvh, const struct BvhRay *ray)
+{
+	struct BvhHit hit;
+	return bvhRay(bvh, ray, &hit, 1);
+}
+
+struct BvhBatch {
+	const struct Bvh *bvh;
+	const struct BvhRay *ray;
+	struct BvhHit *hit;
+	int count;
+	int any;
+};
+
+static void bvhRayJob(void *arg, int index)
+{
+	struct BvhBatch *batch = (struct BvhBatch *)arg;
+	int i, end = (index + 1) * BVH_BATCH < batch->count ? (index + 1) * BVH_BATCH : batch->count;
+	for(i = index * BVH_BATCH; i < end; i++) bvhRay(batch->bvh, batch->ray + i, batch->hit + i, batch->any);
+}
+
+int bvhRayBatch(const struct Bvh *bvh, const struct BvhRay *ray, int count, struct BvhHit *hit, int any)
+{
+	struct BvhBatch batch = { bvh, ray, hit, count, any };
+	int i, hits = 0;
+	if(count <= BVH_BATCH * 2) {
+		for(i = 0; i < count; i++) bvhRay(bvh, ray + i, hit + i, any);
+	} else {
+		runParallel(bvhRayJob, &batch, (count + BVH_BATCH - 1) / BVH_BATCH);
+	}
+	for(i = 0; i < count; i++) hits += hit[i].triangle >= 0;
+	return hits;
+}
+
+// Ericson,  Real-Time Collision Detection 5.1.5.
+static void closestOnTriangle(float *out, const float *p, const float *c)
+{
+	const float *a = c, *b = c + 3, *cc = c + 6;
+	float ab[3], ac[3], ap[3], bp[3], cp[3];
+	int k;
+	sub(ab, b, a);
+	sub(ac, cc, a);
+	sub(ap, p, a);
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if(d1 <= 0 && d2 <= 0) {
+		memcpy(out, a, sizeof(float) * 3);
+		return;
+	}
+	sub(bp, p, b);
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if(d3 >= 0 && d4 <= d3) {
+		memcpy(out, b, sizeof(float) * 3);
+		return;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+		float v = d1 / (d1 - d3);
+		for(k = 0; k < 3; k++) out[k] = a[k] + v * ab[k];
+		return;
+	}
+	sub(cp, p, cc);
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if(d6 >= 0 && d5 <= d6) {
+		memcpy(out, cc, sizeof(float) * 3);
+		return;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+		float w = d2 / (d2 - d6);
+		for(k = 0; k < 3; k++) out[k] = a[k] + w * ac[k];
+		return;
+	}
+	float va = d3 * d6 - d5 * d4;
+	if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		for(k = 0; k < 3; k++) out[k] = b[k] + w * (cc[k] - b[k]);
+		return;
+	}
+	float denom = 1 / (va + vb + vc);
+	float v = vb * denom, w = vc * denom;
+	for(k = 0; k < 3; k++) out[k] = a[k] + ab[k] * v + ac[k] * w;
+}
+
+static float boxDistance2(const float *p, const float *min, const float *max)
+{
+	float d = 0;
+	int k;
+	for(k = 0; k < 3; k++) {
+		if(p[k] < min[k]) d += (min[k] - p[k]) * (min[k] - p[k]);
+		else if(p[k] > max[k]) d += (p[k] - max[k]) * (p[k] - max[k]);
+	}
+	return d;
+}
+
+// Separating axis test,  Akenine-Moller's "Fast 3D triangle-box overlap testing".
+static int triangleBoxOverlap(const float *c, const float *center, const float *half)
+{
+	float v[3][3], e[3][3], normal[3];
+	int i, j, k;
+	for(i = 0; i < 3; i++) sub(v[i], c + i * 3, center);
+	for(i = 0; i < 3; i++) sub(e[i], v[(i + 1) % 3], v[i]);
+	// the nine edge cross box axis directions.
+	for(i = 0; i < 3; i++) {
+		for(j = 0; j < 3; j++) {
+			float axis[3] = { 0, 0, 0 }, unit[3] = { 0, 0, 0 };
+			unit[j] = 1;
+			cross(axis, unit, e[i]);
+			float p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+			float low = p0 < p1 ? (p0 < p2 ? p0 : p2) : (p1 < p2 ? p1 : p2);
+			float high = p0 > p1 ? (p0 > p2 ? p0 : p2) : (p1 > p2 ? p1 : p2);
+			float r = half[0] * fabsf(axis[0]) + half[1] * fabsf(axis[1]) + half[2] * fabsf(axis[2]);
+			if(low > r || high < -r) return 0;
+		}
+	}
+	// the box's own axes.
+	for(k = 0; k < 3; k++) {
+		float low = v[0][k], high = v[0][k];
+		for(i = 1; i < 3; i++) {
+			if(low > v[i][k]) low = v[i][k];
+			if(high < v[i][k]) high = v[i][k];
+		}
+		if(low > half[k] || high < -half[k]) return 0;
+	}
+	// and the triangle's plane.
+	cross(normal, e[0], e[1]);
+	float r = half[0] * fabsf(normal[0]) + half[1] * fabsf(normal[1]) + half[2] * fabsf(normal[2]);
+	float d = dot(normal, v[0]);
+	return d <= r && d >= -r;
+}
+
+// Shared by the overlap queries: walk every node the test accepts,  list the triangles that pass.
+static int bvhOverlap(const struct Bvh *bvh, const float *a, const float *b, float radius, int *triangle, int maxTriangles)
+{
+	int stack[BVH_STACK];
+	int top = 0, node = 0, found = 0, i;
+	float center[3], half[3];
+	int sphere = radius >= 0;
+
+	if(!bvh->nodeCount) return 0;
+	if(!sphere) {
+		for(i = 0; i < 3; i++) {
+			center[i] = (a[i] + b[i]) / 2;
+			half[i] = (b[i] - a[i]) / 2;
+		}
+	}
+	for(;;) {
+		const struct BvhNode *n = bvh->node + node;
+		int touching;
+		if(sphere) touching = boxDistance2(a, n->min, n->max) <= radius * radius;
+		else touching = a[0] <= n->max[0] && b[0] >= n->min[0] && a[1] <= n->max[1] && b[1] >= n->min[1] && a[2] <= n->max[2] && b[2] >= n->min[2];
+		if(touching && n->count) {
+			for(i = n->first; i < n->first + n->count; i++) {
+				const float *c = bvh->corner + i * 9;
+				if(sphere) {
+					float closest[3], d[3];
+					closestOnTriangle(closest, a, c);
+					sub(d, closest, a);
+					if(dot(d, d) > radius * radius) continue;
+				} else if(!triangleBoxOverlap(c, center, half)) {
+					continue;
+				}
+				if(found < maxTriangles) triangle[found] = bvh->triangle[i];
+				found++;
+			}
+		} else if(touching) {
+			stack[top++] = n->first;
+			node++;
+			continue;
+		}
+		if(!top) break;
+		node = stack[--top];
+	}
+	return found;
+}
+
+int bvhOverlapSphere(const struct Bvh *bvh, const float *center, float radius, int *triangle, int maxTriangles)
+{
+	return bvhOverlap(bvh, center, 0, radius, triangle, maxTriangles);
+}
+
+int bvhOverlapBox(const struct Bvh *bvh, const float *min, const float *max, int *triangle, int maxTriangles)
+{
+	return bvhOverlap(bvh, min, max, -1, triangle, maxTriangles);
+}
+
+static int raySphere(const float *origin, const float *dir, const float *center, float radius, float maxT, float *t)
+{
+	float m[3];
+	sub(m, origin, center);
+	float a = dot(dir, dir), b = dot(m, dir), c = dot(m, m) - radius * radius;
+	if(a == 0) return 0;
+	float discr = b * b - a * c;
+	if(discr < 0) return 0;
+	float tt = (-b - sqrtf(discr)) / a;
+	if(tt < 0 || tt > maxT) return 0;
+	*t = tt;
+	return 1;
+}
+
+// Ray against the side of the capsule around segment a-b,  the end caps are raySphere's job.
+static int rayCylinder(const float *origin, const float *dir, const float *a, const float *b, float radius, float maxT, float *t)
+{
+	float e[3], m[3];
+	sub(e, b, a);
+	sub(m, origin, a);
+	float dd = dot(e, e), md = dot(m, e), nd = dot(dir, e), nn = dot(dir, dir), mn = dot(m, dir);
+	float qa = dd * nn - nd * nd, k = dot(m, m) - radius * radius, c = dd * k - md * md;
+	if(qa == 0 || dd == 0) return 0;	// along the axis,  or no segment at all
+	float qb = dd * mn - nd * md;
+	float discr = qb * qb - qa * c;
+	if(discr < 0) return 0;
+	float tt = (-qb - sqrtf(discr)) / qa;
+	if(tt < 0 || tt > maxT) return 0;
+	float s = md + tt * nd;
+	if(s < 0 || s > dd) return 0;
+	*t = tt;
+	return 1;
+}
+
+// The sphere's path against the triangle grown by radius: two offset faces,  three edge cylinders
+// and three corner spheres.  normal is the direction from the contact point to the sphere's centre.
+static int sweepSphereTriangle(const float *origin, const float *dir, float radius, const float *c, float maxT, float *t, float *normal)
+{
+	float closest[3], d[3], n[3], offset[9], at[3];
+	float best = maxT, tt, u, v;
+	int found = 0, side, i, k;
+
+	closestOnTriangle(closest, origin, c);
+	sub(d, origin, closest);
+	faceNormal(n, c);
+	if(dot(d, d) <= radius * radius) {
+		float length = sqrtf(dot(d, d));
+		*t = 0;
+		if(length > 0) for(k = 0; k < 3; k++) normal[k] = d[k] / length;
+		else memcpy(normal, n, sizeof(float) * 3);
+		return 1;
+	}
+	if(dot(n, n) > 0) {
+		for(side = -1; side <= 1; side += 2) {
+			for(i = 0; i < 9; i++) offset[i] = c[i] + side * radius * n[i % 3];
+			if(rayTriangle(origin, dir, offset, best, &tt, &u, &v)) {
+				best = tt;
+				for(k = 0; k < 3; k++) normal[k] = side * n[k];
+				found = 1;
+			}
+		}
+	}
+	for(i = 0; i < 3; i++) {
+		const float *a = c + i * 3, *b = c + (i + 1) % 3 * 3;
+		if(rayCylinder(origin, dir, a, b, radius, best, &tt)) {
+			float e[3], p[3];
+			best = tt;
+			for(k = 0; k < 3; k++) at[k] = origin[k] + dir[k] * tt;
+			sub(e, b, a);
+			sub(p, at, a);
+			float s = dot(p, e) / dot(e, e);
+			for(k = 0; k < 3; k++) normal[k] = (at[k] - (a[k] + e[k] * s)) / radius;
+			found = 1;
+		}
+		if(raySphere(origin, dir, a, radius, best, &tt)) {
+			best = tt;
+			for(k = 0; k < 3; k++) normal[k] = (origin[k] + dir[k] * tt - a[k]) / radius;
+			found = 1;
+		}
+	}
+	if(found) *t = best;
+	return found;
+}
+
+int bvhSweepSphere(const struct Bvh *bvh, const struct BvhRay *path, float radius, struct BvhHit *hit)
+{
+	int stack[BVH_STACK];
+	float inv[3], best = path->maxT, near, normal[3];
+	int top = 0, node = 0, found = -1, i;
+
+	hit->triangle = -1;
+	if(!bvh->nodeCount) return 0;
+	rayInverse(inv, path->dir);
+	for(;;) {
+		const struct BvhNode *n = bvh->node + node;
+		if(rayBox(path->origin, inv, n->min, n->max, radius, best, &near)) {
+			if(!n->count) {
+				stack[top++] = n->first;
+				node++;
+				continue;
+			}
+			for(i = n->first; i < n->first + n->count; i++) {
+				float t;
+				if(!sweepSphereTriangle(path->origin, path->dir, radius, bvh->corner + i * 9, best, &t, normal)) continue;
+				if(found >= 0 && t >= best) continue;
+				best = t;
+				found = i;
+				memcpy(hit->normal, normal, sizeof(normal));
+			}
+		}
+		if(!top) break;
+		node = stack[--top];
+	}
+	if(found < 0) return 0;
+	hit->t = best;
+	hit->triangle = bvh->triangle[found];
+	hit->u = hit->v = 0;
+	return 1;
+}
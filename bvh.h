@@ -0,0 +1,38 @@
+/* Bounding volume hierarchy */
+#ifndef BVH_H
+#define BVH_H
+
+// bvh.c
+struct BvhNode {
+	float min[3];
+	int first;	// first triangle for a leaf, the right child otherwise (the left is the next node)
+	float max[3];
+	int count;	// triangles in a leaf, 0 for an inner node
+};
+struct Bvh {
+	struct BvhNode *node;	// depth first
+	int nodeCount;
+	float *corner;	// 9 floats per triangle, in leaf order
+	int *triangle;	// original triangle number for each of those
+	int triCount;
+};
+struct BvhRay {
+	float origin[3];
+	float dir[3];	// needn't be unit length, t is measured in lengths of it
+	float maxT;
+};
+struct BvhHit {
+	float t;
+	int triangle;	// -1 for a miss
+	float u, v;	// barycentric position on the triangle, ray hits only
+	float normal[3];	// unit face normal for rays, contact normal for swept spheres
+};
+int buildBvh(struct Bvh *bvh, const unsigned int *index, int indexCount, const float *position, int stride);	// stride in bytes, returns 0 if there are no triangles
+void freeBvh(struct Bvh *bvh);
+int bvhRayNearest(const struct Bvh *bvh, const struct BvhRay *ray, struct BvhHit *hit);	// two sided, returns 1 on a hit
+int bvhRayAny(const struct Bvh *bvh, const struct BvhRay *ray);	// 1 if anything is hit, stops at the first
+int bvhRayBatch(const struct Bvh *bvh, const struct BvhRay *ray, int count, struct BvhHit *hit, int any);	// spread over the job threads when big, returns the hit count
+int bvhOverlapSphere(const struct Bvh *bvh, const float *center, float radius, int *triangle, int maxTriangles);	// returns how many triangles touch it, lists up to maxTriangles
+int bvhOverlapBox(const struct Bvh *bvh, const float *min, const float *max, int *triangle, int maxTriangles);
+int bvhSweepSphere(const struct Bvh *bvh, const struct BvhRay *path, float radius, struct BvhHit *hit);	// first contact of a sphere moving along path, t = 0 if it starts touching
+#endif
@@ -0,0 +1,196 @@
+/* cull - frustum tests for boxes, batched so a frame's worth goes through SSE a few at a time */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULL_SSE
+#include <xmmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#include "arena.h"
+#include "cull.h"
+
+#define CULL_BLOCK 24	// floats per 4 boxes
+
+int cullUseSimd = 1;
+
+void initCullBoxes(struct CullBoxes *boxes, struct Arena *arena)
+{
+	memset(boxes, 0, sizeof(*boxes));
+	boxes->arena = arena;
+}
+
+// The centre moves with the matrix,  the half size becomes the reach of the moved box along each
+// axis,  so it still holds the corners (Arvo's method).
+static void moveBox(const float *min, const float *max, const float *matrix, float *center, float *half)
+{
+	float c[3], h[3];
+	int i;
+	for(i = 0; i < 3; i++) {
+		c[i] = (min[i] + max[i]) * 0.5f;
+		h[i] = (max[i] - min[i]) * 0.5f;
+	}
+	if(!matrix) {
+		memcpy(center, c, sizeof(c));
+		memcpy(half, h, sizeof(h));
+		return;
+	}
+	for(i = 0; i < 3; i++) {
+		center[i] = matrix[i] * c[0] + matrix[4 + i] * c[1] + matrix[8 + i] * c[2] + matrix[12 + i];
+		half[i] = fabsf(matrix[i]) * h[0] + fabsf(matrix[4 + i]) * h[1] + fabsf(matrix[8 + i]) * h[2];
+	}
+}
+
+int addCullBox(struct CullBoxes *boxes, const float *min, const float *max, const float *matrix)
+{
+	float center[3], half[3];
+	int i, blocks = (boxes->count >> 2) + 1;
+	if(blocks > boxes->blockMax) {
+		if(boxes->arena) {
+			boxes->block = (float *)arenaGrow(boxes->arena, boxes->block, &boxes->blockMax, blocks - 1, sizeof(float) * CULL_BLOCK);
+		} else {
+			boxes->blockMax = boxes->blockMax < 16 ? 16 : boxes->blockMax * 2;
+			boxes->block = (float *)realloc(boxes->block, sizeof(float) * CULL_BLOCK * boxes->blockMax);
+			if(!boxes->block) {
+				printf("*** Out of memory for %d cull boxes\n", boxes->blockMax * 4);
+				exit(1);
+			}
+		}
+	}
+	moveBox(min, max, matrix, center, half);
+	float *block = boxes->block + CULL_BLOCK * (boxes->count >> 2);
+	int lane = boxes->count & 3;
+	if(lane == 0) memset(block, 0, sizeof(float) * CULL_BLOCK);	// the spare lanes test as a point at the origin
+	for(i = 0; i < 3; i++) {
+		block[i * 4 + lane] = center[i];
+		block[12 + i * 4 + lane] = half[i];
+	}
+	return boxes->count++;
+}
+
+// Rows of the matrix added and taken from the w row,  as in Gribb and Hartmann.  They aren't
+// normalized,  the tests only need the sign.
+void frustumPlanes(float *plane, const float *matrix)
+{
+	int i, k;
+	for(i = 0; i < 3; i++) {
+		for(k = 0; k < 4; k++) {
+			plane[i * 8 + k] = matrix[k * 4 + 3] + matrix[k * 4 + i];
+			plane[i * 8 + 4 + k] = matrix[k * 4 + 3] - matrix[k * 4 + i];
+		}
+	}
+}
+
+// Outside if the box's furthest point along the plane's normal is still behind it.
+static int boxOutside(const float *plane, const float *center, const float *half)
+{
+	int p;
+	for(p = 0; p < 6; p++, plane += 4) {
+		float distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+		float reach = fabsf(plane[0]) * half[0] + fabsf(plane[1]) * half[1] + fabsf(plane[2]) * half[2];
+		if(distance + reach < 0) return 1;
+	}
+	return 0;
+}
+
+int cullBox(const float *plane, const float *min, const float *max, const float *matrix)
+{
+	float center[3], half[3];
+	moveBox(min, max, matrix, center, half);
+	return !boxOutside(plane, center, half);
+}
+
+#ifdef CULL_SSE
+// Each lane of the result is all ones if that box is outside one of the planes.
+static __m128 outsideSse(const float *block, const __m128 *plane, const __m128 *absPlane)
+{
+	__m128 cx = _mm_loadu_ps(block), cy = _mm_loadu_ps(block + 4), cz = _mm_loadu_ps(block + 8);
+	__m128 hx = _mm_loadu_ps(block + 12), hy = _mm_loadu_ps(block + 16), hz = _mm_loadu_ps(block + 20);
+	__m128 outside = _mm_setzero_ps();
+	int p;
+	for(p = 0; p < 6; p++) {
+		const __m128 *n = plane + p * 4, *a = absPlane + p * 3;
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], cx), _mm_mul_ps(n[1], cy)), _mm_add_ps(_mm_mul_ps(n[2], cz), n[3]));
+		__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], hx), _mm_mul_ps(a[1], hy)), _mm_mul_ps(a[2], hz));
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+	}
+	return outside;
+}
+#endif
+
+#ifdef __AVX__
+// Two blocks at once,  the first in the low half.
+static __m256 outsideAvx(const float *block, const __m256 *plane, const __m256 *absPlane)
+{
+	__m256 v[6];
+	int i, p;
+	for(i = 0; i < 6; i++) v[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(block + i * 4)), _mm_loadu_ps(block + CULL_BLOCK + i * 4), 1);
+	__m256 outside = _mm256_setzero_ps();
+	for(p = 0; p < 6; p++) {
+		const __m256 *n = plane + p * 4, *a = absPlane + p * 3;
+		__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n[0], v[0]), _mm256_mul_ps(n[1], v[1])), _mm256_add_ps(_mm256_mul_ps(n[2], v[2]), n[3]));
+		__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], v[3]), _mm256_mul_ps(a[1], v[4])), _mm256_mul_ps(a[2], v[5]));
+		outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_LT_OQ));
+	}
+	return outside;
+}
+#endif
+
+int cullBoxes(const struct CullBoxes *boxes, const float *plane, int *visible)
+{
+	int i, k, lane, found = 0;
+	int blocks = (boxes->count + 3) >> 2;
+#ifdef CULL_SSE
+	if(cullUseSimd) {
+		int b = 0, p;
+#ifdef __AVX__
+		__m256 widePlane[24], wideAbs[18];
+		for(p = 0; p < 6; p++) {
+			for(k = 0; k < 4; k++) widePlane[p * 4 + k] = _mm256_set1_ps(plane[p * 4 + k]);
+			for(k = 0; k < 3; k++) wideAbs[p * 3 + k] = _mm256_set1_ps(fabsf(plane[p * 4 + k]));
+		}
+		for(; b + 1 < blocks; b += 2) {
+			int inside = ~_mm256_movemask_ps(outsideAvx(boxes->block + CULL_BLOCK * b, widePlane, wideAbs)) & 0xff;
+			for(lane = 0; lane < 8; lane++) {
+				if((inside & (1 << lane)) && b * 4 + lane < boxes->count) visible[found++] = b * 4 + lane;
+			}
+		}
+#endif
+		__m128 splat[24], splatAbs[18];
+		for(p = 0; p < 6; p++) {
+			for(k = 0; k < 4; k++) splat[p * 4 + k] = _mm_set1_ps(plane[p * 4 + k]);
+			for(k = 0; k < 3; k++) splatAbs[p * 3 + k] = _mm_set1_ps(fabsf(plane[p * 4 + k]));
+		}
+		for(; b < blocks; b++) {
+			int inside = ~_mm_movemask_ps(outsideSse(boxes->block + CULL_BLOCK * b, splat, splatAbs)) & 0xf;
+			for(lane = 0; lane < 4; lane++) {
+				if((inside & (1 << lane)) && b * 4 + lane < boxes->count) visible[found++] = b * 4 + lane;
+			}
+		}
+		return found;
+	}
+#endif
+	for(i = 0; i < boxes->count; i++) {
+		const float *block = boxes->block + CULL_BLOCK * (i >> 2);
+		float center[3], half[3];
+		lane = i & 3;
+		for(k = 0; k < 3; k++) {
+			center[k] = block[k * 4 + lane];
+			half[k] = block[12 + k * 4 + lane];
+		}
+		if(!boxOutside(plane, center, half)) visible[found++] = i;
+	}
+	return found;
+}
+
+void freeCullBoxes(struct CullBoxes *boxes)
+{
+	if(!boxes->arena) free(boxes->block);
+	boxes->block = 0;
+	boxes->count = boxes->blockMax = 0;
+}
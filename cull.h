@@ -0,0 +1,20 @@
+/* Frustum culling */
+#ifndef CULL_H
+#define CULL_H
+
+// cull.c
+struct Arena;
+struct CullBoxes {
+	float *block;	// 24 floats per 4 boxes: their centre x, y and z then half size x, y and z, 4 of each
+	int count;
+	int blockMax;
+	struct Arena *arena;	// where block comes from, 0 for malloc
+};
+extern int cullUseSimd;	// 1 = 4 boxes at a time with SSE (8 with AVX when built for it), 0 = one at a time, for comparison
+void initCullBoxes(struct CullBoxes *boxes, struct Arena *arena);
+int addCullBox(struct CullBoxes *boxes, const float *min, const float *max, const float *matrix);	// the box around min..max moved by matrix (0 for none), returns its number
+void frustumPlanes(float *plane, const float *matrix);	// 6 planes of 4 floats facing in, from a GL style projection or projection x view
+int cullBox(const float *plane, const float *min, const float *max, const float *matrix);	// 1 if any of it may be inside
+int cullBoxes(const struct CullBoxes *boxes, const float *plane, int *visible);	// lists the boxes that may be inside, returns how many
+void freeCullBoxes(struct CullBoxes *boxes);	// only for malloc'd ones, an arena's go when it's reset
+#endif
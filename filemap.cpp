@@ -0,0 +1,132 @@
+/* filemap - read only views of whole files, memory mapped where the platform allows */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(_PSP)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+
+#include "filemap.h"
+
+int mapFile(const char *path, struct FileMap *map)
+{
+	memset(map, 0, sizeof(*map));
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE) return 0;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return 0;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);	// the mapping keeps the file open
+	if(!mapping) return 0;
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		CloseHandle(mapping);
+		return 0;
+	}
+	map->data = (const char *)data;
+	map->size = (size_t)size.QuadPart;
+	map->handle = mapping;
+	map->mapped = 1;
+	return 1;
+#elif !defined(_PSP)
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return 0;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	// the mapping keeps the file open
+	if(data == MAP_FAILED) return 0;
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	map->data = (const char *)data;
+	map->size = st.st_size;
+	map->mapped = 1;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+int readFile(const char *path, struct FileMap *map)
+{
+	memset(map, 0, sizeof(*map));
+	FILE *file = fopen(path, "rb");
+	if(!file) return 0;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *data = (char *)malloc(size > 0 ? size : 1);
+	if(!data || size < 0 || fread(data, 1, size, file) != (size_t)size) {
+		printf("*** Couldn't read %s\n", path);
+		free(data);
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	map->data = data;
+	map->size = size;
+	return 1;
+}
+
+void unmapFile(struct FileMap *map)
+{
+	if(!map->data) return;
+	if(map->mapped == 2) {
+		// part of a pack's mapping,  which stays until closePacks
+	} else if(map->mapped) {
+#if defined(_WIN32)
+		UnmapViewOfFile(map->data);
+		CloseHandle((HANDLE)map->handle);
+#elif !defined(_PSP)
+		munmap((void *)map->data, map->size);
+#endif
+	} else {
+		free((void *)map->data);
+	}
+	memset(map, 0, sizeof(*map));
+}
+
+int fileStamp(const char *path, long long *time, long long *size)
+{
+	struct stat st;
+	*time = 0;
+	*size = -1;
+	if(stat(path, &st) != 0) return 0;
+	*time = (long long)st.st_mtime;
+	*size = (long long)st.st_size;
+	return 1;
+}
+
+unsigned long long hashBytes(const void *data, size_t size)
+{
+	const unsigned char *s = (const unsigned char *)data;
+	unsigned long long hash = 14695981039346656037ULL;
+	size_t i;
+	for(i = 0; i < size; i++) {
+		hash ^= s[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+unsigned long long hashFile(const char *path)
+{
+	struct FileMap map;
+	if(!mapFile(path, &map) && !readFile(path, &map)) return 0;
+	unsigned long long hash = hashBytes(map.data, map.size);
+	unmapFile(&map);
+	return hash;
+}
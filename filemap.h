@@ -0,0 +1,20 @@
+/* File maps */
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stddef.h>
+
+// filemap.c
+struct FileMap {
+	const char *data;	// whole file, not null terminated
+	size_t size;
+	int mapped;		// 1 if data is a memory mapping, 0 if it was read into a buffer, 2 if it points into a pack
+	void *handle;	// windows file mapping handle
+};
+int mapFile(const char *path, struct FileMap *map);	// mmap the file read only, returns 0 on failure
+int readFile(const char *path, struct FileMap *map);	// buffered read of the whole file, returns 0 on failure
+void unmapFile(struct FileMap *map);	// release either kind
+int fileStamp(const char *path, long long *time, long long *size);	// modification time and size, returns 0 if missing
+unsigned long long hashBytes(const void *data, size_t size);	// 64 bit FNV-1a
+unsigned long long hashFile(const char *path);	// hashBytes of the whole file, 0 if missing
+#endif
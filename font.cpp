@@ -7,6 +7,7 @@
 #endif
 #include "font.h"
 #include "main.h"
+#include "pack.h"
 
 int round2(double x){
 	return (int)(x + 0.5);
@@ -41,7 +42,11 @@ CFontManager &CFontManager::getManager(void) {
 
 void CFontManager::Add(enum FontID fontId, const char *filepath, int size){
 
-     TTF_Font * font = TTF_OpenFont(filepath, size);
+     // loose or packed, each file is only mapped once however many sizes are made from it.
+     struct FileMap &map = FileMaps[filepath];
+     TTF_Font * font = 0;
+     if(map.data || mapPackedFile(filepath, &map))
+        font = TTF_OpenFontRW(SDL_RWFromConstMem(map.data, (int)map.size), 1, size);
      if(!font)
 		printf("Error loading font: %s", TTF_GetError());
      else
@@ -4,6 +4,7 @@
 #define Font	CFontManager::getManager()
 
 #include <map>
+#include <string>
 
 //#include <SDL/SDL.h>
 #include <SDL2/SDL_ttf.h>
@@ -22,6 +23,8 @@
 #endif
 #endif // 0
 
+#include "filemap.h"
+
 enum FontID {
 	FONT_HEADLINE, FONT_BODY, FONT_BODYHIGHLIGHT, FONT_MESSAGE, FONT_SMALL,
     FONT_SMALLHIGHLIGHT
@@ -35,6 +38,7 @@ class CFontManager
 
 	private:
 		std::map < enum FontID, TTF_Font*> FontMap;
+		std::map < std::string, struct FileMap> FileMaps;	// SDL_ttf reads the font lazily, so these stay
 
 	public:
 		void Add(enum FontID fontId, const char *filepath, int size);
@@ -0,0 +1,129 @@
+/* glprocs - looks up the GL entry points past 1.1, which windows' opengl32 doesn't export */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "glprocs.h"
+
+int glBufferObjects = 0;
+int glPixelBufferObjects = 0;
+int glShaders = 0;
+int glInstancing = 0;
+int glProgramBinaries = 0;
+PFNGLGENBUFFERSPROC pglGenBuffers = 0;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers = 0;
+PFNGLBINDBUFFERPROC pglBindBuffer = 0;
+PFNGLBUFFERDATAPROC pglBufferData = 0;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData = 0;
+PFNGLMAPBUFFERPROC pglMapBuffer = 0;
+PFNGLUNMAPBUFFERPROC pglUnmapBuffer = 0;
+PFNGLCREATESHADERPROC pglCreateShader = 0;
+PFNGLSHADERSOURCEPROC pglShaderSource = 0;
+PFNGLCOMPILESHADERPROC pglCompileShader = 0;
+PFNGLGETSHADERIVPROC pglGetShaderiv = 0;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog = 0;
+PFNGLDELETESHADERPROC pglDeleteShader = 0;
+PFNGLCREATEPROGRAMPROC pglCreateProgram = 0;
+PFNGLATTACHSHADERPROC pglAttachShader = 0;
+PFNGLLINKPROGRAMPROC pglLinkProgram = 0;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv = 0;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog = 0;
+PFNGLDELETEPROGRAMPROC pglDeleteProgram = 0;
+PFNGLUSEPROGRAMPROC pglUseProgram = 0;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation = 0;
+PFNGLGETATTRIBLOCATIONPROC pglGetAttribLocation = 0;
+PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation = 0;
+PFNGLUNIFORM1IPROC pglUniform1i = 0;
+PFNGLUNIFORM3FPROC pglUniform3f = 0;
+PFNGLVERTEXATTRIB4FPROC pglVertexAttrib4f = 0;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer = 0;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray = 0;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = 0;
+PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor = 0;
+PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced = 0;
+PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced = 0;
+PFNGLGETPROGRAMBINARYPROC pglGetProgramBinary = 0;
+PFNGLPROGRAMBINARYPROC pglProgramBinary = 0;
+PFNGLPROGRAMPARAMETERIPROC pglProgramParameteri = 0;
+
+// core name first, then the ARB one for older drivers.
+static void *findProc(const char *name)
+{
+	char arb[64];
+	void *proc = SDL_GL_GetProcAddress(name);
+	if(proc) return proc;
+	snprintf(arb, sizeof(arb), "%sARB", name);
+	return SDL_GL_GetProcAddress(arb);
+}
+
+static int glVersion()
+{
+	const char *version = (const char *)glGetString(GL_VERSION);
+	int major = 1, minor = 1;
+	if(version) sscanf(version, "%d.%d", &major, &minor);
+	return major * 10 + minor;
+}
+
+int loadGLProcs()
+{
+	int version = glVersion();
+	pglGenBuffers = (PFNGLGENBUFFERSPROC)findProc("glGenBuffers");
+	pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)findProc("glDeleteBuffers");
+	pglBindBuffer = (PFNGLBINDBUFFERPROC)findProc("glBindBuffer");
+	pglBufferData = (PFNGLBUFFERDATAPROC)findProc("glBufferData");
+	pglBufferSubData = (PFNGLBUFFERSUBDATAPROC)findProc("glBufferSubData");
+	pglMapBuffer = (PFNGLMAPBUFFERPROC)findProc("glMapBuffer");
+	pglUnmapBuffer = (PFNGLUNMAPBUFFERPROC)findProc("glUnmapBuffer");
+	glBufferObjects = (version >= 15 || SDL_GL_ExtensionSupported("GL_ARB_vertex_buffer_object")) &&
+		pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData && pglBufferSubData && pglMapBuffer && pglUnmapBuffer;
+	glPixelBufferObjects = glBufferObjects && (version >= 21 || SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object"));
+
+	// the ARB_shader_objects names and handles are different enough that only 2.0 counts.
+	pglCreateShader = (PFNGLCREATESHADERPROC)SDL_GL_GetProcAddress("glCreateShader");
+	pglShaderSource = (PFNGLSHADERSOURCEPROC)SDL_GL_GetProcAddress("glShaderSource");
+	pglCompileShader = (PFNGLCOMPILESHADERPROC)SDL_GL_GetProcAddress("glCompileShader");
+	pglGetShaderiv = (PFNGLGETSHADERIVPROC)SDL_GL_GetProcAddress("glGetShaderiv");
+	pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)SDL_GL_GetProcAddress("glGetShaderInfoLog");
+	pglDeleteShader = (PFNGLDELETESHADERPROC)SDL_GL_GetProcAddress("glDeleteShader");
+	pglCreateProgram = (PFNGLCREATEPROGRAMPROC)SDL_GL_GetProcAddress("glCreateProgram");
+	pglAttachShader = (PFNGLATTACHSHADERPROC)SDL_GL_GetProcAddress("glAttachShader");
+	pglLinkProgram = (PFNGLLINKPROGRAMPROC)SDL_GL_GetProcAddress("glLinkProgram");
+	pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)SDL_GL_GetProcAddress("glGetProgramiv");
+	pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)SDL_GL_GetProcAddress("glGetProgramInfoLog");
+	pglDeleteProgram = (PFNGLDELETEPROGRAMPROC)SDL_GL_GetProcAddress("glDeleteProgram");
+	pglUseProgram = (PFNGLUSEPROGRAMPROC)SDL_GL_GetProcAddress("glUseProgram");
+	pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)SDL_GL_GetProcAddress("glGetUniformLocation");
+	pglGetAttribLocation = (PFNGLGETATTRIBLOCATIONPROC)SDL_GL_GetProcAddress("glGetAttribLocation");
+	pglBindAttribLocation = (PFNGLBINDATTRIBLOCATIONPROC)SDL_GL_GetProcAddress("glBindAttribLocation");
+	pglUniform1i = (PFNGLUNIFORM1IPROC)SDL_GL_GetProcAddress("glUniform1i");
+	pglUniform3f = (PFNGLUNIFORM3FPROC)SDL_GL_GetProcAddress("glUniform3f");
+	pglVertexAttrib4f = (PFNGLVERTEXATTRIB4FPROC)SDL_GL_GetProcAddress("glVertexAttrib4f");
+	pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)SDL_GL_GetProcAddress("glVertexAttribPointer");
+	pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)SDL_GL_GetProcAddress("glEnableVertexAttribArray");
+	pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)SDL_GL_GetProcAddress("glDisableVertexAttribArray");
+	glShaders = version >= 20 && pglCreateShader && pglShaderSource && pglCompileShader && pglGetShaderiv && pglGetShaderInfoLog &&
+		pglDeleteShader && pglCreateProgram && pglAttachShader && pglLinkProgram && pglGetProgramiv && pglGetProgramInfoLog &&
+		pglDeleteProgram && pglUseProgram && pglGetUniformLocation && pglGetAttribLocation && pglBindAttribLocation && pglUniform1i && pglUniform3f &&
+		pglVertexAttrib4f && pglVertexAttribPointer && pglEnableVertexAttribArray && pglDisableVertexAttribArray;
+
+	pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)findProc("glVertexAttribDivisor");
+	pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)findProc("glDrawElementsInstanced");
+	pglDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)findProc("glDrawArraysInstanced");
+	glInstancing = glShaders && glBufferObjects && pglVertexAttribDivisor && pglDrawElementsInstanced && pglDrawArraysInstanced &&
+		(version >= 33 || (SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") && (version >= 31 || SDL_GL_ExtensionSupported("GL_ARB_draw_instanced"))));
+
+	// drivers may have the calls and still no format to save in.
+	GLint formats = 0;
+	pglGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+	pglProgramBinary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+	pglProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+	glProgramBinaries = glShaders && pglGetProgramBinary && pglProgramBinary && pglProgramParameteri &&
+		(version >= 41 || SDL_GL_ExtensionSupported("GL_ARB_get_program_binary"));
+	if(glProgramBinaries) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	glProgramBinaries = glProgramBinaries && formats > 0;
+	printf("GL %d.%d: buffer objects %s, pixel buffer objects %s, shaders %s, instancing %s, program binaries %s\n", version / 10, version % 10,
+		glBufferObjects ? "yes" : "no", glPixelBufferObjects ? "yes" : "no", glShaders ? "yes" : "no", glInstancing ? "yes" : "no",
+		glProgramBinaries ? "yes" : "no");
+	return glBufferObjects;
+}
@@ -0,0 +1,49 @@
+/* GL entry points */
+#ifndef GLPROCS_H
+#define GLPROCS_H
+
+#include <SDL_opengl.h>
+
+// glprocs.c
+extern int glBufferObjects;	// glGenBuffers and friends are there (1.5 or ARB_vertex_buffer_object)
+extern int glPixelBufferObjects;	// and GL_PIXEL_UNPACK_BUFFER works with them (2.1 or ARB_pixel_buffer_object)
+extern int glShaders;	// GLSL programs (2.0)
+extern int glInstancing;	// glDrawElementsInstanced with per instance attributes (3.3 or ARB_draw_instanced and ARB_instanced_arrays)
+extern int glProgramBinaries;	// linked programs can be saved and loaded again (4.1 or ARB_get_program_binary, with a format to save in)
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+extern PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+extern PFNGLMAPBUFFERPROC pglMapBuffer;
+extern PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+extern PFNGLCREATESHADERPROC pglCreateShader;
+extern PFNGLSHADERSOURCEPROC pglShaderSource;
+extern PFNGLCOMPILESHADERPROC pglCompileShader;
+extern PFNGLGETSHADERIVPROC pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+extern PFNGLDELETESHADERPROC pglDeleteShader;
+extern PFNGLCREATEPROGRAMPROC pglCreateProgram;
+extern PFNGLATTACHSHADERPROC pglAttachShader;
+extern PFNGLLINKPROGRAMPROC pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+extern PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+extern PFNGLUSEPROGRAMPROC pglUseProgram;
+extern PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+extern PFNGLGETATTRIBLOCATIONPROC pglGetAttribLocation;
+extern PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation;
+extern PFNGLUNIFORM1IPROC pglUniform1i;
+extern PFNGLUNIFORM3FPROC pglUniform3f;
+extern PFNGLVERTEXATTRIB4FPROC pglVertexAttrib4f;
+extern PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor;
+extern PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced;
+extern PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced;
+extern PFNGLGETPROGRAMBINARYPROC pglGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC pglProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC pglProgramParameteri;
+int loadGLProcs();	// once the context is current, returns 0 if only GL 1.1 is there
+#endif
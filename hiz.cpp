@@ -0,0 +1,286 @@
+/* hiz - a small software depth buffer of the big occluders with a pyramid of the furthest depth
+   over it, so what's behind them can be skipped without reading anything back from the GPU */
+
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hiz.h"
+#include "jobs.h"
+
+#define HIZ_LEVELS 8	// 256 x 128 down to 2 x 1
+#define HIZ_BAND 16	// rows each job rasterizes
+#define HIZ_NEAR 1e-5f	// smallest w a corner may have, nearer than that the box is taken as showing
+
+struct HizTriangle {
+	float x[3], y[3];	// pixels, y up like GL's window coordinates
+	float z[3];	// 0 at the near plane to 1 at the far one
+	int minY, maxY;	// rows it may touch
+};
+
+static float *hizDepth[HIZ_LEVELS];	// 0 is the depth buffer, each one after the furthest of 2 x 2 of the one before
+static float hizProjection[16];
+static struct HizTriangle *hizTriangle = 0;
+static int hizTriangleCount = 0;
+static int hizTriangleMax = 0;
+static int hizReady = 0;	// finishOcclusion has run on something
+static SDL_atomic_t hizTested;	// occludedBox is called from the job threads
+static SDL_atomic_t hizCulled;
+static double hizRasterUs = 0;
+static SDL_atomic_t hizTestNs;
+
+static double hizTime()
+{
+	return SDL_GetPerformanceCounter() * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+static int hizLevelWidth(int level)
+{
+	return HIZ_WIDTH >> level;
+}
+
+static int hizLevelHeight(int level)
+{
+	return HIZ_HEIGHT >> level;
+}
+
+static void multiplyHizMatrix(float *out, const float *a, const float *b)
+{
+	int i, j;
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 4; j++) out[i * 4 + j] = a[j] * b[i * 4] + a[4 + j] * b[i * 4 + 1] + a[8 + j] * b[i * 4 + 2] + a[12 + j] * b[i * 4 + 3];
+	}
+}
+
+static void transformHizPoint(const float *m, const float *p, float *clip)
+{
+	int k;
+	for(k = 0; k < 4; k++) clip[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+}
+
+void beginOcclusion(const float *projection)
+{
+	int level;
+	for(level = 0; level < HIZ_LEVELS; level++) {
+		int size = hizLevelWidth(level) * hizLevelHeight(level), i;
+		if(!hizDepth[level]) hizDepth[level] = (float *)malloc(sizeof(float) * size);
+		for(i = 0; i < size; i++) hizDepth[level][i] = 1;	// nothing in front of the far plane
+	}
+	memcpy(hizProjection, projection, sizeof(hizProjection));
+	hizTriangleCount = 0;
+	hizReady = 0;
+	SDL_AtomicSet(&hizTested, 0);
+	SDL_AtomicSet(&hizCulled, 0);
+	SDL_AtomicSet(&hizTestNs, 0);
+	hizRasterUs = 0;
+}
+
+static void addHizTriangle(const float (*clip)[4])
+{
+	int i;
+	if(hizTriangleCount == hizTriangleMax) {
+		hizTriangleMax = hizTriangleMax < 256 ? 256 : hizTriangleMax * 2;
+		hizTriangle = (struct HizTriangle *)realloc(hizTriangle, sizeof(struct HizTriangle) * hizTriangleMax);
+	}
+	struct HizTriangle *t = hizTriangle + hizTriangleCount;
+	float minY = 1e30f, maxY = -1e30f;
+	for(i = 0; i < 3; i++) {
+		float w = 1 / clip[i][3];
+		t->x[i] = (clip[i][0] * w * 0.5f + 0.5f) * HIZ_WIDTH;
+		t->y[i] = (clip[i][1] * w * 0.5f + 0.5f) * HIZ_HEIGHT;
+		t->z[i] = clip[i][2] * w * 0.5f + 0.5f;
+		if(minY > t->y[i]) minY = t->y[i];
+		if(maxY < t->y[i]) maxY = t->y[i];
+	}
+	if(maxY < 0 || minY > HIZ_HEIGHT) return;
+	t->minY = minY < 0 ? 0 : (int)minY;
+	t->maxY = maxY >= HIZ_HEIGHT ? HIZ_HEIGHT - 1 : (int)maxY;
+	hizTriangleCount++;
+}
+
+// Clips against the near plane, z >= -w, which can leave a quad, and drops what's wholly off one side.
+static void clipHizTriangle(const float (*clip)[4])
+{
+	float out[4][4];
+	int i, k, count = 0, outside;
+	for(k = 0; k < 3; k++) {
+		for(outside = 0, i = 0; i < 3; i++) outside += clip[i][k] > clip[i][3];
+		if(outside == 3) return;
+		for(outside = 0, i = 0; i < 3; i++) outside += clip[i][k] < -clip[i][3];
+		if(outside == 3) return;
+	}
+	for(i = 0; i < 3; i++) {
+		const float *a = clip[i], *b = clip[(i + 1) % 3];
+		float da = a[2] + a[3], db = b[2] + b[3];
+		if(da >= 0) memcpy(out[count++], a, sizeof(float) * 4);
+		if((da >= 0) != (db >= 0)) {
+			float t = da / (da - db);
+			for(k = 0; k < 4; k++) out[count][k] = a[k] + (b[k] - a[k]) * t;
+			count++;
+		}
+	}
+	if(count < 3) return;
+	for(i = 0; i < count; i++) {
+		if(out[i][3] < HIZ_NEAR) return;	// only a sliver, and it would divide by nothing
+	}
+	addHizTriangle(out);
+	if(count == 4) {
+		memcpy(out[1], out[2], sizeof(float) * 4);
+		memcpy(out[2], out[3], sizeof(float) * 4);
+		addHizTriangle(out);
+	}
+}
+
+void addOccluder(const float *position, int stride, const void *index, int indexSize, int indexCount, const float *matrix)
+{
+	float m[16], clip[3][4];
+	int i, k;
+	multiplyHizMatrix(m, hizProjection, matrix);
+	for(i = 0; i + 2 < indexCount; i += 3) {
+		for(k = 0; k < 3; k++) {
+			int v = !index ? i + k : indexSize == 2 ? ((const unsigned short *)index)[i + k] : ((const unsigned int *)index)[i + k];
+			transformHizPoint(m, (const float *)((const char *)position + (size_t)stride * v), clip[k]);
+		}
+		clipHizTriangle(clip);
+	}
+}
+
+// One band of rows, every triangle that reaches it.  Both faces count.  Coverage is inner
+// conservative, a pixel is only written if the triangle covers all of it, so each edge is moved in
+// by as much as it changes over half a pixel.  What's written is the furthest depth over the pixel,
+// its centre's plus as much as it changes over half a pixel each way.  So every depth in the buffer
+// has an occluder at or in front of it across the whole pixel.
+static void rasterHizBand(void *arg, int band)
+{
+	int top = band * HIZ_BAND, bottom = top + HIZ_BAND - 1;
+	float *depth = hizDepth[0];
+	int i, x, y;
+	for(i = 0; i < hizTriangleCount; i++) {
+		const struct HizTriangle *t = hizTriangle + i;
+		if(t->maxY < top || t->minY > bottom) continue;
+		float area = (t->x[1] - t->x[0]) * (t->y[2] - t->y[0]) - (t->x[2] - t->x[0]) * (t->y[1] - t->y[0]);
+		if(area == 0) continue;
+		float sign = area < 0 ? -1.0f : 1.0f, inv = 1 / area;
+		float bias0 = (fabsf(t->x[2] - t->x[1]) + fabsf(t->y[2] - t->y[1])) * 0.5f;
+		float bias1 = (fabsf(t->x[0] - t->x[2]) + fabsf(t->y[0] - t->y[2])) * 0.5f;
+		float bias2 = (fabsf(t->x[1] - t->x[0]) + fabsf(t->y[1] - t->y[0])) * 0.5f;
+		float zdx = ((t->z[1] - t->z[0]) * (t->y[2] - t->y[0]) - (t->z[2] - t->z[0]) * (t->y[1] - t->y[0])) * inv;
+		float zdy = ((t->z[2] - t->z[0]) * (t->x[1] - t->x[0]) - (t->z[1] - t->z[0]) * (t->x[2] - t->x[0])) * inv;
+		float zSlack = (fabsf(zdx) + fabsf(zdy)) * 0.5f;
+		float minX = t->x[0], maxX = t->x[0];
+		for(x = 1; x < 3; x++) {
+			if(minX > t->x[x]) minX = t->x[x];
+			if(maxX < t->x[x]) maxX = t->x[x];
+		}
+		int x0 = minX < 0 ? 0 : (int)minX, x1 = maxX >= HIZ_WIDTH ? HIZ_WIDTH - 1 : (int)maxX;
+		int y0 = t->minY > top ? t->minY : top, y1 = t->maxY < bottom ? t->maxY : bottom;
+		for(y = y0; y <= y1; y++) {
+			float py = y + 0.5f;
+			for(x = x0; x <= x1; x++) {
+				float px = x + 0.5f;
+				float e0 = ((t->x[2] - t->x[1]) * (py - t->y[1]) - (t->y[2] - t->y[1]) * (px - t->x[1])) * sign;
+				float e1 = ((t->x[0] - t->x[2]) * (py - t->y[2]) - (t->y[0] - t->y[2]) * (px - t->x[2])) * sign;
+				float e2 = ((t->x[1] - t->x[0]) * (py - t->y[0]) - (t->y[1] - t->y[0]) * (px - t->x[0])) * sign;
+				if(e0 < bias0 || e1 < bias1 || e2 < bias2) continue;
+				float z = (e0 * t->z[0] + e1 * t->z[1] + e2 * t->z[2]) * inv * sign + zSlack;
+				float *d = depth + y * HIZ_WIDTH + x;
+				if(z < *d) *d = z;
+			}
+		}
+	}
+}
+
+void finishOcclusion()
+{
+	int level, x, y;
+	hizReady = hizTriangleCount > 0;
+	if(!hizReady) return;	// still all far from beginOcclusion
+	double start = hizTime();
+	runParallel(rasterHizBand, 0, HIZ_HEIGHT / HIZ_BAND);
+	for(level = 1; level < HIZ_LEVELS; level++) {
+		const float *from = hizDepth[level - 1];
+		float *to = hizDepth[level];
+		int width = hizLevelWidth(level), fromWidth = hizLevelWidth(level - 1);
+		for(y = 0; y < hizLevelHeight(level); y++) {
+			for(x = 0; x < width; x++) {
+				const float *a = from + (y * 2) * fromWidth + x * 2, *b = a + fromWidth;
+				float far = a[0] > a[1] ? a[0] : a[1];
+				if(far < b[0]) far = b[0];
+				if(far < b[1]) far = b[1];
+				to[y * width + x] = far;
+			}
+		}
+	}
+	hizRasterUs += hizTime() - start;
+}
+
+// The box's nearest depth against the furthest occluder depth over the pixels it covers, read from
+// the level where that's only a few texels.
+int occludedBox(const float *min, const float *max, const float *matrix)
+{
+	if(!hizReady) return 0;
+	double start = hizTime();
+	float m[16], clip[4], minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearZ = 1e30f;
+	int i, occluded = 0;
+	multiplyHizMatrix(m, hizProjection, matrix);
+	SDL_AtomicAdd(&hizTested, 1);
+	for(i = 0; i < 8; i++) {
+		float corner[3] = { i & 1 ? max[0] : min[0], i & 2 ? max[1] : min[1], i & 4 ? max[2] : min[2] };
+		transformHizPoint(m, corner, clip);
+		if(clip[3] < HIZ_NEAR || clip[2] < -clip[3]) break;	// reaches the near plane, so it can't be behind anything
+		float w = 1 / clip[3];
+		float x = (clip[0] * w * 0.5f + 0.5f) * HIZ_WIDTH, y = (clip[1] * w * 0.5f + 0.5f) * HIZ_HEIGHT, z = clip[2] * w * 0.5f + 0.5f;
+		if(minX > x) minX = x;
+		if(maxX < x) maxX = x;
+		if(minY > y) minY = y;
+		if(maxY < y) maxY = y;
+		if(nearZ > z) nearZ = z;
+	}
+	if(i == 8) {
+		int x0 = (int)floorf(minX), x1 = (int)floorf(maxX), y0 = (int)floorf(minY), y1 = (int)floorf(maxY);
+		if(x0 < 0) x0 = 0;
+		if(y0 < 0) y0 = 0;
+		if(x1 >= HIZ_WIDTH) x1 = HIZ_WIDTH - 1;
+		if(y1 >= HIZ_HEIGHT) y1 = HIZ_HEIGHT - 1;
+		if(x0 <= x1 && y0 <= y1) {
+			int level = 0, x, y;
+			while(level + 1 < HIZ_LEVELS && ((x1 >> level) - (x0 >> level) > 2 || (y1 >> level) - (y0 >> level) > 2)) level++;
+			const float *depth = hizDepth[level];
+			int width = hizLevelWidth(level);
+			float far = 0;
+			for(y = y0 >> level; y <= y1 >> level; y++) {
+				for(x = x0 >> level; x <= x1 >> level; x++) {
+					if(far < depth[y * width + x]) far = depth[y * width + x];
+				}
+			}
+			occluded = nearZ > far;
+		}
+	}
+	if(occluded) SDL_AtomicAdd(&hizCulled, 1);
+	SDL_AtomicAdd(&hizTestNs, (int)((hizTime() - start) * 1000));
+	return occluded;
+}
+
+void getOcclusionStats(int *triangles, int *tested, int *culled, double *rasterUs, double *testUs)
+{
+	if(triangles) *triangles = hizTriangleCount;
+	if(tested) *tested = SDL_AtomicGet(&hizTested);
+	if(culled) *culled = SDL_AtomicGet(&hizCulled);
+	if(rasterUs) *rasterUs = hizRasterUs;
+	if(testUs) *testUs = SDL_AtomicGet(&hizTestNs) / 1000.0;	// summed over the threads
+}
+
+void freeOcclusion()
+{
+	int level;
+	for(level = 0; level < HIZ_LEVELS; level++) {
+		free(hizDepth[level]);
+		hizDepth[level] = 0;
+	}
+	free(hizTriangle);
+	hizTriangle = 0;
+	hizTriangleCount = hizTriangleMax = 0;
+	hizReady = 0;
+}
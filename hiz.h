@@ -0,0 +1,14 @@
+/* Software occlusion */
+#ifndef HIZ_H
+#define HIZ_H
+
+// hiz.c
+#define HIZ_WIDTH 256	// depth buffer size, stretched over the whole view
+#define HIZ_HEIGHT 128
+void beginOcclusion(const float *projection);	// clears the depth buffer for this frame's occluders, projection is GL's
+void addOccluder(const float *position, int stride, const void *index, int indexSize, int indexCount, const float *matrix);	// triangles, stride in bytes, index 0 for corners in order, matrix takes them to eye space
+void finishOcclusion();	// rasterizes the occluders across the job threads and builds the max depth pyramid, with none nothing is occluded
+int occludedBox(const float *min, const float *max, const float *matrix);	// 1 if it's certainly behind the occluders finished last, matrix takes it to eye space, safe from several job threads at once, drawWavefrontQueue's jobs test its groups with it
+void getOcclusionStats(int *triangles, int *tested, int *culled, double *rasterUs, double *testUs);	// since beginOcclusion
+void freeOcclusion();
+#endif
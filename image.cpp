@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include <libpng16/png.h>
+#include <SDL.h>
 
 #ifdef _PSP
 #include <pspgu.h>
@@ -22,15 +23,15 @@
 #else
 #include <GL/gl.h>
 #endif
-
-#include <SDL/SDL.h>
 #endif
 
 #include "main.h"
+#include "filemap.h"
+#include "pack.h"
 //#define Color unsigned long
 
 #define MAX(X, Y) ((X) > (Y) ? (X) : (Y))
-int imageRamAlloc = 0;
+SDL_atomic_t imageRamAlloc;	// bytes of pixels in main memory, images are loaded on the job threads too
 void freeVRam(void *address, int length);
 
 static int getNextPower2(int width)
@@ -60,21 +61,36 @@ Image *newImage(int width, int height)
 	while((image->textureHeight >> 1) >= height) image->textureHeight >>= 1;
 
 	image->data = (Color *)malloc(image->imageHeight * image->textureWidth * 4);
-	imageRamAlloc += image->imageHeight * image->textureWidth * 4;
-//printf("NEWImage ram usage: %.4f MB\n",imageRamAlloc/(1024.0f*1024.0f));
+	SDL_AtomicAdd(&imageRamAlloc, image->imageHeight * image->textureWidth * 4);
+//printf("NEWImage ram usage: %.4f MB\n",SDL_AtomicGet(&imageRamAlloc)/(1024.0f*1024.0f));
 
 	return image;
 }
 
+// libpng reads from the mapped or unpacked file instead of a FILE.
+struct PngSource {
+	const char *data;
+	size_t size;
+	size_t offset;
+};
+
+static void readPngData(png_structp png_ptr, png_bytep out, png_size_t length)
+{
+	struct PngSource *source = (struct PngSource *)png_get_io_ptr(png_ptr);
+	if (length > source->size - source->offset) png_error(png_ptr, "Read Error");
+	memcpy(out, source->data + source->offset, length);
+	source->offset += length;
+}
+
 Image* loadPng(const char* filename)
 {
 	png_structp png_ptr;
 	png_infop info_ptr;
 	unsigned int sig_read = 0;
 	png_uint_32 width, height;
-	int bit_depth, color_type, interlace_type, x, y;
-	unsigned int* line;
-	FILE *fp;
+	int bit_depth, color_type, interlace_type, y;
+	struct FileMap map;
+	struct PngSource source;
 	Image* image = (Image*) malloc(sizeof(Image));
 	if (!image) return NULL;
 	image->texid = 0;
@@ -82,14 +98,21 @@ Image* loadPng(const char* filename)
 	image->vram = 0;
 	image->palette = 0;
 	image->format = GU_PSM_8888;
+	snprintf(image->filename, sizeof(image->filename), "%s", filename);
 
 	//printf("Loading image '%s'\n",filename);
 
-	if ((fp = fopen(filename, "rb")) == NULL) return NULL;
+	if (!mapPackedFile(filename, &map)) {
+		free(image);
+		return NULL;
+	}
+	source.data = map.data;
+	source.size = map.size;
+	source.offset = 0;
 	png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png_ptr == NULL) {
 		free(image);
-		fclose(fp);
+		unmapFile(&map);
 		printf("Couldn't load %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
 		return NULL;
 	}
@@ -97,12 +120,12 @@ Image* loadPng(const char* filename)
 	info_ptr = png_create_info_struct(png_ptr);
 	if (info_ptr == NULL) {
 		free(image);
-		fclose(fp);
+		unmapFile(&map);
 		png_destroy_read_struct(&png_ptr, NULL, NULL);
 		printf("Couldn't load %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
 		return NULL;
 	}
-	png_init_io(png_ptr, fp);
+	png_set_read_fn(png_ptr, &source, readPngData);
 	png_set_sig_bytes(png_ptr, sig_read);
 	png_read_info(png_ptr, info_ptr);
 	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type, NULL, NULL);
@@ -112,7 +135,7 @@ Image* loadPng(const char* filename)
 	if (width > 2048 || height > 2048) {
 #endif
 		free(image);
-		fclose(fp);
+		unmapFile(&map);
 		png_destroy_read_struct(&png_ptr, NULL, NULL);
 		printf("Couldn't load %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
 		return NULL;
@@ -140,33 +163,20 @@ Image* loadPng(const char* filename)
 
 	if (!image->data) {
 		free(image);
-		fclose(fp);
-		png_destroy_read_struct(&png_ptr, NULL, NULL);
-		printf("Couldn't load %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
-		return NULL;
-	}
-	imageRamAlloc += image->imageHeight * image->textureWidth * 4;
-//printf("LOADImage ram usage: %.4f MB\n",imageRamAlloc/(1024.0f*1024.0f));
-	line = (unsigned int *) malloc(width * 4);
-	if (!line) {
-		free(image->data);
-		free(image);
-		fclose(fp);
+		unmapFile(&map);
 		png_destroy_read_struct(&png_ptr, NULL, NULL);
 		printf("Couldn't load %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
 		return NULL;
 	}
+	SDL_AtomicAdd(&imageRamAlloc, image->imageHeight * image->textureWidth * 4);
+//printf("LOADImage ram usage: %.4f MB\n",SDL_AtomicGet(&imageRamAlloc)/(1024.0f*1024.0f));
+	// rows are already in Color order,  so they go straight into the texture without a line buffer.
 	for (y = 0; y < (int)height; y++) {
-		png_read_row(png_ptr, (unsigned char *) line, NULL);
-		for (x = 0; x < (int)width; x++) {
-			unsigned int color = line[x];
-			image->data[x + y * image->textureWidth] = color;
-		}
+		png_read_row(png_ptr, (unsigned char *) (image->data + y * image->textureWidth), NULL);
 	}
-	free(line);
 	png_read_end(png_ptr, info_ptr);
 	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-	fclose(fp);
+	unmapFile(&map);
 	printf("Loaded %s (%08lx)\n", filename, (long unsigned int)(intptr_t)image);
 	return image;
 }
@@ -213,8 +223,8 @@ void freeImage(Image *image)
 	if(!image) return;
 	if(image->data && image->vram == 0) {
 		free(image->data);
-		imageRamAlloc -= image->imageHeight * image->textureWidth * 4;
-//printf("FREEImage ram usage: %.4f MB\n",imageRamAlloc/(1024.0f*1024.0f));
+		SDL_AtomicAdd(&imageRamAlloc, -image->imageHeight * image->textureWidth * 4);
+//printf("FREEImage ram usage: %.4f MB\n",SDL_AtomicGet(&imageRamAlloc)/(1024.0f*1024.0f));
 	} else if(image->data && image->vram) {
 		freeVRam(image->data, image->imageHeight * image->textureWidth * 4);
 	}
@@ -267,7 +277,6 @@ void saveImagePng(const char* filename, Color* data, int width, int height, int
 	fclose(fp);
 }
 
-int swizzleToVRam = 1;
 //unsigned char *nextVRam=(unsigned char *)0x04000000+0x154000;	// after depth buffer
 int availableVRam = 0x200000 - 0x154000;
 int biggestVRam = 0;
@@ -394,7 +403,8 @@ void freeVRam(void *address, int length)
 	printf("free: "); reportVRam();
 }
 
-void swizzleFast(Image *source)
+// Only on the main thread when toVRam is set, allocVRam has no lock.
+void swizzleFast(Image *source, int toVRam)
 {
 	if(source == 0) return;
 #ifdef _PSP
@@ -402,14 +412,14 @@ void swizzleFast(Image *source)
 	unsigned int height = source->imageHeight;
 	unsigned long* out;
 
-	if(swizzleToVRam && (out = (unsigned long*)allocVRam(width * height))) {
+	if(toVRam && (out = (unsigned long*)allocVRam(width * height))) {
 		printf("texture to vram\n");
 		source->vram = 1;
 	} else {
 		out = (unsigned long *)malloc(width * height);
 		if(!out) return;	// couldn't do it!
-		imageRamAlloc += width * height;
-//printf("SWIZ^Image ram usage: %.4f MB\n",imageRamAlloc/(1024.0f*1024.0f));
+		SDL_AtomicAdd(&imageRamAlloc, width * height);
+//printf("SWIZ^Image ram usage: %.4f MB\n",SDL_AtomicGet(&imageRamAlloc)/(1024.0f*1024.0f));
 	}
 	unsigned int blockx, blocky;
 	int i;
@@ -439,8 +449,8 @@ void swizzleFast(Image *source)
 		ysrc += srcRow;
 	}
 	free(source->data);
-	imageRamAlloc -= width * height;
-//printf("SWIZvImage ram usage: %.4f MB\n",imageRamAlloc/(1024.0f*1024.0f));
+	SDL_AtomicAdd(&imageRamAlloc, -(int)(width * height));
+//printf("SWIZvImage ram usage: %.4f MB\n",SDL_AtomicGet(&imageRamAlloc)/(1024.0f*1024.0f));
 	source->data=(Color *)out;
 	source->isSwizzled = 1;
 #endif
@@ -573,7 +583,7 @@ int loadFastFont(struct FastFont *font, const char *filename)
 				font->texture = loadPng(imagePath);
 			}
 #ifdef _PSP
-			swizzleFast(font->texture);
+			swizzleFast(font->texture, 0);	// fonts stay out of VRAM
 #endif
 			if(font->texture) printf("Loaded %s\n", imagePath);
 			else printf("Could not find '%s'\n", imagePath);
@@ -586,15 +596,12 @@ int loadFastFont(struct FastFont *font, const char *filename)
 
 void initFastFont()
 {
-	int oldVRam = swizzleToVRam;
-	swizzleToVRam = 0;
 	loadFastFont(&fastFont[FONT_HEADLINE], "data/Headline32bluered.fnt");
 	loadFastFont(&fastFont[FONT_BODY], "data/Body20blue.fnt");
 	loadFastFont(&fastFont[FONT_BODYHIGHLIGHT], "data/Body20brown.fnt");
 	loadFastFont(&fastFont[FONT_MESSAGE], "data/Body14blue.fnt");
 	loadFastFont(&fastFont[FONT_SMALL], "data/Small10red.fnt");
 	loadFastFont(&fastFont[FONT_SMALLHIGHLIGHT], "data/Small10black.fnt");
-	swizzleToVRam = oldVRam;
 }
 
 void extentMessage(int *w,int *h, enum FontId fontId, const char *message)
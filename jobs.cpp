@@ -0,0 +1,201 @@
+/* jobs - a small worker thread pool for splitting up loading and frame work */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobs.h"
+
+#define MAX_JOB_THREADS 64
+
+struct Job {
+	void (*fn)(void *arg, int index);
+	void *arg;
+	int index;
+	SDL_atomic_t *pending;	// counted down as the batch finishes, 0 for runAsync
+	volatile int *done;	// runAsync sets it once fn has returned
+};
+
+static SDL_mutex *jobLock = 0;
+static SDL_cond *jobReady = 0;	// signalled when jobs are queued
+static SDL_cond *jobDone = 0;	// signalled when a batch finishes
+static SDL_Thread *worker[MAX_JOB_THREADS];
+static int workerCount = 0;
+static int quitting = 0;
+
+// ring buffer of queued jobs, guarded by jobLock.
+static struct Job *queue = 0;
+static int queueHead = 0;
+static int queueCount = 0;
+static int queueMax = 0;
+
+static void pushJob(struct Job *job)
+{
+	if(queueCount == queueMax) {
+		int newMax = queueMax < 64 ? 64 : queueMax * 2;
+		struct Job *grown = (struct Job *)malloc(sizeof(struct Job) * newMax);
+		int i;
+		for(i = 0; i < queueCount; i++) grown[i] = queue[(queueHead + i) % queueMax];
+		free(queue);
+		queue = grown;
+		queueHead = 0;
+		queueMax = newMax;
+	}
+	queue[(queueHead + queueCount++) % queueMax] = *job;
+}
+
+static void popJob(struct Job *job)
+{
+	*job = queue[queueHead];
+	queueHead = (queueHead + 1) % queueMax;
+	queueCount--;
+}
+
+// the first queued job of one batch, so a waiting caller only ever picks up its own work.
+static int takeJob(struct Job *job, SDL_atomic_t *pending)
+{
+	int i;
+	for(i = 0; i < queueCount; i++) {
+		if(queue[(queueHead + i) % queueMax].pending == pending) break;
+	}
+	if(i == queueCount) return 0;
+	*job = queue[(queueHead + i) % queueMax];
+	for(; i > 0; i--) queue[(queueHead + i) % queueMax] = queue[(queueHead + i - 1) % queueMax];
+	queueHead = (queueHead + 1) % queueMax;
+	queueCount--;
+	return 1;
+}
+
+// run a job with the lock released, then wake whoever waits on its batch.
+static void runJob(struct Job *job)
+{
+	SDL_UnlockMutex(jobLock);
+	job->fn(job->arg, job->index);
+	SDL_LockMutex(jobLock);
+	if(job->done) *job->done = 1;	// the mutex orders it after everything fn wrote
+	if(job->pending && SDL_AtomicAdd(job->pending, -1) == 1) SDL_CondBroadcast(jobDone);
+}
+
+static int jobWorker(void *data)
+{
+	struct Job job;
+
+	SDL_LockMutex(jobLock);
+	for(;;) {
+		while(!quitting && queueCount == 0) SDL_CondWait(jobReady, jobLock);
+		if(quitting) break;
+		popJob(&job);
+		runJob(&job);
+	}
+	SDL_UnlockMutex(jobLock);
+	return 0;
+}
+
+void initJobs(int threads)
+{
+	if(jobLock) return;
+	if(threads <= 0) threads = SDL_GetCPUCount() - 1;
+	if(threads > MAX_JOB_THREADS) threads = MAX_JOB_THREADS;
+	jobLock = SDL_CreateMutex();
+	jobReady = SDL_CreateCond();
+	jobDone = SDL_CreateCond();
+	quitting = 0;
+	for(workerCount = 0; workerCount < threads; workerCount++) {
+		worker[workerCount] = SDL_CreateThread(jobWorker, "jobs", 0);
+		if(!worker[workerCount]) {
+			printf("*** Couldn't start job thread: %s\n", SDL_GetError());
+			break;
+		}
+	}
+	printf("Started %d job threads\n", workerCount);
+}
+
+void shutdownJobs()
+{
+	int i;
+	if(!jobLock) return;
+	SDL_LockMutex(jobLock);
+	quitting = 1;
+	SDL_CondBroadcast(jobReady);
+	SDL_UnlockMutex(jobLock);
+	for(i = 0; i < workerCount; i++) SDL_WaitThread(worker[i], 0);
+	workerCount = 0;
+	SDL_DestroyCond(jobDone);
+	SDL_DestroyCond(jobReady);
+	SDL_DestroyMutex(jobLock);
+	jobLock = 0;
+	free(queue);
+	queue = 0;
+	queueHead = queueCount = queueMax = 0;
+}
+
+int jobThreads()
+{
+	if(!jobLock) initJobs(0);
+	return workerCount;
+}
+
+void runParallel(void (*fn)(void *arg, int index), void *arg, int count)
+{
+	SDL_atomic_t pending;
+	struct Job job;
+	int i;
+
+	if(count <= 0) return;
+	if(!jobLock) initJobs(0);
+	if(count == 1 || workerCount == 0) {
+		for(i = 0; i < count; i++) fn(arg, i);
+		return;
+	}
+	SDL_AtomicSet(&pending, count);
+	job.fn = fn;
+	job.arg = arg;
+	job.pending = &pending;
+	job.done = 0;
+	SDL_LockMutex(jobLock);
+	for(i = 0; i < count; i++) {
+		job.index = i;
+		pushJob(&job);
+	}
+	SDL_CondBroadcast(jobReady);
+	// help out rather than sleep, which also keeps nested runParallel calls from a worker safe.
+	// only with this batch though, an async load picked up here would stall the caller.
+	while(SDL_AtomicGet(&pending) > 0) {
+		if(takeJob(&job, &pending)) runJob(&job);
+		else SDL_CondWait(jobDone, jobLock);
+	}
+	SDL_UnlockMutex(jobLock);
+}
+
+void runAsync(void (*fn)(void *arg, int index), void *arg, volatile int *done)
+{
+	struct Job job;
+
+	*done = 0;
+	if(!jobLock) initJobs(0);
+	if(workerCount == 0) {
+		fn(arg, 0);
+		*done = 1;
+		return;
+	}
+	job.fn = fn;
+	job.arg = arg;
+	job.index = 0;
+	job.pending = 0;
+	job.done = done;
+	SDL_LockMutex(jobLock);
+	pushJob(&job);
+	SDL_CondSignal(jobReady);
+	SDL_UnlockMutex(jobLock);
+}
+
+int asyncDone(volatile int *done)
+{
+	int value;
+	// taking the lock pairs with the store in runJob.
+	SDL_LockMutex(jobLock);
+	value = *done;
+	SDL_UnlockMutex(jobLock);
+	return value;
+}
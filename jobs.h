@@ -0,0 +1,12 @@
+/* Jobs */
+#ifndef JOBS_H
+#define JOBS_H
+
+// jobs.c
+void initJobs(int threads);	// start the worker pool, 0 = one thread per extra core
+void shutdownJobs();
+int jobThreads();	// worker threads, not counting the caller
+void runParallel(void (*fn)(void *arg, int index), void *arg, int count);	// fn(arg, 0..count-1) across the pool, returns when all are done
+void runAsync(void (*fn)(void *arg, int index), void *arg, volatile int *done);	// fn(arg, 0) on a worker without waiting, *done becomes 1 when it returns
+int asyncDone(volatile int *done);	// check on a runAsync from another thread
+#endif
@@ -4,10 +4,17 @@
 #include <GL/GLU.h>
 #include <stdio.h>
 #include <string>
+#include <string.h>
 
 #include "main.h"
 #include "wavefront.h"
 #include "font.h"
+#include "bench.h"
+#include "upload.h"
+#include "arena.h"
+#include "pack.h"
+#include "watch.h"
+#include "hiz.h"
 
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
@@ -41,6 +48,8 @@ bool gRenderQuad = true;
 
 WavefrontModel *trenchModel;
 WavefrontModel *tumtumModel;
+WavefrontLoad *trenchLoad;
+WavefrontLoad *tumtumLoad;
 
 class Camera camera;
 
@@ -230,11 +239,29 @@ void render()
 {
     //Clear color buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    resetArena(&frameArena); // last frame's scratch lists are done with
 
     camera.reposition();
 
-    drawWavefront(trenchModel);
-    drawWavefront(tumtumModel);
+    // the models turn up when their loads finish, nothing is drawn in their place until then.
+    int loading = pollWavefrontLoads();
+    // files saved since last frame.
+    char changed[16][WATCH_PATH];
+    int changedCount = pollWatch(changed, 16);
+    for(int i = 0; i < changedCount; i++) reloadWavefrontFile(changed[i]);
+    loading += runUploads();
+    if(!trenchModel) trenchModel = finishWavefrontLoad(&trenchLoad);
+    if(!tumtumModel) tumtumModel = finishWavefrontLoad(&tumtumLoad);
+    // the trench walls hide most of it past the next bend.
+    float projection[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    beginOcclusion(projection);
+    addWavefrontOccluder(trenchModel);
+    finishOcclusion();
+    queueWavefront(trenchModel);
+    queueWavefront(tumtumModel);
+    int binds, stateChanges, culled;
+    int draws = drawWavefrontQueue(&binds, &stateChanges, &culled);
 
 
     int newTime = SDL_GetTicks();
@@ -245,7 +272,7 @@ void render()
     float fps = 1.0f / (elapsed / 1000.0f); // instantanious frame rate
 
     camera.hudBegin();
-    char buf[32];
+    char buf[64];
     sprintf(buf, "FPS: %.3f (%d ms)", fps, elapsed);
     if(oldElapsed < elapsed - 1 || oldElapsed > elapsed + 1) {
         oldElapsed = elapsed;
@@ -262,6 +289,23 @@ void render()
         position.y=y;
         Font.drawMessage(buf, FONT_BODY, color, &position);
     }
+    sprintf(buf, "%d draws %d binds %d state changes %d culled", draws, binds, stateChanges, culled);
+    SDL_Rect queuePosition = {20, camera.height - 60, 0, 0};
+    Font.drawMessage(buf, FONT_BODY, color, &queuePosition);
+    int occluders, occluded;
+    double rasterUs, testUs;
+    getOcclusionStats(&occluders, 0, &occluded, &rasterUs, &testUs);
+    sprintf(buf, "%d occluder tris %d occluded %.0f+%.0f us", occluders, occluded, rasterUs, testUs);
+    SDL_Rect occlusionPosition = {20, camera.height - 80, 0, 0};
+    Font.drawMessage(buf, FONT_BODY, color, &occlusionPosition);
+    if(loading) {
+        int queued, frameBytes;
+        double bandwidth;
+        getUploadStats(&queued, &frameBytes, &bandwidth);
+        sprintf(buf, "Loading... %d uploads %.0f MB/s", queued, bandwidth);
+        SDL_Rect loadingPosition = {20, camera.height - 40, 0, 0};
+        Font.drawMessage(buf, FONT_BODY, color, &loadingPosition);
+    }
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     camera.hudEnd();
 
@@ -269,6 +313,8 @@ void render()
 
 int main(int argc,char **argv)
 {
+	if(argc > 1 && strcmp(argv[1], "-pack") == 0) return runPacker(argc - 2, argv + 2);
+	openPack("data.pak");	// optional, loose files still win over what's in it
 	if (!init()) return 10;
 	if (!initGL()) return 20;
 	atexit(SDL_Quit);
@@ -287,9 +333,15 @@ int main(int argc,char **argv)
 	camera.height=480;
 
 	initImage();
+	initUploads();
+
+	if(argc > 1 && strcmp(argv[1], "-bench") == 0) return runBenchmark(argc - 2, argv + 2);
 
-	trenchModel = loadWavefront("utrench");
-	tumtumModel = loadWavefront("tumtum");
+	watchDirectory("models");	// edits to the models and textures show up without a restart
+	wavefrontLoadFlags |= WAVEFRONT_OCCLUSION;	// baked on the first run, from the .mesh cache after that
+	trenchLoad = loadWavefrontAsync("utrench");
+	tumtumLoad = loadWavefrontAsync("tumtum");
+	loadWavefrontShaders(1);	// while they load, from the saved binaries after the first run
 
     //SDL_Surface *icon = SDL_LoadBMP("data/icon.bmp");
     //if(icon) SDL_WM_SetIcon(icon, 0);
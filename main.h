@@ -48,6 +48,11 @@ struct Vertex3DTPfast {
 	short u, v;
 	short x, y, z;
 };
+struct Vertex3DTNPfast {
+	short u, v;	// scaled to the model's uv bounds
+	signed char nx, ny, nz, pad;
+	short x, y, z;	// scaled to the model's min/max
+};
 struct Vertex3DTfast {
 	short u, v;
 };
@@ -87,14 +92,14 @@ typedef struct Image
         Color* data;
         Color* palette;	// used for 4 bpp and 8bpp modes.
         int texid;		// the texture ID for OpenGL.
+        char filename[256];	// where it was loaded from, empty if made in memory.
 } Image;
 Image *loadPng(const char *filename);
 int uploadImage(Image *image);
 void freeImage(Image *image);
 void resetVRam();
 void reportVRam();
-extern int swizzleToVRam;
-void swizzleFast(Image *source);
+void swizzleFast(Image *source, int toVRam);	// toVRam only from the main thread
 void saveImagePng(const char* filename, Color* data, int width, int height, int lineSize, int saveAlpha);
 void saveImageTarga(const char* filename, Color* data, int width, int height, int lineSize, int saveAlpha);
 /*enum FontId {
@@ -0,0 +1,460 @@
+/* meshopt - load time triangle reordering for indexed meshes */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meshopt.h"
+
+#define FORSYTH_CACHE_SIZE 32	// LRU cache the scores are tuned for, bigger than any real FIFO
+
+// Counts a transform whenever a vertex isn't among the last MESH_FIFO_SIZE vertices transformed.
+float meshCacheMissRatio(const unsigned int *index, int indexCount, int vertCount)
+{
+	int *stamp = (int *)calloc(sizeof(int), vertCount + 1);	// 1 + miss count when it went in, 0 = never
+	int misses = 0;
+	int i;
+
+	if(indexCount < 3) {
+		free(stamp);
+		return 0;
+	}
+	for(i = 0; i < indexCount; i++) {
+		unsigned int v = index[i];
+		if(stamp[v] == 0 || misses - (stamp[v] - 1) >= MESH_FIFO_SIZE) {
+			stamp[v] = misses + 1;
+			misses++;
+		}
+	}
+	free(stamp);
+	return misses / (float)(indexCount / 3);
+}
+
+// Tom Forsyth's "Linear-speed vertex cache optimisation" scores.
+static float forsythVertexScore(int cachePos, int valence)
+{
+	float score = 0;
+	if(valence == 0) return -1;	// nothing left to draw with it
+	if(cachePos >= 0) {
+		if(cachePos < 3) score = 0.75f;	// just used, don't favour the triangle that shares its edge too much
+		else score = powf(1 - (cachePos - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+	return score + 2.0f / sqrtf((float)valence);	// finish off vertices with few triangles left
+}
+
+// Greedily emit the best scoring triangle that touches the cache.  When nothing does,  carry on
+// with the next unused triangle in the original order rather than searching the whole mesh.
+void optimizeVertexCache(unsigned int *index, int indexCount, int vertCount)
+{
+	int triCount = indexCount / 3;
+	if(triCount < 2) return;
+	int *valence = (int *)calloc(sizeof(int), vertCount + 1);	// triangles left to draw
+	int *adjacencyStart = (int *)malloc(sizeof(int) * (vertCount + 1));
+	int *adjacency = (int *)malloc(sizeof(int) * triCount * 3);
+	int *cachePos = (int *)malloc(sizeof(int) * (vertCount + 1));
+	float *score = (float *)malloc(sizeof(float) * (vertCount + 1));
+	float *triScore = (float *)malloc(sizeof(float) * triCount);
+	char *emitted = (char *)calloc(1, triCount);
+	unsigned int *result = (unsigned int *)malloc(sizeof(unsigned int) * triCount * 3);
+	int cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int i, k, t, v;
+
+	for(i = 0; i < triCount * 3; i++) valence[index[i]]++;
+	for(v = 0, k = 0; v < vertCount; v++) {
+		adjacencyStart[v] = k;
+		k += valence[v];
+		valence[v] = 0;
+	}
+	for(i = 0; i < triCount * 3; i++) {
+		v = index[i];
+		adjacency[adjacencyStart[v] + valence[v]++] = i / 3;
+	}
+	for(v = 0; v < vertCount; v++) {
+		cachePos[v] = -1;
+		score[v] = forsythVertexScore(-1, valence[v]);
+	}
+	for(t = 0; t < triCount; t++) triScore[t] = score[index[t * 3]] + score[index[t * 3 + 1]] + score[index[t * 3 + 2]];
+
+	int best = -1, cursor = 0, out;
+	for(out = 0; out < triCount; out++) {
+		if(best < 0) {
+			while(emitted[cursor]) cursor++;
+			best = cursor;
+		}
+		t = best;
+		emitted[t] = 1;
+		memcpy(result + out * 3, index + t * 3, sizeof(unsigned int) * 3);
+
+		// the triangle's vertices go to the front of the cache.
+		int newCount = 0;
+		for(k = 0; k < 3; k++) {
+			v = index[t * 3 + k];
+			int *adj = adjacency + adjacencyStart[v];
+			for(i = 0; i < valence[v] && adj[i] != t; i++);
+			if(i < valence[v]) adj[i] = adj[--valence[v]];
+			for(i = 0; i < newCount && newCache[i] != v; i++);
+			if(i == newCount) newCache[newCount++] = v;
+		}
+		for(i = 0; i < cacheCount; i++) {
+			v = cache[i];
+			if(v != (int)index[t * 3] && v != (int)index[t * 3 + 1] && v != (int)index[t * 3 + 2]) newCache[newCount++] = v;
+		}
+
+		// rescore everything that moved,  including what fell out,  and pick the next triangle.
+		float bestScore = -1;
+		best = -1;
+		for(i = 0; i < newCount; i++) {
+			v = newCache[i];
+			cachePos[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+			score[v] = forsythVertexScore(cachePos[v], valence[v]);
+		}
+		for(i = 0; i < newCount; i++) {
+			v = newCache[i];
+			int *adj = adjacency + adjacencyStart[v];
+			for(k = 0; k < valence[v]; k++) {
+				int a = adj[k];
+				triScore[a] = score[index[a * 3]] + score[index[a * 3 + 1]] + score[index[a * 3 + 2]];
+				if(i < FORSYTH_CACHE_SIZE && triScore[a] > bestScore) {
+					bestScore = triScore[a];
+					best = a;
+				}
+			}
+		}
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		memcpy(cache, newCache, sizeof(int) * cacheCount);
+	}
+	memcpy(index, result, sizeof(unsigned int) * triCount * 3);
+
+	free(result);
+	free(emitted);
+	free(triScore);
+	free(score);
+	free(cachePos);
+	free(adjacency);
+	free(adjacencyStart);
+	free(valence);
+}
+
+struct MeshCluster {
+	float key;	// how far out the cluster sits along the way it faces
+	int first;	// triangle
+	int count;
+};
+
+static int cmpMeshCluster(const void *one, const void *two)
+{
+	const struct MeshCluster *a = (const struct MeshCluster *)one, *b = (const struct MeshCluster *)two;
+	if(a->key != b->key) return a->key > b->key ? -1 : 1;
+	return a->first - b->first;
+}
+
+// Area weighted centroid and normal (length is twice the area) of a run of triangles.
+static void meshClusterShape(const unsigned int *index, int triCount, const float *position, int stride, float *centroid, float *normal)
+{
+	float area = 0;
+	int t, k;
+
+	memset(centroid, 0, sizeof(float) * 3);
+	memset(normal, 0, sizeof(float) * 3);
+	for(t = 0; t < triCount; t++) {
+		const float *a = (const float *)((const char *)position + index[t * 3] * stride);
+		const float *b = (const float *)((const char *)position + index[t * 3 + 1] * stride);
+		const float *c = (const float *)((const char *)position + index[t * 3 + 2] * stride);
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for(k = 0; k < 3; k++) {
+			centroid[k] += w * (a[k] + b[k] + c[k]) / 3;
+			normal[k] += n[k];
+		}
+		area += w;
+	}
+	if(area > 0) for(k = 0; k < 3; k++) centroid[k] /= area;
+}
+
+// Sander, Nehab and Barczak's view independent ordering: cut the cache optimised order where the
+// FIFO starts from scratch anyway,  then draw the clusters that face away from the middle of the
+// mesh first since,  from most viewpoints,  they are in front of the rest.  Run it after
+// optimizeVertexCache; the cache miss ratio barely moves because the cuts were misses already.
+void optimizeOverdraw(unsigned int *index, int indexCount, const float *position, int stride, int vertCount)
+{
+	int triCount = indexCount / 3;
+	if(triCount < 2) return;
+	int *stamp = (int *)calloc(sizeof(int), vertCount + 1);
+	struct MeshCluster *cluster = (struct MeshCluster *)malloc(sizeof(struct MeshCluster) * triCount);
+	int clusterCount = 0, misses = 0;
+	int i, k, t;
+
+	for(t = 0; t < triCount; t++) {
+		int missed = 0;
+		for(k = 0; k < 3; k++) {
+			unsigned int v = index[t * 3 + k];
+			if(stamp[v] == 0 || misses - (stamp[v] - 1) >= MESH_FIFO_SIZE) {
+				stamp[v] = misses + 1;
+				misses++;
+				missed++;
+			}
+		}
+		if(t == 0 || missed == 3) {
+			cluster[clusterCount].first = t;
+			cluster[clusterCount++].count = 0;
+		}
+		cluster[clusterCount - 1].count++;
+	}
+	free(stamp);
+	if(clusterCount < 2) {
+		free(cluster);
+		return;
+	}
+
+	float middle[3], normal[3], centroid[3];
+	meshClusterShape(index, triCount, position, stride, middle, normal);
+	for(i = 0; i < clusterCount; i++) {
+		meshClusterShape(index + cluster[i].first * 3, cluster[i].count, position, stride, centroid, normal);
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		cluster[i].key = 0;
+		if(length > 0) {
+			for(k = 0; k < 3; k++) cluster[i].key += (centroid[k] - middle[k]) * normal[k] / length;
+		}
+	}
+	qsort(cluster, clusterCount, sizeof(struct MeshCluster), cmpMeshCluster);
+
+	unsigned int *result = (unsigned int *)malloc(sizeof(unsigned int) * triCount * 3);
+	int out = 0;
+	for(i = 0; i < clusterCount; i++) {
+		memcpy(result + out * 3, index + cluster[i].first * 3, sizeof(unsigned int) * 3 * cluster[i].count);
+		out += cluster[i].count;
+	}
+	memcpy(index, result, sizeof(unsigned int) * triCount * 3);
+	free(result);
+	free(cluster);
+}
+
+struct MeshQuadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+struct MeshCollapse {
+	float cost;
+	int from, to;
+};
+
+#define MESH_POSITION(v) ((const float *)((const char *)position + (size_t)(v) * stride))
+
+// Sum of squared distances to the planes of the triangles around a vertex.
+static void quadricAddPlane(struct MeshQuadric *q, const float *a, const float *b, const float *c)
+{
+	double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+	double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if(length == 0) return;
+	n[0] /= length;
+	n[1] /= length;
+	n[2] /= length;
+	double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+	q->a2 += n[0] * n[0];
+	q->ab += n[0] * n[1];
+	q->ac += n[0] * n[2];
+	q->ad += n[0] * d;
+	q->b2 += n[1] * n[1];
+	q->bc += n[1] * n[2];
+	q->bd += n[1] * d;
+	q->c2 += n[2] * n[2];
+	q->cd += n[2] * d;
+	q->d2 += d * d;
+}
+
+static void quadricAdd(struct MeshQuadric *q, const struct MeshQuadric *r)
+{
+	q->a2 += r->a2;
+	q->ab += r->ab;
+	q->ac += r->ac;
+	q->ad += r->ad;
+	q->b2 += r->b2;
+	q->bc += r->bc;
+	q->bd += r->bd;
+	q->c2 += r->c2;
+	q->cd += r->cd;
+	q->d2 += r->d2;
+}
+
+static double quadricError(const struct MeshQuadric *q, const float *p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	double e = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z + 2 * (q->ab * x * y + q->ac * x * z + q->bc * y * z) +
+		2 * (q->ad * x + q->bd * y + q->cd * z) + q->d2;
+	return e > 0 ? e : 0;
+}
+
+static int cmpMeshCollapse(const void *one, const void *two)
+{
+	const struct MeshCollapse *a = (const struct MeshCollapse *)one, *b = (const struct MeshCollapse *)two;
+	return a->cost < b->cost ? -1 : a->cost > b->cost ? 1 : 0;
+}
+
+static int cmpMeshEdge(const void *one, const void *two)
+{
+	unsigned long long a = *(const unsigned long long *)one, b = *(const unsigned long long *)two;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// Would moving corner from to the position of to turn triangle t over,  or stand it on its edge?
+// Anything turned more than 60 degrees counts.
+static int meshCollapseFlips(const int *tri, int t, int from, int to, const float **pos)
+{
+	const float *p[3], *q[3];
+	int k;
+	for(k = 0; k < 3; k++) {
+		p[k] = pos[tri[t * 3 + k]];
+		q[k] = tri[t * 3 + k] == from ? pos[to] : p[k];
+	}
+	float a1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] }, a2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+	float b1[3] = { q[1][0] - q[0][0], q[1][1] - q[0][1], q[1][2] - q[0][2] }, b2[3] = { q[2][0] - q[0][0], q[2][1] - q[0][1], q[2][2] - q[0][2] };
+	float n[3] = { a1[1] * a2[2] - a1[2] * a2[1], a1[2] * a2[0] - a1[0] * a2[2], a1[0] * a2[1] - a1[1] * a2[0] };
+	float m[3] = { b1[1] * b2[2] - b1[2] * b2[1], b1[2] * b2[0] - b1[0] * b2[2], b1[0] * b2[1] - b1[1] * b2[0] };
+	float dot = n[0] * m[0] + n[1] * m[1] + n[2] * m[2];
+	return dot <= 0 || dot * dot < 0.25f * (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * (m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+}
+
+// Garland and Heckbert's quadric error edge collapse,  restricted to moving a vertex onto one of its
+// neighbours so the simplified triangles still index the original vertex array.  Each pass collapses
+// the cheapest edges whose neighbourhoods don't overlap,  then the index is rebuilt.  Open edges
+// are locked as well as whatever the caller locks.
+int simplifyMesh(unsigned int *dest, const unsigned int *index, int indexCount, const float *position, int stride, int vertCount,
+	const unsigned char *lock, int targetIndexCount, float *error)
+{
+	int triCount = indexCount / 3, target = targetIndexCount / 3;
+	int *local = (int *)malloc(sizeof(int) * (vertCount + 1));
+	int *global = (int *)malloc(sizeof(int) * (indexCount + 1));
+	int *tri = (int *)malloc(sizeof(int) * (indexCount + 1));
+	int n = 0, live = triCount;
+	double maxError = 0;
+	int i, k, t, pass;
+
+	// work in vertex numbers local to these triangles so the per vertex arrays stay small.
+	memset(local, -1, sizeof(int) * vertCount);
+	for(i = 0; i < triCount * 3; i++) {
+		unsigned int v = index[i];
+		if(local[v] < 0) {
+			local[v] = n;
+			global[n++] = v;
+		}
+		tri[i] = local[v];
+	}
+	free(local);
+	const float **pos = (const float **)malloc(sizeof(float *) * (n + 1));
+	unsigned char *locked = (unsigned char *)calloc(1, n + 1);
+	struct MeshQuadric *quadric = (struct MeshQuadric *)calloc(sizeof(struct MeshQuadric), n + 1);
+	for(i = 0; i < n; i++) {
+		pos[i] = MESH_POSITION(global[i]);
+		locked[i] = lock ? lock[global[i]] : 0;
+	}
+	for(t = 0; t < triCount; t++) {
+		for(k = 0; k < 3; k++) quadricAddPlane(quadric + tri[t * 3 + k], pos[tri[t * 3]], pos[tri[t * 3 + 1]], pos[tri[t * 3 + 2]]);
+	}
+
+	// edges with one triangle,  or more than two,  stay where they are.
+	unsigned long long *edge = (unsigned long long *)malloc(sizeof(unsigned long long) * (triCount * 3 + 1));
+	for(t = 0; t < triCount; t++) {
+		for(k = 0; k < 3; k++) {
+			unsigned long long a = tri[t * 3 + k], b = tri[t * 3 + (k + 1) % 3];
+			edge[t * 3 + k] = a < b ? a << 32 | b : b << 32 | a;
+		}
+	}
+	qsort(edge, triCount * 3, sizeof(unsigned long long), cmpMeshEdge);
+	for(i = 0; i < triCount * 3; i = k) {
+		for(k = i + 1; k < triCount * 3 && edge[k] == edge[i]; k++);
+		if(k - i != 2) {
+			locked[edge[i] >> 32] = 1;
+			locked[edge[i] & 0xffffffff] = 1;
+		}
+	}
+	free(edge);
+
+	int *adjacencyStart = (int *)malloc(sizeof(int) * (n + 2));
+	int *adjacency = (int *)malloc(sizeof(int) * (triCount * 3 + 1));
+	int *remap = (int *)malloc(sizeof(int) * (n + 1));
+	unsigned char *touched = (unsigned char *)malloc(n + 1);
+	struct MeshCollapse *collapse = (struct MeshCollapse *)malloc(sizeof(struct MeshCollapse) * (triCount * 3 + 1));
+	for(pass = 0; pass < 100 && live > target; pass++) {
+		memset(adjacencyStart, 0, sizeof(int) * (n + 2));
+		for(i = 0; i < live * 3; i++) adjacencyStart[tri[i] + 2]++;
+		for(i = 0; i < n; i++) adjacencyStart[i + 2] += adjacencyStart[i + 1];
+		for(i = 0; i < live * 3; i++) adjacency[adjacencyStart[tri[i] + 1]++] = i / 3;
+
+		int collapseCount = 0;
+		for(i = 0; i < live * 3; i++) {
+			int a = tri[i], b = tri[i / 3 * 3 + (i + 1) % 3];
+			struct MeshQuadric q = quadric[a];
+			quadricAdd(&q, quadric + b);
+			double ab = locked[a] ? -1 : quadricError(&q, pos[b]), ba = locked[b] ? -1 : quadricError(&q, pos[a]);
+			if(ab < 0 && ba < 0) continue;
+			struct MeshCollapse *c = collapse + collapseCount++;
+			if(ba < 0 || (ab >= 0 && ab <= ba)) {
+				c->from = a;
+				c->to = b;
+				c->cost = (float)ab;
+			} else {
+				c->from = b;
+				c->to = a;
+				c->cost = (float)ba;
+			}
+		}
+		qsort(collapse, collapseCount, sizeof(struct MeshCollapse), cmpMeshCollapse);
+
+		int removed = 0, collapsed = 0;
+		memset(touched, 0, n);
+		for(i = 0; i < n; i++) remap[i] = i;
+		for(i = 0; i < collapseCount && live - removed > target; i++) {
+			int from = collapse[i].from, to = collapse[i].to, gone = 0, flips = 0;
+			if(touched[from] || touched[to]) continue;
+			for(k = adjacencyStart[from]; k < adjacencyStart[from + 1]; k++) {
+				t = adjacency[k];
+				if(tri[t * 3] == to || tri[t * 3 + 1] == to || tri[t * 3 + 2] == to) gone++;
+				else if(meshCollapseFlips(tri, t, from, to, pos)) flips++;
+			}
+			if(flips) continue;
+			remap[from] = to;
+			quadricAdd(quadric + to, quadric + from);
+			if(collapse[i].cost > maxError) maxError = collapse[i].cost;
+			// nothing around it may move again this pass,  or the flip test above would be out of date.
+			for(k = adjacencyStart[from]; k < adjacencyStart[from + 1]; k++) {
+				t = adjacency[k];
+				touched[tri[t * 3]] = touched[tri[t * 3 + 1]] = touched[tri[t * 3 + 2]] = 1;
+			}
+			touched[to] = 1;
+			removed += gone;
+			collapsed++;
+		}
+		if(!collapsed) break;
+
+		int kept = 0;
+		for(t = 0; t < live; t++) {
+			int a = remap[tri[t * 3]], b = remap[tri[t * 3 + 1]], c = remap[tri[t * 3 + 2]];
+			if(a == b || b == c || c == a) continue;
+			tri[kept * 3] = a;
+			tri[kept * 3 + 1] = b;
+			tri[kept * 3 + 2] = c;
+			kept++;
+		}
+		live = kept;
+	}
+	for(i = 0; i < live * 3; i++) dest[i] = global[tri[i]];
+	*error = (float)sqrt(maxError);
+
+	free(collapse);
+	free(touched);
+	free(remap);
+	free(adjacency);
+	free(adjacencyStart);
+	free(quadric);
+	free(locked);
+	free(pos);
+	free(tri);
+	free(global);
+	return live * 3;
+}
@@ -0,0 +1,12 @@
+/* Mesh optimisation */
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+// meshopt.c
+#define MESH_FIFO_SIZE 16	// post transform cache that meshCacheMissRatio models
+float meshCacheMissRatio(const unsigned int *index, int indexCount, int vertCount);	// ACMR: vertices transformed per triangle
+void optimizeVertexCache(unsigned int *index, int indexCount, int vertCount);	// reorder triangles in place for the post transform cache
+void optimizeOverdraw(unsigned int *index, int indexCount, const float *position, int stride, int vertCount);	// sort cache sized clusters so outward facing ones draw first, stride in bytes
+int simplifyMesh(unsigned int *dest, const unsigned int *index, int indexCount, const float *position, int stride, int vertCount,
+	const unsigned char *lock, int targetIndexCount, float *error);	// edge collapse towards targetIndexCount, returns the index count and the error as a distance
+#endif
@@ -0,0 +1,452 @@
+/* pack - one mapped archive of LZ4 compressed files in place of lots of little ones under models/ and data/ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(_PSP)
+#include <dirent.h>
+#endif
+#include <sys/stat.h>
+
+#include "filemap.h"
+#include "pack.h"
+
+#define PACK_MAGIC 0x4b415056	// "VPAK"
+#define PACK_VERSION 1
+#define PACK_ALIGN 16	// file data starts on this, so a stored .mesh can be used in place
+#define PACK_STORED 0
+#define PACK_LZ4 1
+#define PACK_MAX_FILES 4096
+
+#define LZ4_HASH_BITS 14
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5	// the block always ends with at least this many literals
+#define LZ4_MATCH_LIMIT 12	// and no match starts in the last 12 bytes
+
+struct PackHeader {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int entryCount;
+	unsigned int nameSize;	// bytes of path names after the index
+	unsigned long long indexOffset;
+	unsigned long long fileSize;
+};
+
+// The index is sorted by pathHash,  paths are compared too in case two hash the same.
+struct PackEntry {
+	unsigned long long pathHash;	// hashBytes of the path,  '/' separated
+	unsigned long long contentHash;	// hashBytes of the unpacked file,  what hashFile gives for the loose copy
+	unsigned long long offset;
+	long long time;	// modification time of the file that was packed
+	unsigned int size;	// unpacked
+	unsigned int packedSize;
+	unsigned int compression;
+	unsigned int name;	// into the name table
+};
+
+struct Pack {
+	struct FileMap map;
+	const struct PackHeader *header;
+	const struct PackEntry *entry;
+	const char *names;
+};
+
+int packLooseFiles = 1;
+
+// opened at startup on the main thread,  only read after that.
+static struct Pack pack[PACK_MAX];
+static int packCount = 0;
+
+// Enough room for lz4Compress however badly the data compresses.
+static int lz4Bound(int size)
+{
+	return size + size / 255 + 16;
+}
+
+static unsigned char *lz4Length(unsigned char *out, int length)
+{
+	for(; length >= 255; length -= 255) *out++ = 255;
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+// One LZ4 sequence: literals,  then a match unless it's the last one.
+static unsigned char *lz4Sequence(unsigned char *out, const unsigned char *literal, int literalCount, int offset, int matchLength)
+{
+	unsigned char *token = out++;
+	*token = (unsigned char)((literalCount >= 15 ? 15 : literalCount) << 4);
+	if(literalCount >= 15) out = lz4Length(out, literalCount - 15);
+	memcpy(out, literal, literalCount);
+	out += literalCount;
+	if(matchLength == 0) return out;
+	out[0] = (unsigned char)(offset & 255);
+	out[1] = (unsigned char)(offset >> 8);
+	out += 2;
+	matchLength -= LZ4_MIN_MATCH;
+	*token |= matchLength >= 15 ? 15 : matchLength;
+	if(matchLength >= 15) out = lz4Length(out, matchLength - 15);
+	return out;
+}
+
+// Greedy LZ4 block compression with a single hash table.  Packing is done offline,  so it goes for
+// simple over fast.  dest needs lz4Bound(size),  returns the compressed size.
+static int lz4Compress(const unsigned char *src, int size, unsigned char *dest)
+{
+	static int table[1 << LZ4_HASH_BITS];	// only the packer compresses,  on one thread
+	unsigned char *out = dest;
+	int anchor = 0, i = 0;
+
+	memset(table, -1, sizeof(table));
+	while(i < size - LZ4_MATCH_LIMIT) {
+		unsigned int sequence;
+		memcpy(&sequence, src + i, 4);
+		unsigned int slot = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+		int candidate = table[slot];
+		table[slot] = i;
+		if(candidate < 0 || i - candidate > 65535 || memcmp(src + candidate, src + i, LZ4_MIN_MATCH) != 0) {
+			i++;
+			continue;
+		}
+		int length = LZ4_MIN_MATCH;
+		while(i + length < size - LZ4_LAST_LITERALS && src[candidate + length] == src[i + length]) length++;
+		while(i > anchor && candidate > 0 && src[i - 1] == src[candidate - 1]) {
+			i--;
+			candidate--;
+			length++;
+		}
+		out = lz4Sequence(out, src + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+	out = lz4Sequence(out, src + anchor, size - anchor, 0, 0);
+	return (int)(out - dest);
+}
+
+// Checks every length and offset,  so a damaged pack fails instead of writing past dest.
+static int lz4Decompress(const unsigned char *src, int packedSize, unsigned char *dest, int size)
+{
+	const unsigned char *in = src, *inEnd = src + packedSize;
+	unsigned char *out = dest, *outEnd = dest + size;
+	while(in < inEnd) {
+		int token = *in++, more;
+		int literals = token >> 4;
+		if(literals == 15) {
+			do {
+				if(in >= inEnd) return 0;
+				more = *in++;
+				literals += more;
+			} while(more == 255);
+		}
+		if(literals > inEnd - in || literals > outEnd - out) return 0;
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+		if(in == inEnd) break;	// the last sequence has no match
+		if(inEnd - in < 2) return 0;
+		int offset = in[0] | in[1] << 8;
+		in += 2;
+		if(offset == 0 || offset > out - dest) return 0;
+		int length = token & 15;
+		if(length == 15) {
+			do {
+				if(in >= inEnd) return 0;
+				more = *in++;
+				length += more;
+			} while(more == 255);
+		}
+		length += LZ4_MIN_MATCH;
+		if(length > outEnd - out) return 0;
+		const unsigned char *from = out - offset;
+		if(offset >= length) memcpy(out, from, length);
+		else {
+			int k;
+			for(k = 0; k < length; k++) out[k] = from[k];	// overlapping,  repeats the last offset bytes
+		}
+		out += length;
+	}
+	return out == outEnd;
+}
+
+// Paths go in the index '/' separated without a leading ./,  however they were asked for.
+static void packPath(const char *path, char *out, int max)
+{
+	int i;
+	while(path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
+	for(i = 0; i < max - 1 && path[i]; i++) out[i] = path[i] == '\\' ? '/' : path[i];
+	out[i] = 0;
+}
+
+int openPack(const char *path)
+{
+	if(packCount >= PACK_MAX) {
+		printf("*** Too many packs open for %s\n", path);
+		return 0;
+	}
+	struct Pack *p = pack + packCount;
+	if(!mapFile(path, &p->map) && !readFile(path, &p->map)) return 0;
+	p->header = (const struct PackHeader *)p->map.data;
+	if(p->map.size < sizeof(struct PackHeader) || p->header->magic != PACK_MAGIC || p->header->version != PACK_VERSION ||
+			p->header->fileSize != p->map.size ||
+			p->header->indexOffset + (unsigned long long)p->header->entryCount * sizeof(struct PackEntry) + p->header->nameSize > p->map.size) {
+		printf("*** %s isn't a pack this version can read\n", path);
+		unmapFile(&p->map);
+		return 0;
+	}
+	p->entry = (const struct PackEntry *)(p->map.data + p->header->indexOffset);
+	p->names = (const char *)(p->entry + p->header->entryCount);
+	packCount++;
+	printf("opened %s: %d files\n", path, p->header->entryCount);
+	return 1;
+}
+
+void closePacks()
+{
+	int i;
+	for(i = 0; i < packCount; i++) unmapFile(&pack[i].map);
+	packCount = 0;
+}
+
+static const struct PackEntry *findPacked(const char *path, struct Pack **found)
+{
+	char name[256];
+	int i;
+	if(packCount == 0) return 0;
+	packPath(path, name, sizeof(name));
+	unsigned long long hash = hashBytes(name, strlen(name));
+	for(i = packCount - 1; i >= 0; i--) {
+		const struct PackEntry *entry = pack[i].entry;
+		int low = 0, high = (int)pack[i].header->entryCount;
+		while(low < high) {
+			int middle = (low + high) / 2;
+			if(entry[middle].pathHash < hash) low = middle + 1;
+			else high = middle;
+		}
+		for(; low < (int)pack[i].header->entryCount && entry[low].pathHash == hash; low++) {
+			if(entry[low].name < pack[i].header->nameSize && strcmp(pack[i].names + entry[low].name, name) == 0) {
+				*found = pack + i;
+				return entry + low;
+			}
+		}
+	}
+	return 0;
+}
+
+int mapPackedFile(const char *path, struct FileMap *map)
+{
+	struct Pack *p;
+	const struct PackEntry *entry;
+	if(packLooseFiles || !findPacked(path, &p)) {
+		if(mapFile(path, map) || readFile(path, map)) return 1;
+	}
+	memset(map, 0, sizeof(*map));
+	entry = findPacked(path, &p);
+	if(!entry || entry->offset + entry->packedSize > p->map.size) return 0;
+	if(entry->compression == PACK_STORED) {
+		map->data = p->map.data + entry->offset;	// used in place,  the pack stays mapped
+		map->size = entry->size;
+		map->mapped = 2;
+		return 1;
+	}
+	char *data = (char *)malloc(entry->size ? entry->size : 1);
+	if(!data || entry->compression != PACK_LZ4 ||
+			!lz4Decompress((const unsigned char *)p->map.data + entry->offset, entry->packedSize, (unsigned char *)data, entry->size)) {
+		printf("*** Couldn't unpack %s\n", path);
+		free(data);
+		return 0;
+	}
+	map->data = data;
+	map->size = entry->size;
+	return 1;
+}
+
+int packedFileStamp(const char *path, long long *time, long long *size)
+{
+	struct Pack *p;
+	const struct PackEntry *entry;
+	if((packLooseFiles || !findPacked(path, &p)) && fileStamp(path, time, size)) return 1;
+	entry = findPacked(path, &p);
+	if(!entry) return 0;
+	*time = entry->time;
+	*size = entry->size;
+	return 1;
+}
+
+unsigned long long hashPackedFile(const char *path)
+{
+	struct Pack *p;
+	const struct PackEntry *entry;
+	if(packLooseFiles || !findPacked(path, &p)) {
+		unsigned long long hash = hashFile(path);
+		if(hash) return hash;
+	}
+	entry = findPacked(path, &p);
+	return entry ? entry->contentHash : 0;
+}
+
+// Sources,  backups and other packs aren't worth shipping.
+static int packSkipped(const char *path)
+{
+	static const char *skip[] = { ".blend", ".blend1", ".pak", ".tmp", 0 };
+	size_t length = strlen(path);
+	int i;
+	for(i = 0; skip[i]; i++) {
+		size_t s = strlen(skip[i]);
+		if(length >= s && strcmp(path + length - s, skip[i]) == 0) return 1;
+	}
+	return 0;
+}
+
+struct PackSource {
+	char path[256];
+	struct PackEntry entry;
+};
+
+static void addPackSource(const char *path, struct PackSource *source, int *count)
+{
+	if(packSkipped(path)) return;
+	if(*count >= PACK_MAX_FILES) {
+		printf("*** More than %d files,  leaving out %s\n", PACK_MAX_FILES, path);
+		return;
+	}
+	packPath(path, source[*count].path, sizeof(source[*count].path));
+	(*count)++;
+}
+
+static void findPackSources(const char *path, struct PackSource *source, int *count)
+{
+	struct stat st;
+	char child[256];
+	if(stat(path, &st) != 0) {
+		printf("*** Couldn't find %s\n", path);
+		return;
+	}
+	if(!(st.st_mode & S_IFDIR)) {
+		addPackSource(path, source, count);
+		return;
+	}
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	snprintf(child, sizeof(child), "%s/*", path);
+	HANDLE find = FindFirstFileA(child, &found);
+	if(find == INVALID_HANDLE_VALUE) return;
+	do {
+		if(found.cFileName[0] == '.') continue;
+		if(snprintf(child, sizeof(child), "%s/%s", path, found.cFileName) >= (int)sizeof(child)) {
+			printf("*** Skipping %s/%s,  the path is too long\n", path, found.cFileName);
+			continue;
+		}
+		findPackSources(child, source, count);
+	} while(FindNextFileA(find, &found));
+	FindClose(find);
+#elif !defined(_PSP)
+	DIR *dir = opendir(path);
+	struct dirent *found;
+	if(!dir) return;
+	while((found = readdir(dir)) != 0) {
+		if(found->d_name[0] == '.') continue;
+		if(snprintf(child, sizeof(child), "%s/%s", path, found->d_name) >= (int)sizeof(child)) {
+			printf("*** Skipping %s/%s,  the path is too long\n", path, found->d_name);
+			continue;
+		}
+		findPackSources(child, source, count);
+	}
+	closedir(dir);
+#endif
+}
+
+static int comparePackSources(const void *one, const void *two)
+{
+	const struct PackSource *a = (const struct PackSource *)one, *b = (const struct PackSource *)two;
+	if(a->entry.pathHash != b->entry.pathHash) return a->entry.pathHash < b->entry.pathHash ? -1 : 1;
+	return strcmp(a->path, b->path);
+}
+
+// -pack out.pak dir|file...: everything under the directories,  LZ4 compressed unless that doesn't
+// save an eighth,  which leaves pngs and the like stored and readable in place.
+int runPacker(int argc, char **argv)
+{
+	if(argc < 2) {
+		printf("usage: vastspacewar -pack out.pak dir|file...\n");
+		return 1;
+	}
+	struct PackSource *source = (struct PackSource *)calloc(sizeof(struct PackSource), PACK_MAX_FILES);
+	struct PackHeader header;
+	static const char zero[PACK_ALIGN] = { 0 };
+	int count = 0, i;
+	for(i = 1; i < argc; i++) findPackSources(argv[i], source, &count);
+
+	FILE *file = fopen(argv[0], "wb");
+	if(!file) {
+		printf("*** Couldn't write %s\n", argv[0]);
+		free(source);
+		return 1;
+	}
+	memset(&header, 0, sizeof(header));
+	fwrite(&header, sizeof(header), 1, file);	// filled in at the end
+	unsigned long long offset = sizeof(header), total = 0, packed = 0;
+	unsigned int nameSize;
+	int failed = 0;
+	for(i = 0; i < count; i++) {
+		struct PackEntry *entry = &source[i].entry;
+		struct FileMap map;
+		long long size;
+		if(!mapFile(source[i].path, &map) && !readFile(source[i].path, &map)) {
+			printf("*** Couldn't read %s\n", source[i].path);
+			failed = 1;
+			continue;
+		}
+		fileStamp(source[i].path, &entry->time, &size);
+		entry->pathHash = hashBytes(source[i].path, strlen(source[i].path));
+		entry->contentHash = hashBytes(map.data, map.size);
+		entry->size = (unsigned int)map.size;
+		unsigned char *lz4 = (unsigned char *)malloc(lz4Bound((int)map.size));
+		int lz4Size = lz4Compress((const unsigned char *)map.data, (int)map.size, lz4);
+		const void *data = map.data;
+		entry->compression = PACK_STORED;
+		entry->packedSize = entry->size;
+		if(lz4Size < (int)(map.size - map.size / 8)) {
+			entry->compression = PACK_LZ4;
+			entry->packedSize = lz4Size;
+			data = lz4;
+		}
+		fwrite(zero, 1, (size_t)((PACK_ALIGN - offset % PACK_ALIGN) % PACK_ALIGN), file);
+		offset += (PACK_ALIGN - offset % PACK_ALIGN) % PACK_ALIGN;
+		entry->offset = offset;
+		fwrite(data, 1, entry->packedSize, file);
+		offset += entry->packedSize;
+		total += entry->size;
+		packed += entry->packedSize;
+		printf("%-48s %9u -> %9u %s\n", source[i].path, entry->size, entry->packedSize, entry->compression == PACK_LZ4 ? "lz4" : "stored");
+		free(lz4);
+		unmapFile(&map);
+	}
+	// the index,  then the names it points into.
+	qsort(source, count, sizeof(struct PackSource), comparePackSources);
+	fwrite(zero, 1, (size_t)((PACK_ALIGN - offset % PACK_ALIGN) % PACK_ALIGN), file);
+	offset += (PACK_ALIGN - offset % PACK_ALIGN) % PACK_ALIGN;
+	header.indexOffset = offset;
+	nameSize = 0;
+	for(i = 0; i < count; i++) {
+		if(!source[i].entry.pathHash) continue;	// couldn't be read
+		source[i].entry.name = nameSize;
+		nameSize += (unsigned int)strlen(source[i].path) + 1;
+		fwrite(&source[i].entry, sizeof(struct PackEntry), 1, file);
+		header.entryCount++;
+	}
+	for(i = 0; i < count; i++) {
+		if(source[i].entry.pathHash) fwrite(source[i].path, 1, strlen(source[i].path) + 1, file);
+	}
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.nameSize = nameSize;
+	header.fileSize = offset + (unsigned long long)header.entryCount * sizeof(struct PackEntry) + nameSize;
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+	if(fclose(file) != 0) failed = 1;
+	printf("packed %d files into %s: %.1f MB,  %.1f MB unpacked\n", header.entryCount, argv[0], packed / 1048576.0, total / 1048576.0);
+	free(source);
+	return failed;
+}
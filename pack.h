@@ -0,0 +1,14 @@
+/* Packs */
+#ifndef PACK_H
+#define PACK_H
+
+// pack.c
+#define PACK_MAX 8	// archives open at once, the last opened is searched first
+extern int packLooseFiles;	// 1 = a loose file wins over the packed copy, 0 = don't look on disk for anything a pack has
+int openPack(const char *path);	// map an archive made by -pack, before anything loads, returns 0 if it's missing or bad
+void closePacks();
+int mapPackedFile(const char *path, struct FileMap *map);	// loose file mapped or read, else from the packs, release with unmapFile
+int packedFileStamp(const char *path, long long *time, long long *size);	// fileStamp that also finds packed files
+unsigned long long hashPackedFile(const char *path);	// hashFile, packed files answer from the index without unpacking
+int runPacker(int argc, char **argv);	// vastspacewar -pack out.pak dir|file...
+#endif
@@ -0,0 +1,178 @@
+/* shader - compiles and links the GLSL programs, keeping the linked binaries on disk where the
+   driver can save them */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glprocs.h"
+#include "shader.h"
+
+static GLuint compileShader(const char *name, GLenum type, const char *source)
+{
+	GLuint shader = pglCreateShader(type);
+	GLint ok = 0;
+	pglShaderSource(shader, 1, &source, 0);
+	pglCompileShader(shader);
+	pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if(!ok) {
+		char log[1024];
+		pglGetShaderInfoLog(shader, sizeof(log), 0, log);
+		printf("*** Couldn't compile the %s shader for %s:\n%s\n", type == GL_VERTEX_SHADER ? "vertex" : "fragment", name, log);
+		pglDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static GLuint linkProgram(const char *name, const char *vertex, const char *fragment, const struct ProgramAttribute *attribute, int attributeCount, int retrievable)
+{
+	GLuint vertexShader = compileShader(name, GL_VERTEX_SHADER, vertex);
+	GLuint fragmentShader = compileShader(name, GL_FRAGMENT_SHADER, fragment);
+	GLuint program = 0;
+	GLint ok = 0;
+	int i;
+	if(vertexShader && fragmentShader) {
+		program = pglCreateProgram();
+		pglAttachShader(program, vertexShader);
+		pglAttachShader(program, fragmentShader);
+		for(i = 0; i < attributeCount; i++) pglBindAttribLocation(program, attribute[i].location, attribute[i].name);
+		if(retrievable) pglProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		pglLinkProgram(program);
+		pglGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if(!ok) {
+			char log[1024];
+			pglGetProgramInfoLog(program, sizeof(log), 0, log);
+			printf("*** Couldn't link the shaders for %s:\n%s\n", name, log);
+			pglDeleteProgram(program);
+			program = 0;
+		}
+	}
+	// the program keeps them until it goes
+	if(vertexShader) pglDeleteShader(vertexShader);
+	if(fragmentShader) pglDeleteShader(fragmentShader);
+	return program;
+}
+
+unsigned int buildProgram(const char *name, const char *vertex, const char *fragment)
+{
+	return buildCachedProgram(name, vertex, fragment, 0, 0, 0, 0);
+}
+
+// Saved binaries only suit the driver that made them,  from the same source,  so the file starts
+// with a hash of both.  Drivers can still turn one down after an update,  then it's built again.
+#define PROGRAM_CACHE_MAGIC 0x474f5250	// "PROG"
+struct ProgramCacheHeader {
+	unsigned int magic;
+	unsigned int format;	// the driver's binary format
+	unsigned long long key;
+	int length;
+	int pad;
+};
+
+static unsigned long long hashProgramText(unsigned long long hash, const char *text)
+{
+	for(; text && *text; text++) hash = (hash ^ (unsigned char)*text) * 0x100000001b3ull;	// FNV-1a
+	return (hash ^ 0xff) * 0x100000001b3ull;	// so "ab" "c" isn't "a" "bc"
+}
+
+static unsigned long long programCacheKey(const char *vertex, const char *fragment, const struct ProgramAttribute *attribute, int attributeCount)
+{
+	unsigned long long hash = 0xcbf29ce484222325ull;
+	char location[16];
+	int i;
+	hash = hashProgramText(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hashProgramText(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hashProgramText(hash, (const char *)glGetString(GL_VERSION));
+	hash = hashProgramText(hash, vertex);
+	hash = hashProgramText(hash, fragment);
+	for(i = 0; i < attributeCount; i++) {
+		snprintf(location, sizeof(location), "%d", attribute[i].location);
+		hash = hashProgramText(hash, attribute[i].name);
+		hash = hashProgramText(hash, location);
+	}
+	return hash;
+}
+
+static GLuint loadProgramBinary(const char *cachePath, unsigned long long key)
+{
+	struct ProgramCacheHeader header;
+	GLuint program = 0;
+	GLint ok = 0;
+	FILE *file = fopen(cachePath, "rb");
+	if(!file) return 0;
+	if(fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.key == key && header.length > 0) {
+		void *binary = malloc(header.length);
+		if(fread(binary, header.length, 1, file) == 1) {
+			program = pglCreateProgram();
+			pglProgramBinary(program, header.format, binary, header.length);
+			pglGetProgramiv(program, GL_LINK_STATUS, &ok);
+			if(!ok) {
+				pglDeleteProgram(program);
+				program = 0;
+			}
+		}
+		free(binary);
+	}
+	fclose(file);
+	return program;
+}
+
+static void saveProgramBinary(const char *cachePath, unsigned long long key, GLuint program)
+{
+	struct ProgramCacheHeader header;
+	char temp[512];
+	GLint length = 0;
+	GLenum format = 0;
+	pglGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return;
+	void *binary = malloc(length);
+	pglGetProgramBinary(program, length, &length, &format, binary);
+	memset(&header, 0, sizeof(header));
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.format = format;
+	header.key = key;
+	header.length = length;
+
+	// a temporary moved into place,  like the mesh cache,  so a half written one is never read.
+	snprintf(temp, sizeof(temp), "%s.tmp", cachePath);
+	FILE *file = fopen(temp, "wb");
+	if(file) {
+		int ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, length, 1, file) == 1;
+		ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+		if(ok) remove(cachePath);
+#endif
+		if(!ok || rename(temp, cachePath) != 0) {
+			printf("*** Couldn't write %s\n", cachePath);
+			remove(temp);
+		}
+	} else {
+		printf("*** Couldn't write %s\n", temp);
+	}
+	free(binary);
+}
+
+unsigned int buildCachedProgram(const char *name, const char *vertex, const char *fragment, const struct ProgramAttribute *attribute, int attributeCount, const char *cachePath, int *cached)
+{
+	unsigned long long key = 0;
+	GLuint program = 0;
+	if(cached) *cached = 0;
+	if(!glShaders) return 0;
+	if(cachePath && glProgramBinaries) {
+		key = programCacheKey(vertex, fragment, attribute, attributeCount);
+		program = loadProgramBinary(cachePath, key);
+		if(program) {
+			if(cached) *cached = 1;
+			return program;
+		}
+	}
+	program = linkProgram(name, vertex, fragment, attribute, attributeCount, cachePath && glProgramBinaries);
+	if(program && cachePath && glProgramBinaries) saveProgramBinary(cachePath, key, program);
+	return program;
+}
+
+void freeProgram(unsigned int program)
+{
+	if(program && glShaders) pglDeleteProgram(program);
+}
@@ -0,0 +1,13 @@
+/* Shaders */
+#ifndef SHADER_H
+#define SHADER_H
+
+// shader.c
+struct ProgramAttribute {
+	const char *name;
+	int location;	// bound before linking, so programs can share vertex attribute setups
+};
+unsigned int buildProgram(const char *name, const char *vertex, const char *fragment);	// compiles and links GLSL source, 0 with the log printed if it won't, needs glShaders
+unsigned int buildCachedProgram(const char *name, const char *vertex, const char *fragment, const struct ProgramAttribute *attribute, int attributeCount, const char *cachePath, int *cached);	// loads the linked binary from cachePath if it was saved by this driver from the same source, or builds it and saves it there, *cached says which
+void freeProgram(unsigned int program);
+#endif
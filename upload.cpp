@@ -0,0 +1,245 @@
+/* upload - streams textures and buffer data to GL a little each frame, under a time budget */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "glprocs.h"
+#include "upload.h"
+
+#define UPLOAD_CHUNK (256 * 1024)	// bytes per step, small so runUploads stops close to its budget
+#define UPLOAD_PBOS 2	// staging buffers, alternated so filling one can overlap the transfer from the other
+
+struct Upload {
+	Image *image;	// a texture, or
+	unsigned int *buffer;	// where to put a finished buffer object
+	unsigned int target;
+	const char *data;
+	int size;
+	int done;	// bytes sent so far
+	GLuint id;	// texture or buffer being filled
+	int cancelled;	// its id still needs deleting on the GL thread
+	int busy;	// being stepped on the GL thread outside uploadLock, cancelUploads waits for it
+};
+
+float uploadBudget = 2;
+
+// queued in order, guarded by uploadLock since cancelUploads can come from a loading thread. The
+// lock is only held to look at the queue, never through the GL work.
+static struct Upload *queue = 0;
+static int queueCount = 0;
+static int queueMax = 0;
+static SDL_SpinLock uploadLock = 0;
+
+static GLuint pbo[UPLOAD_PBOS];
+static int nextPbo = 0;
+static long long totalBytes = 0;
+static double totalTime = 0;
+static int lastFrameBytes = 0;
+
+static double uploadNow()
+{
+	return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void initUploads()
+{
+	loadGLProcs();
+	if(glPixelBufferObjects) pglGenBuffers(UPLOAD_PBOS, pbo);
+}
+
+static void addUpload(struct Upload *upload)
+{
+	int i;
+	SDL_AtomicLock(&uploadLock);
+	for(i = 0; i < queueCount; i++) {
+		if(queue[i].cancelled) continue;
+		if((upload->image && queue[i].image == upload->image) || (upload->buffer && queue[i].buffer == upload->buffer)) break;
+	}
+	if(i == queueCount) {
+		if(queueCount == queueMax) {
+			queueMax = queueMax < 16 ? 16 : queueMax * 2;
+			queue = (struct Upload *)realloc(queue, sizeof(struct Upload) * queueMax);
+		}
+		queue[queueCount++] = *upload;
+	}
+	SDL_AtomicUnlock(&uploadLock);
+}
+
+void queueImageUpload(Image *image)
+{
+	struct Upload upload;
+	if(!image || image->texid || !image->data) return;
+	memset(&upload, 0, sizeof(upload));
+	upload.image = image;
+	upload.data = (const char *)image->data;
+	upload.size = image->textureWidth * image->textureHeight * 4;
+	addUpload(&upload);
+}
+
+void queueImageReplace(Image *image)
+{
+	struct Upload upload;
+	if(!image || !image->data) return;
+	cancelUploads(image);	// what's queued may be the old pixels
+	memset(&upload, 0, sizeof(upload));
+	upload.image = image;
+	upload.data = (const char *)image->data;
+	upload.size = image->textureWidth * image->textureHeight * 4;
+	addUpload(&upload);
+}
+
+void queueBufferUpload(unsigned int *buffer, unsigned int target, const void *data, int size)
+{
+	struct Upload upload;
+	*buffer = 0;
+	if(!glBufferObjects || !data || size <= 0) return;
+	memset(&upload, 0, sizeof(upload));
+	upload.buffer = buffer;
+	upload.target = target;
+	upload.data = (const char *)data;
+	upload.size = size;
+	addUpload(&upload);
+}
+
+void cancelUploads(const void *data)
+{
+	int i;
+	SDL_AtomicLock(&uploadLock);
+	for(i = 0; i < queueCount; i++) {
+		if(queue[i].image == data || queue[i].data == data) queue[i].cancelled = 1;
+	}
+	// the one being stepped still reads its data, so it has to be put back before that can go.
+	while(queueCount > 0 && queue[0].busy && queue[0].cancelled) {
+		SDL_AtomicUnlock(&uploadLock);
+		SDL_Delay(0);
+		SDL_AtomicLock(&uploadLock);
+	}
+	SDL_AtomicUnlock(&uploadLock);
+}
+
+// A band of rows, through a pixel buffer object when there are some so the copy out of
+// image->data is ours and the transfer to the card is the driver's.
+static int stepImage(struct Upload *upload)
+{
+	Image *image = upload->image;
+	int pitch = image->textureWidth * 4;
+	int row = upload->done / pitch;
+	int rows = UPLOAD_CHUNK / pitch;
+
+	if(!upload->id) {
+		glGenTextures(1, &upload->id);
+		glBindTexture(GL_TEXTURE_2D, upload->id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->textureWidth, image->textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	}
+	if(rows < 1) rows = 1;
+	if(row + rows > image->textureHeight) rows = image->textureHeight - row;
+	const char *source = upload->data + row * pitch;
+	glBindTexture(GL_TEXTURE_2D, upload->id);
+	void *staged = 0;
+	if(glPixelBufferObjects) {
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[nextPbo]);
+		nextPbo = (nextPbo + 1) % UPLOAD_PBOS;
+		pglBufferData(GL_PIXEL_UNPACK_BUFFER, rows * pitch, 0, GL_STREAM_DRAW);	// orphans whatever is still in flight
+		staged = pglMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		if(staged) {
+			memcpy(staged, source, rows * pitch);
+			pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, image->textureWidth, rows, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		}
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	if(!staged) glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, image->textureWidth, rows, GL_RGBA, GL_UNSIGNED_BYTE, source);
+	upload->done += rows * pitch;
+	if(upload->done < upload->size) return 0;
+	if(image->texid && (GLuint)image->texid != upload->id) {
+		GLuint old = image->texid;	// replaced
+		glDeleteTextures(1, &old);
+	}
+	image->texid = upload->id;
+	return 1;
+}
+
+static int stepBuffer(struct Upload *upload)
+{
+	int size = upload->size - upload->done < UPLOAD_CHUNK ? upload->size - upload->done : UPLOAD_CHUNK;
+	if(!upload->id) {
+		pglGenBuffers(1, &upload->id);
+		pglBindBuffer(upload->target, upload->id);
+		pglBufferData(upload->target, upload->size, 0, GL_STATIC_DRAW);
+	}
+	pglBindBuffer(upload->target, upload->id);
+	pglBufferSubData(upload->target, upload->done, size, upload->data + upload->done);
+	pglBindBuffer(upload->target, 0);
+	upload->done += size;
+	if(upload->done < upload->size) return 0;
+	*upload->buffer = upload->id;
+	return 1;
+}
+
+int runUploads()
+{
+	double start = uploadNow(), now = start;
+	int bytes = 0, left, i;
+
+	SDL_AtomicLock(&uploadLock);
+	// drop what was cancelled before it started first, only the head has anything on the GL side.
+	for(i = 1; i < queueCount; i++) {
+		if(!queue[i].cancelled) continue;
+		memmove(queue + i, queue + i + 1, sizeof(struct Upload) * (queueCount - i - 1));
+		queueCount--;
+		i--;
+	}
+	SDL_AtomicUnlock(&uploadLock);
+	while(bytes == 0 || now - start < uploadBudget) {
+		// the head is copied out and marked busy, so the queue can grow or be cancelled meanwhile.
+		struct Upload step;
+		SDL_AtomicLock(&uploadLock);
+		if(queueCount == 0) {
+			SDL_AtomicUnlock(&uploadLock);
+			break;
+		}
+		step = queue[0];
+		if(step.cancelled) memmove(queue, queue + 1, sizeof(struct Upload) * --queueCount);
+		else queue[0].busy = 1;
+		SDL_AtomicUnlock(&uploadLock);
+		if(step.cancelled) {
+			// its half filled texture or buffer goes with it.
+			if(step.id && step.image) glDeleteTextures(1, &step.id);
+			else if(step.id) pglDeleteBuffers(1, &step.id);
+			continue;
+		}
+		int before = step.done;
+		int finished = step.image ? stepImage(&step) : stepBuffer(&step);
+		bytes += step.done - before;
+		SDL_AtomicLock(&uploadLock);
+		step.busy = 0;
+		step.cancelled = queue[0].cancelled;
+		if(finished) memmove(queue, queue + 1, sizeof(struct Upload) * --queueCount);
+		else queue[0] = step;
+		SDL_AtomicUnlock(&uploadLock);
+		now = uploadNow();
+	}
+	SDL_AtomicLock(&uploadLock);
+	left = queueCount;
+	SDL_AtomicUnlock(&uploadLock);
+	lastFrameBytes = bytes;
+	if(bytes) {
+		totalBytes += bytes;
+		totalTime += now - start;
+	}
+	return left;
+}
+
+void getUploadStats(int *queued, int *frameBytes, double *megabytesPerSecond)
+{
+	SDL_AtomicLock(&uploadLock);
+	*queued = queueCount;
+	SDL_AtomicUnlock(&uploadLock);
+	*frameBytes = lastFrameBytes;
+	*megabytesPerSecond = totalTime > 0 ? totalBytes / totalTime / 1000 : 0;
+}
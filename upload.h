@@ -0,0 +1,14 @@
+/* Uploads */
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+// upload.c
+extern float uploadBudget;	// ms per frame runUploads may spend, it always does at least one step
+void initUploads();	// on the GL thread once the context is current
+void queueImageUpload(Image *image);	// texid stays 0 until the whole texture is in
+void queueImageReplace(Image *image);	// new pixels for a texture already in, the old one draws until they're all there
+void queueBufferUpload(unsigned int *buffer, unsigned int target, const void *data, int size);	// *buffer is set once it's all in, left 0 without buffer objects
+void cancelUploads(const void *data);	// call before freeing an Image or buffer data that may still be queued, from any thread
+int runUploads();	// once a frame on the GL thread, returns how many are still queued
+void getUploadStats(int *queued, int *frameBytes, double *megabytesPerSecond);	// bytes sent by the last runUploads, bandwidth over every run so far
+#endif
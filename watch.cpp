@@ -0,0 +1,149 @@
+/* watch - notices files being written under the watched directories, so assets can be reloaded while running */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "watch.h"
+
+#ifdef __linux__
+struct WatchDir {
+	int wd;
+	char path[WATCH_PATH];
+};
+
+static int watchFd = -1;
+static struct WatchDir *watchDir = 0;
+static int watchDirCount = 0;
+static int watchDirMax = 0;
+static char (*pending)[WATCH_PATH] = 0;	// changed since the last pollWatch, each file once
+static int pendingCount = 0;
+static int pendingMax = 0;
+
+// Watches path and the directories under it, skipping any it already has so links can't loop.
+static int addWatch(const char *path)
+{
+	int wd = inotify_add_watch(watchFd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if(wd < 0) return 0;
+	int i, added = 1;
+	for(i = 0; i < watchDirCount; i++) {
+		if(watchDir[i].wd == wd) return 0;
+	}
+	if(watchDirCount == watchDirMax) {
+		watchDirMax = watchDirMax < 16 ? 16 : watchDirMax * 2;
+		watchDir = (struct WatchDir *)realloc(watchDir, sizeof(struct WatchDir) * watchDirMax);
+	}
+	watchDir[watchDirCount].wd = wd;
+	snprintf(watchDir[watchDirCount].path, WATCH_PATH, "%s", path);
+	watchDirCount++;
+
+	DIR *dir = opendir(path);
+	if(!dir) return added;
+	struct dirent *found;
+	while((found = readdir(dir)) != 0) {
+		char sub[WATCH_PATH];
+		if(found->d_name[0] == '.') continue;	// ., .. and hidden ones
+		if(found->d_type != DT_DIR && found->d_type != DT_UNKNOWN) continue;
+		if(snprintf(sub, sizeof(sub), "%s/%s", path, found->d_name) >= (int)sizeof(sub)) continue;
+		added += addWatch(sub);	// IN_ONLYDIR turns away the files an unknown d_type lets through
+	}
+	closedir(dir);
+	return added;
+}
+
+static void addPending(const char *path)
+{
+	int i;
+	for(i = 0; i < pendingCount; i++) {
+		if(strcmp(pending[i], path) == 0) return;
+	}
+	if(pendingCount == pendingMax) {
+		pendingMax = pendingMax < 16 ? 16 : pendingMax * 2;
+		pending = (char (*)[WATCH_PATH])realloc(pending, WATCH_PATH * pendingMax);
+	}
+	snprintf(pending[pendingCount++], WATCH_PATH, "%s", path);
+}
+#endif
+
+int watchDirectory(const char *path)
+{
+#ifdef __linux__
+	if(watchFd < 0) watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(watchFd < 0) {
+		printf("*** Couldn't start watching files.\n");
+		return 0;
+	}
+	int added = addWatch(path);
+	if(added) printf("watching %d directories in %s\n", added, path);
+	return added;
+#else
+	return 0;
+#endif
+}
+
+// Reads whatever inotify has without waiting.  An editor saving a file usually makes several
+// events for it, they come out as one.
+int pollWatch(char (*changed)[WATCH_PATH], int maxChanged)
+{
+#ifdef __linux__
+	union {
+		struct inotify_event event;	// for the alignment
+		char bytes[4096];
+	} buffer;
+	int i, count;
+
+	if(watchFd < 0) return 0;
+	for(;;) {
+		int size = read(watchFd, buffer.bytes, sizeof(buffer.bytes));
+		if(size <= 0) break;
+		for(i = 0; i < size; ) {
+			const struct inotify_event *event = (const struct inotify_event *)(buffer.bytes + i);
+			int j;
+			i += sizeof(struct inotify_event) + event->len;
+			if(event->mask & IN_Q_OVERFLOW) printf("*** Too many files changed at once, some were missed.\n");
+			for(j = 0; j < watchDirCount && watchDir[j].wd != event->wd; j++);
+			if(j == watchDirCount) continue;
+			if(event->mask & IN_IGNORED) {
+				watchDir[j] = watchDir[--watchDirCount];	// the directory went away
+				continue;
+			}
+			char path[WATCH_PATH];
+			if(!event->len || snprintf(path, sizeof(path), "%s/%s", watchDir[j].path, event->name) >= (int)sizeof(path)) continue;
+			if(event->mask & IN_ISDIR) {
+				if(event->mask & (IN_CREATE | IN_MOVED_TO)) addWatch(path);
+			} else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				addPending(path);
+			}
+		}
+	}
+	count = pendingCount < maxChanged ? pendingCount : maxChanged;
+	if(count) {
+		memcpy(changed, pending, WATCH_PATH * count);
+		pendingCount -= count;
+		memmove(pending, pending + count, WATCH_PATH * pendingCount);
+	}
+	return count;
+#else
+	return 0;
+#endif
+}
+
+void closeWatch()
+{
+#ifdef __linux__
+	if(watchFd >= 0) close(watchFd);
+	watchFd = -1;
+	free(watchDir);
+	watchDir = 0;
+	watchDirCount = watchDirMax = 0;
+	free(pending);
+	pending = 0;
+	pendingCount = pendingMax = 0;
+#endif
+}
@@ -0,0 +1,10 @@
+/* File watching */
+#ifndef WATCH_H
+#define WATCH_H
+
+// watch.c
+#define WATCH_PATH 256	// longest path pollWatch hands back
+int watchDirectory(const char *path);	// watch it and everything under it for files written or moved in, returns the directories added, 0 where there's no inotify
+int pollWatch(char (*changed)[WATCH_PATH], int maxChanged);	// never blocks, each changed file once, the rest wait for the next call
+void closeWatch();
+#endif
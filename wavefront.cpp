@@ -20,6 +20,26 @@
 #endif
 #include "main.h"
 #include "wavefront.h"
+#include "filemap.h"
+#include "jobs.h"
+#include "meshopt.h"
+#include "bvh.h"
+#include "assets.h"
+#include "upload.h"
+#include "arena.h"
+#include "pack.h"
+#include "cull.h"
+#include "hiz.h"
+#ifndef _PSP
+#include "glprocs.h"
+#include "shader.h"
+#endif
+
+#define WAVEFRONT_MAX_CORNERS 32	// most corners in one f line
+#define WAVEFRONT_MIN_CHUNK (256 * 1024)	// smallest slice of an obj worth a thread
+#define WAVEFRONT_MAX_LOD 4	// simplified levels beyond the full model
+#define WAVEFRONT_CACHED_FLAGS (WAVEFRONT_LODS | WAVEFRONT_NO_MERGE | WAVEFRONT_OCCLUSION)	// load options that change what goes in the .mesh cache
+#define WAVEFRONT_NORMAL_ERROR 0.0025f	// most a quantized normal's dot product with the original may fall short of 1,  about 4 degrees
 
 struct Vertex3DT {
 	float u, v; 
@@ -35,30 +55,63 @@ struct Material {
 	unsigned long specular; 
 	unsigned long emissive; 
 	Image *image; 
+	char imagePath[256]; 	// the map_Kd file,  image may have come from another model's copy of it
+	int unlit; 	// "unlit 1",  colour without lighting
 	int useCount; 
 }; 
 
 struct MaterialGroup {
-	int first; 	// vertex
+	int first; 	// vertex,  or index once the model is indexed
 	int last;  // vertex
 	Image *image; 
 	int transparent; 	// transparent things are rendered last.
+	int unlit; 	// its material asks for "unlit 1",  so it's drawn with lighting off
+	int lodFirst[WAVEFRONT_MAX_LOD]; 	// index range for each simplified level
+	int lodLast[WAVEFRONT_MAX_LOD]; 
+	float min[3]; 	// around the full detail triangles,  which hold the simplified ones too
+	float max[3]; 
 }; 
 
-struct WavefrontModel {
+// The loaded data,  shared by every model loaded from the same file with the same flags.
+struct WavefrontMesh {
     char name[64]; 
-    float matrix[16]; 
     struct MaterialGroup *group; 
     int groupCount; 
 	struct Vertex3DTNP *vert; 
     int vertCount; 
+	void *index; 	// triangles into vert,  0 if vert is drawn in order
+	int indexCount; 
+	int indexSize; 	// 2 or 4 bytes
+	struct Vertex3DTNPfast *packed; 	// replaces vert when quantized
+	float packOffset[5]; 	// x, y, z, u, v = packOffset + packed * packScale
+	float packScale[5]; 
+	int lodCount; 	// simplified levels,  their index ranges are in the groups
+	float lodError[WAVEFRONT_MAX_LOD]; 	// furthest each level may be from the full model,  in model units
 	float min[3]; 
 	float max[3]; 	// handy for collision detection.
+	void *materials; 	// the shared parsed .mtl this was built from,  0 if it came from the cache
+	struct Bvh *bvh; 	// full detail triangles for the collision queries,  built on the first one
+	Color *shade; 	// baked ambient occlusion,  a grey per vertex,  0 if it wasn't asked for
+	unsigned int vertexBuffer; 	// GL buffer objects holding vert or packed,  index and shade,  0 until they're streamed in
+	unsigned int indexBuffer; 
+	unsigned int shadeBuffer; 
+	struct FileMap cache; 	// compiled mesh that vert points into,  if it came from one
+	int flags; 	// wavefrontLoadFlags it was loaded with,  for reloading it the same way
+	int queueFrame; 	// when it was last queued,  see queueWavefront
+	int queueSlot; 	// its number in that frame's render queue,  shared by all the models drawing it
+}; 
+
+// What loadWavefront hands out,  each placed on its own.
+struct WavefrontModel {
+	float matrix[16]; 
+	struct WavefrontMesh *mesh; 
 }; 
 
 struct WavefrontState {
 	int face; 
 	int faceMax; 
+	int vertMax; 	// capacity of mod->vert
+	int groupMax; 	// capacity of mod->group
 	struct Material *material; 
 	int materialCount; 
 	struct Material *currentMaterial; 
@@ -71,8 +124,165 @@ struct WavefrontState {
 	struct Vertex3DT *texture; 
 	int textureCount; 
 	int textureMax; 
+	struct WavefrontChunk *chunk; 	// set while parsing one slice of the file on a job thread
+	struct Arena *arena; 	// the position,  normal and texture lists go here,  they only last the load
+}; 
+
+// A usemtl seen by a chunk,  applied in order once all the chunks are parsed.
+struct WavefrontChunkMaterial {
+	int face; 	// chunk face it comes before
+	int triangle; 	// chunk triangle it comes before,  once resolved
+	char name[64]; 
+}; 
+
+// Faces keep their raw obj indices,  and the list sizes at that line,  until the chunks before are known.
+struct WavefrontChunkFace {
+	int first; 	// into corner
+	int corners; 
+	int positionCount; 
+	int textureCount; 
+	int normalCount; 
+}; 
+
+struct WavefrontChunk {
+	const char *start; 
+	const char *end; 
+	struct Arena arena; 	// this thread's lists
+	struct WavefrontState state; 	// chunk local position,  normal and texture lists
+	int *corner; 	// v, t, n triples
+	int cornerCount; 
+	int cornerMax; 
+	struct WavefrontChunkFace *face; 
+	int faceCount; 
+	int faceMax; 
+	struct WavefrontChunkMaterial *usemtl; 
+	int usemtlCount; 
+	int usemtlMax; 
+	int positionBase; 	// lists in the chunks before this one
+	int textureBase; 
+	int normalBase; 
+	struct WavefrontMesh part; 	// this chunk's triangles
+	struct WavefrontState partState; 
+}; 
+
+int wavefrontLoadFlags = 0; 
+int wavefrontLoadThreads = 0; 
+int wavefrontQueueThreads = 0; 
+float wavefrontLodBias = 1.0f; 
+int wavefrontLodLevel = -1; 
+int wavefrontUseBuffers = 1; 
+int wavefrontUseInstancing = 1; 
+int wavefrontUseShaders = 1; 
+
+// Make room for one more item in a realloc'd array,  doubling it as needed.
+static void *growArray(void *array, int *max, int count, int size)
+{
+	if(count < *max) return array; 
+	int newMax = *max < 16 ? 16 : *max * 2; 
+	array = realloc(array, (size_t)newMax * size); 
+	if(!array) {
+		printf("*** Out of memory growing array to %d items\n", newMax); 
+		exit(1); 
+	}
+	*max = newMax; 
+	return array; 
+}
+
+static const char *skipWhite(const char *s, const char *end)
+{
+	while(s < end && (s[0] == ' ' || s[0] == '\t')) s++; 
+	return s; 
+}
+
+// Returns the end of the number,  or s if there wasn't one.
+static const char *parseWavefrontInt(const char *s, const char *end, int *out)
+{
+	const char *start = s; 
+	int neg = 0, value = 0; 
+	if(s < end && (s[0] == '-' || s[0] == '+')) neg = *s++ == '-'; 
+	if(s >= end || s[0] < '0' || s[0] > '9') return start; 
+	while(s < end && s[0] >= '0' && s[0] <= '9') value = value * 10 + (*s++ - '0'); 
+	*out = neg ? -value : value; 
+	return s; 
+}
+
+// Anything the fast path can't be sure about goes through strtof,  so the results match sscanf.
+static const char *parseWavefrontFloatSlow(const char *s, const char *end, float *out)
+{
+	char buf[64]; 
+	int len = 0; 
+	while(s + len < end && len < 63 && s[len] != ' ' && s[len] != '\t' && s[len] != '/' && s[len] != '\r') len++; 
+	memcpy(buf, s, len); 
+	buf[len] = 0; 
+	char *stop; 
+	float f = strtof(buf, &stop); 
+	if(stop == buf) return s; 
+	*out = f; 
+	return s + (stop - buf); 
+}
+
+static const double powersOfTen[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
 }; 
 
+static const char *parseWavefrontFloat(const char *s, const char *end, float *out)
+{
+	const char *start = s; 
+	unsigned long long mantissa = 0; 
+	int digits = 0, seen = 0, exponent = 0, neg = 0; 
+	if(s < end && (s[0] == '-' || s[0] == '+')) neg = *s++ == '-'; 
+	for(; s < end && s[0] >= '0' && s[0] <= '9'; s++, seen++) {
+		if(digits < 19) {
+			mantissa = mantissa * 10 + (s[0] - '0'); 
+			if(mantissa) digits++; 
+		} else exponent++; 
+	}
+	if(s < end && s[0] == '.') {
+		for(s++; s < end && s[0] >= '0' && s[0] <= '9'; s++, seen++) {
+			if(digits < 19) {
+				mantissa = mantissa * 10 + (s[0] - '0'); 
+				if(mantissa) digits++; 
+				exponent--; 
+			}
+		}
+	}
+	if(!seen) return parseWavefrontFloatSlow(start, end, out); 	// inf, nan and friends
+	if(s < end && (s[0] == 'e' || s[0] == 'E')) {
+		int e = 0; 
+		const char *next = parseWavefrontInt(s + 1, end, &e); 
+		if(next != s + 1) {
+			exponent += e; 
+			s = next; 
+		}
+	}
+	if(mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		// both operands are exact in a double,  so d is correctly rounded.
+		double d = (double)mantissa; 
+		d = exponent < 0 ? d / powersOfTen[-exponent] : d * powersOfTen[exponent]; 
+		if(d == 0 || (d >= 1.17549435e-38 && d <= 3.40282346e+38)) {
+			// Rounding d to a float again only goes wrong if d sits within an ulp of a float half way point.
+			unsigned long long bits, low; 
+			memcpy(&bits, &d, sizeof(bits)); 
+			low = bits & ((1ULL << 29) - 1); 
+			if(low + 1 < (1ULL << 28) || low > (1ULL << 28) + 1) {
+				*out = neg ? -(float)d : (float)d; 
+				return s; 
+			}
+		}
+	}
+	return parseWavefrontFloatSlow(start, end, out); 
+}
+
+// OBJ indices are 1 based,  or relative to the end of the list when negative.  0 means missing,  which
+// comes back as -1.  Relative ones from before the start come back as count,  to be out of range.
+static int resolveWavefrontIndex(int index, int count)
+{
+	if(index > 0) return index - 1; 
+	if(index < 0) return count + index >= 0 ? count + index : count; 
+	return -1; 
+}
+
 void scanWavefront(FILE *file, int *vCount, int *tCount, int *nCount, int *fCount, int *gCount)
 {
 	size_t initialSeek = ftell(file); 
@@ -104,96 +314,155 @@ void scanWavefront(FILE *file, int *vCount, int *tCount, int *nCount, int *fCoun
 	fseek(file, initialSeek, SEEK_SET); 
 }
 
-void loadMaterials(const char *fname, struct Material *material, int maxMaterial, int *materialCount)
+// "Kd 0.8 0.8 0.8" style colours,  packed like the rest of the colours.
+static unsigned long parseMaterialColor(const char *s, const char *end)
+{
+	float rf = 0, gf = 0, bf = 0; 
+	unsigned long r, g, b; 
+	s = parseWavefrontFloat(skipWhite(s, end), end, &rf); 
+	s = parseWavefrontFloat(skipWhite(s, end), end, &gf); 
+	s = parseWavefrontFloat(skipWhite(s, end), end, &bf); 
+	r = (int)(rf * 255); 
+	g = (int)(gf * 255); 
+	b = (int)(bf * 255); 
+	return (r)|(g << 8)|(b << 16)|(255 << 24); 
+}
+
+static void releaseImageAsset(void *data)
+{
+#ifndef _PSP
+	cancelUploads(data); 
+#endif
+	freeImage((Image *)data); 
+}
+
+static void releaseMaterialImage(Image *image)
+{
+	if(releaseAsset(image) < 0) releaseImageAsset(image); 
+}
+
+// Images are shared through the asset registry,  by path or else by what's in the file,  so a
+// texture that several models ship a copy of is only decoded and uploaded once.  This runs on the
+// job threads too,  so the swizzling waits for swizzleWavefrontImages on the GL thread.
+Image *loadMaterialImage(const char *path)
+{
+	Image *image = (Image *)findAsset(ASSET_IMAGE, path, 0); 
+	if(image) return image; 
+	unsigned long long hash = hashPackedFile(path); 
+	if(hash) image = (Image *)findAsset(ASSET_IMAGE, 0, hash); 
+	if(image) {
+		printf("'%s' is the same as '%s',  sharing it\n", path, image->filename); 
+		return image; 
+	}
+	image = loadPng(path); 
+	if(!image) {
+		printf("Couldn't locate '%s'\n", path); 
+		return 0; 
+	}
+	Image *shared = (Image *)addAsset(ASSET_IMAGE, path, hash, image, releaseImageAsset); 
+	if(shared != image) freeImage(image); 
+	return shared; 
+}
+
+void loadMaterials(const char *fname, int flags, struct Material **materialOut, int *materialMax, int *materialCount)
 {
 	char path[256]; 
+	struct FileMap map; 
 	//printf("read materials for '%s'\n", fname); 
 	sprintf(path, "models/%s/%s.mtl", fname, fname); 
-//	gzFile file = gzopen(path, "r"); 
-	FILE *file = fopen(path, "r"); 
 	*materialCount = 0; 
 	int nextMaterial = 0; 
-	if(!file) return; 
+	if(!mapPackedFile(path, &map)) return; 
 	
-	// Read in the materials.
-	char line[256]; 
-	line[255] = 0; 
+	// Read in the materials,  tokenized in place.
 	int mat = nextMaterial; 
+	struct Material *material = *materialOut; 
+	const char *next = map.data, *fileEnd = map.data + map.size; 
 
-	while( fgets(line, 255, file) ) {
-		char cmd[64]; 
+	while(next < fileEnd) {
+		const char *end = (const char *)memchr(next, '\n', fileEnd - next); 
+		if(!end) end = fileEnd; 
+		const char *line = skipWhite(next, end); 
+		next = end + 1; 
+		while(end > line && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) end--; 
+		const char *cmd = line; 
+		while(line < end && line[0] != ' ' && line[0] != '\t') line++; 
+		int cmdLen = line - cmd; 
+		line = skipWhite(line, end); 
 
-		cmd[0] = 0; 
-		sscanf(line, "%s", cmd); 
-		if(strchr(line, '\r')) strchr(line, '\r')[0] = 0; 
-		if(strchr(line, '\n')) strchr(line, '\n')[0] = 0; 
-
-		if(strcmp(cmd, "newmtl") == 0 ) {
+		if(cmdLen == 6 && strncmp(cmd, "newmtl", 6) == 0) {
+			material = (struct Material *)growArray(material, materialMax, nextMaterial, sizeof(struct Material)); 
 			mat = nextMaterial; 
 			nextMaterial++; 
-			strcpy(material[mat].name, line + 7); 
+			memset(material + mat, 0, sizeof(struct Material)); 
+			int len = end - line < 63 ? (int)(end - line) : 63; 
+			memcpy(material[mat].name, line, len); 
+			material[mat].name[len] = 0; 
 			material[mat].color = 0; 
 			material[mat].image = 0; 
 			material[mat].useCount = 0; 
-			if(nextMaterial >= maxMaterial) {
-				printf("*** Maximum materials exceeded.\n"); 
-				break; 
-			}
 			//printf("Located material '%s'\n", material[mat].name); 
-		} else if( strcmp(cmd, "Ka") == 0) {
-			float rf = 0, gf = 0, bf = 0; 
-			unsigned long r, g, b; 
-			sscanf(line, "Ka%f%f%f", &rf, &gf, &bf); 
-			r = (int)(rf * 255); 
-			g = (int)(gf * 255); 
-			b = (int)(bf * 255); 
-			material[mat].ambient = (r)|(g << 8)|(b << 16)|(255 << 24); 
-		} else if( strcmp(cmd, "Ks") == 0) {
-			float rf = 0, gf = 0, bf = 0; 
-			unsigned long r, g, b; 
-			sscanf(line, "Ks%f%f%f", &rf, &gf, &bf); 
-			r = (int)(rf * 255); 
-			g = (int)(gf * 255); 
-			b = (int)(bf * 255); 
-			material[mat].specular = (r)|(g << 8)|(b << 16)|(255 << 24); 
-		} else if( strcmp(cmd, "Kd") == 0) {
-			float rf = 0, gf = 0, bf = 0; 
-			unsigned long r, g, b; 
-			sscanf(line, "Kd%f%f%f", &rf, &gf, &bf); 
-			r = (int)(rf * 255); 
-			g = (int)(gf * 255); 
-			b = (int)(bf * 255); 
-			material[mat].color = (r)|(g << 8)|(b << 16)|(255 << 24); 
-		} else if( strcmp(cmd, "Ke") == 0) {
-			float rf = 0, gf = 0, bf = 0; 
-			unsigned long r, g, b; 
-			sscanf(line, "Ke%f%f%f", &rf, &gf, &bf); 
-			r = (int)(rf * 255); 
-			g = (int)(gf * 255); 
-			b = (int)(bf * 255); 
-			material[mat].emissive = (r)|(g << 8)|(b << 16)|(255 << 24); 
-		} else if( strcmp(cmd, "map_Kd") == 0) {
+		} else if(nextMaterial == 0) {
+			continue; 	// nothing to attach it to before the first newmtl
+		} else if(cmdLen == 2 && cmd[0] == 'K') {
+			if(cmd[1] == 'a') material[mat].ambient = parseMaterialColor(line, end); 
+			else if(cmd[1] == 's') material[mat].specular = parseMaterialColor(line, end); 
+			else if(cmd[1] == 'd') material[mat].color = parseMaterialColor(line, end); 
+			else if(cmd[1] == 'e') material[mat].emissive = parseMaterialColor(line, end); 
+		} else if(cmdLen == 5 && strncmp(cmd, "unlit", 5) == 0) {
+			// ours,  not in the mtl format.  Exporters write illum 0 for lit materials too,  so that's no guide.
+			int unlit = 0; 
+			parseWavefrontInt(line, end, &unlit); 
+			material[mat].unlit = unlit != 0; 
+		} else if(cmdLen == 6 && strncmp(cmd, "map_Kd", 6) == 0) {
 			char path[256]; 
-			char *s = line; 
-			while (s[0] == ' ' || s[0] == '\t') s++; 	// skip white space
-			s += 6; 
-			while(s[0] == ' ' || s[0] == '\t') s++; 		// skip white space
-			if(strrchr(s, '\\')) s = strrchr(s, '\\') + 1; 
-			if(strrchr(s, '/')) s = strrchr(s, '/') + 1; 
-			sprintf(path, "models/%s/%s", fname, s); 
-			material[mat].image = loadPng(path); 
-			if(material[mat].image) {
-				if(material[mat].image->textureWidth > 64 || material[mat].image->textureHeight > 64) swizzleToVRam = 1;  else swizzleToVRam = 0; 
-				swizzleFast(material[mat].image); 
+			const char *s; 
+			for(s = end; s > line; s--) {
+				if(s[-1] == '\\' || s[-1] == '/') break; 
 			}
-			if(!material[mat].image) printf("Couldn't locate '%s'\n", path); 
+			snprintf(path, sizeof(path), "models/%s/%.*s", fname, (int)(end - s), s); 
+			strcpy(material[mat].imagePath, path); 
+			if(flags & WAVEFRONT_NO_TEXTURES) continue; 
+			material[mat].image = loadMaterialImage(path); 
 		}
 	}
-	fclose(file); 
+	unmapFile(&map); 
 	printf("read %d materials for %s\n", nextMaterial, fname); 
+	*materialOut = material; 
 	*materialCount = nextMaterial; 
 }
 
+struct MaterialSet {
+	struct Material *material; 
+	int count; 
+	int max; 
+}; 
+
+static void releaseMaterialSet(void *data)
+{
+	struct MaterialSet *set = (struct MaterialSet *)data; 
+	int i; 
+	for(i = 0; i < set->count; i++) {
+		if(set->material[i].image) releaseMaterialImage(set->material[i].image); 
+	}
+	free(set->material); 
+	free(set); 
+}
+
+// The parsed .mtl is shared too,  holding a reference to each of its images.
+static struct MaterialSet *acquireMaterials(const char *fname, int flags)
+{
+	char key[280]; 
+	snprintf(key, sizeof(key), "models/%s/%s.mtl%s", fname, fname, (flags & WAVEFRONT_NO_TEXTURES) ? "?notextures" : ""); 
+	struct MaterialSet *set = (struct MaterialSet *)findAsset(ASSET_MATERIALS, key, 0); 
+	if(set) return set; 
+	set = (struct MaterialSet *)calloc(sizeof(struct MaterialSet), 1); 
+	loadMaterials(fname, flags, &set->material, &set->max, &set->count); 
+	struct MaterialSet *shared = (struct MaterialSet *)addAsset(ASSET_MATERIALS, key, 0, set, releaseMaterialSet); 
+	if(shared != set) releaseMaterialSet(set); 
+	return shared; 
+}
+
 struct Material *findMaterial(struct Material *material, int materialCount, const char *name)
 {
 	int i; 
@@ -206,30 +475,63 @@ struct Material *findMaterial(struct Material *material, int materialCount, cons
 	return material; 
 }
 
-void fillWavefrontFace(struct WavefrontModel *mod, struct WavefrontState *state, int *v, int *t, int *n)
+void addWavefrontGroup(struct WavefrontMesh *mod, struct WavefrontState *state, const char *materialName)
 {
-	int i; 
+	mod->group = (struct MaterialGroup *)growArray(mod->group, &state->groupMax, mod->groupCount, sizeof(struct MaterialGroup)); 
+	struct MaterialGroup *group = mod->group + mod->groupCount++; 
+	group->first = state->face * 3; 
+	group->last = state->face * 3; 
+	group->image = 0; 
+	group->transparent = 0; 
+	group->unlit = 0; 
+	if(!materialName) return; 
+	state->currentMaterial = findMaterial(state->material, state->materialCount, materialName); 
+	group->image = state->currentMaterial->image; 
+	group->transparent = strcmp(state->currentMaterial->name, "Iceglass") == 0?1:0; 
+	group->unlit = state->currentMaterial->unlit; 
+	//printf("usemtl '%s' -> image '%s' for vert %d on\n", state->currentMaterial->name, state->currentMaterial->image->filename, state->face * 3); 
+}
+
+// t and n are -1 where the corner left them out,  "v",  "v/t" or "v//n".  Those get uv 0, 0 and the
+// face's own normal.
+void fillWavefrontFace(struct WavefrontMesh *mod, struct WavefrontState *state, int *v, int *t, int *n)
+{
+	float faceNormal[3] = { 0, 0, 0 }; 
+	int i, missingNormal = 0; 
 	for(i = 0; i < 3; i++) {
 		// do range checking on the parameters.
 		if(v[i] < 0 || v[i] >= state->positionCount) {
 			printf("*** vertex out of range: %d of %d\n", v[i], state->positionCount); 
 			return; 
 		}
-		if(t[i] < 0 || t[i] >= state->textureCount) {
+		if(t[i] < -1 || t[i] >= state->textureCount) {
 			printf("*** texture coordinate out of range: %d of %d\n", t[i], state->textureCount); 
 			return; 
 		}
-		if(n[i] < 0 || n[i] >= state->normalCount) {
+		if(n[i] < -1 || n[i] >= state->normalCount) {
 			printf("*** normal out of range: %d of %d\n", n[i], state->normalCount); 
 			return; 
 		}
+		if(n[i] < 0) missingNormal = 1; 
+	}
+	if(missingNormal) {
+		const struct Vertex3DP *p0 = state->position + v[0], *p1 = state->position + v[1], *p2 = state->position + v[2]; 
+		float a[3] = { p1->x - p0->x, p1->y - p0->y, p1->z - p0->z }, b[3] = { p2->x - p0->x, p2->y - p0->y, p2->z - p0->z }; 
+		faceNormal[0] = a[1] * b[2] - a[2] * b[1]; 
+		faceNormal[1] = a[2] * b[0] - a[0] * b[2]; 
+		faceNormal[2] = a[0] * b[1] - a[1] * b[0]; 
+		float length = sqrtf(faceNormal[0] * faceNormal[0] + faceNormal[1] * faceNormal[1] + faceNormal[2] * faceNormal[2]); 
+		for(i = 0; i < 3; i++) faceNormal[i] = length > 0 ? faceNormal[i] / length : 0; 	// zero for a sliver
+	}
+	mod->vert = (struct Vertex3DTNP *)growArray(mod->vert, &state->vertMax, state->face * 3 + 2, sizeof(struct Vertex3DTNP)); 
+	for(i = 0; i < 3; i++) {
 		// fill in the data in the face.
 		struct Vertex3DTNP *vert = mod->vert + state->face * 3 + i; 
-		vert->u = state->texture[t[i]].u; 
-		vert->v = state->texture[t[i]].v; 
-		vert->nx = state->normal[n[i]].x; 
-		vert->ny = state->normal[n[i]].y; 
-		vert->nz = state->normal[n[i]].z; 
+		vert->u = t[i] < 0 ? 0 : state->texture[t[i]].u; 
+		vert->v = t[i] < 0 ? 0 : state->texture[t[i]].v; 
+		vert->nx = n[i] < 0 ? faceNormal[0] : state->normal[n[i]].x; 
+		vert->ny = n[i] < 0 ? faceNormal[1] : state->normal[n[i]].y; 
+		vert->nz = n[i] < 0 ? faceNormal[2] : state->normal[n[i]].z; 
 		vert->x = state->position[v[i]].x; 
 		vert->y = state->position[v[i]].y; 
 		vert->z = state->position[v[i]].z; 
@@ -249,18 +551,13 @@ void fillWavefrontFace(struct WavefrontModel *mod, struct WavefrontState *state,
 		if(mod->max[1] < vert->y) mod->max[1] = vert->y; 
 		if(mod->max[2] < vert->z) mod->max[2] = vert->z; 
 	}	
+	if(mod->groupCount == 0) addWavefrontGroup(mod, state, 0); 	// faces before any usemtl
 	state->face++; 
-	if(state->face * 3 > mod->vertCount) printf("face out of range: %d instead of %d\n", state->face, mod->vertCount/3); 
-	int g = mod->groupCount - 1; 
-	if(g < 0) g = 0; 	// no materials special case.
-	if(state->face < 0) { 
-		printf("State face invalid!\n");  
-		exit(1);  
-	}
-	mod->group[g].last = state->face * 3; 
+	mod->group[mod->groupCount - 1].last = state->face * 3; 
 }
 
-void loadWavefrontLine(char *line, struct WavefrontModel *mod, struct WavefrontState *state)
+// Original sscanf based line parser.  Only used by loadWavefrontTwoPass.
+void loadWavefrontLine(char *line, struct WavefrontMesh *mod, struct WavefrontState *state)
 {
 	while(line[0] == ' ' || line[0] == '\t') line++; 
 	if(strchr(line, '\n')) strchr(line, '\n')[0] = 0; 
@@ -302,230 +599,2835 @@ void loadWavefrontLine(char *line, struct WavefrontModel *mod, struct WavefrontS
 			if(state->positionCount >= state->positionMax) printf("Position count at %d of %d\n", state->positionCount, state->positionMax); 
 		}
 	} else if(strncmp(line, "usemtl", 6) == 0) {
-		state->currentMaterial = findMaterial(state->material, state->materialCount, line + 7); 
-		mod->groupCount++; 
-		int g = mod->groupCount-1; 
-		mod->group[g].first = state->face * 3; 
-		mod->group[g].last = state->face * 3; 
-		mod->group[g].image = state->currentMaterial->image; 
-		mod->group[g].transparent = strcmp(state->currentMaterial->name, "Iceglass") == 0?1:0; 
-		//printf("usemtl '%s' -> image '%s' for vert %d on\n", state->currentMaterial->name, state->currentMaterial->image->filename, state->face * 3); 
+		addWavefrontGroup(mod, state, line + 7); 
 	}
 }
 
-struct WavefrontModel *loadWavefront(const char *fname)
+// Count everything first,  then parse each line with sscanf.  This is the original loader,  kept
+// around so that -bench load has something to compare against.
+void loadWavefrontTwoPass(FILE *file, struct WavefrontMesh *mod, struct WavefrontState *state)
 {
-	struct WavefrontModel *mod = (struct WavefrontModel *)calloc(sizeof(struct WavefrontModel), 1); 
-	strcpy(mod->name, fname); 
-	char path[256]; 
-	struct Material material[64]; 	// at most 64 materials.  not sure why.
-	memset(material, 0, sizeof(material)); 
-	int materialCount = 0; 
-	FILE *file; 
-	struct WavefrontState state; 
-
-	loadMaterials(fname, material + 0, 64, &materialCount); 
-
-	printf("read obj for '%s'\n", fname); 
-	sprintf(path, "models/%s/%s.obj", fname, fname); 
-	file = fopen(path, "r"); 
-	if(!file) {
-		printf("Couldn't find %s\n", path); 
-		return 0; 
-	}
-	// Count the verts.
 	int vCount, vtCount, vnCount, fCount, gCount; 
 	scanWavefront(file, &vCount, &vtCount, &vnCount, &fCount, &gCount); 
 	printf("Found %d image verts,  %d texture verts,  %d normal verts,  %d groups and %d faces.\n", vCount, vtCount, vnCount, gCount, fCount); 
-	strcpy(mod->name, fname); 
-	mod->groupCount = 0; 
 	mod->group = (struct MaterialGroup *)calloc(sizeof(struct MaterialGroup), gCount); 
-	mod->vertCount = fCount * 3; 
+	state->groupMax = gCount; 
 	mod->vert = (struct Vertex3DTNP *)calloc(sizeof(struct Vertex3DTNP), fCount * 3); 
-	
-	state.face = 0; 
-	state.faceMax = fCount; 
-	state.position = (struct Vertex3DP *)calloc(sizeof(struct Vertex3DP), vCount); 
-	state.positionCount = 0; 
-	state.positionMax = vCount; 
-	state.normal = (struct Vertex3DP *)calloc(sizeof(struct Vertex3DP), vnCount); 
-	state.normalCount = 0; 
-	state.normalMax = vnCount; 
-	state.texture = (struct Vertex3DT *)calloc(sizeof(struct Vertex3DT), vtCount); 
-	state.textureCount = 0; 
-	state.textureMax = vtCount; 
-	state.material = material; 
-	state.materialCount = materialCount; 
-	state.currentMaterial = 0; 
-	
-	//printf("item[nextItem].vert = %08x\n", (int)item[nextItem].vert); 
-	int i; 
-	for(i = 0; i < 16; i++) {
-		mod->matrix[i] = (i % 4) == (i/4)?1.0f:0; 
-	}
+	state->vertMax = fCount * 3; 
+	state->faceMax = fCount; 
+	state->position = (struct Vertex3DP *)arenaCalloc(state->arena, sizeof(struct Vertex3DP) * vCount); 
+	state->positionMax = vCount; 
+	state->normal = (struct Vertex3DP *)arenaCalloc(state->arena, sizeof(struct Vertex3DP) * vnCount); 
+	state->normalMax = vnCount; 
+	state->texture = (struct Vertex3DT *)arenaCalloc(state->arena, sizeof(struct Vertex3DT) * vtCount); 
+	state->textureMax = vtCount; 
 
 	char line[256]; 
 	while(fgets(line, 255, file)) {
-		loadWavefrontLine(line, mod, &state); 
+		loadWavefrontLine(line, mod, state); 
 	}
-	if(state.texture) free(state.texture); 
-	state.texture = 0; 
-	if(state.normal) free(state.normal); 
-	state.normal = 0; 
-	if(state.position) free(state.position); 
-	state.position = 0; 
-	fclose(file); 
-	// now clean up the materials that weren't used,  if any
-	for(i = 0; i < materialCount; i++) {
-		if(material[i].useCount == 0) {
-			printf("*** Material '%s' unused!\n", material[i].name); 
-			if(material[i].image) freeImage(material[i].image); 
-			material[i].image = 0; 
+}
+
+// Fan out from the first corner,  last triangle first,  so quads come out in the same order as the
+// original loader.  Indices are already resolved to 0 based.
+void fillWavefrontPolygon(struct WavefrontMesh *mod, struct WavefrontState *state, int *v, int *t, int *n, int corners)
+{
+	int i; 
+	for(i = corners - 2; i >= 1; i--) {
+		int vt[3] = {v[0], v[i], v[i + 1]}, tt[3] = {t[0], t[i], t[i + 1]}, nt[3] = {n[0], n[i], n[i + 1]}; 
+		fillWavefrontFace(mod, state, vt, tt, nt); 
+	}
+}
+
+void recordWavefrontFace(struct WavefrontChunk *chunk, int *v, int *t, int *n, int corners)
+{
+	int i; 
+	chunk->face = (struct WavefrontChunkFace *)arenaGrow(&chunk->arena, chunk->face, &chunk->faceMax, chunk->faceCount, sizeof(struct WavefrontChunkFace)); 
+	struct WavefrontChunkFace *face = chunk->face + chunk->faceCount++; 
+	face->first = chunk->cornerCount; 
+	face->corners = corners; 
+	face->positionCount = chunk->state.positionCount; 
+	face->textureCount = chunk->state.textureCount; 
+	face->normalCount = chunk->state.normalCount; 
+	for(i = 0; i < corners; i++) {
+		chunk->corner = (int *)arenaGrow(&chunk->arena, chunk->corner, &chunk->cornerMax, chunk->cornerCount * 3 + 2, sizeof(int)); 
+		chunk->corner[chunk->cornerCount * 3] = v[i]; 
+		chunk->corner[chunk->cornerCount * 3 + 1] = t[i]; 
+		chunk->corner[chunk->cornerCount * 3 + 2] = n[i]; 
+		chunk->cornerCount++; 
+	}
+}
+
+// Parse one line,  s to end with no line terminator.
+void parseWavefrontLine(const char *s, const char *end, struct WavefrontMesh *mod, struct WavefrontState *state)
+{
+	s = skipWhite(s, end); 
+	while(end > s && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) end--; 
+	if(s >= end || s[0] == '#') return; 
+	if(s[0] == 'f' && s + 1 < end && (s[1] == ' ' || s[1] == '\t')) {
+		int v[WAVEFRONT_MAX_CORNERS], t[WAVEFRONT_MAX_CORNERS], n[WAVEFRONT_MAX_CORNERS]; 
+		int corners = 0; 
+		s++; 
+		while(corners < WAVEFRONT_MAX_CORNERS) {
+			int vi = 0, ti = 0, ni = 0; 
+			s = skipWhite(s, end); 
+			const char *next = parseWavefrontInt(s, end, &vi); 
+			if(next == s) break; 
+			s = next; 
+			if(s < end && s[0] == '/') {
+				s = parseWavefrontInt(s + 1, end, &ti); 
+				if(s < end && s[0] == '/') s = parseWavefrontInt(s + 1, end, &ni); 
+			}
+			v[corners] = vi; 
+			t[corners] = ti; 
+			n[corners] = ni; 
+			corners++; 
+		}
+		if(state->chunk) {
+			recordWavefrontFace(state->chunk, v, t, n, corners); 
+			return; 
+		}
+		int i; 
+		for(i = 0; i < corners; i++) {
+			v[i] = resolveWavefrontIndex(v[i], state->positionCount); 
+			t[i] = resolveWavefrontIndex(t[i], state->textureCount); 
+			n[i] = resolveWavefrontIndex(n[i], state->normalCount); 
+		}
+		fillWavefrontPolygon(mod, state, v, t, n, corners); 
+	} else if(s[0] == 'v' && s + 1 < end) {
+		float x = 0, y = 0, z = 0; 
+		if(s[1] == 't') {
+			s = parseWavefrontFloat(skipWhite(s + 2, end), end, &x); 
+			s = parseWavefrontFloat(skipWhite(s, end), end, &y); 
+			state->texture = (struct Vertex3DT *)arenaGrow(state->arena, state->texture, &state->textureMax, state->textureCount, sizeof(struct Vertex3DT)); 
+			state->texture[state->textureCount].u = x; 
+			state->texture[state->textureCount++].v = 1 - y; 
+		} else if(s[1] == 'n') {
+			s = parseWavefrontFloat(skipWhite(s + 2, end), end, &x); 
+			s = parseWavefrontFloat(skipWhite(s, end), end, &y); 
+			s = parseWavefrontFloat(skipWhite(s, end), end, &z); 
+			state->normal = (struct Vertex3DP *)arenaGrow(state->arena, state->normal, &state->normalMax, state->normalCount, sizeof(struct Vertex3DP)); 
+			state->normal[state->normalCount].x = x; 
+			state->normal[state->normalCount].y = y; 
+			state->normal[state->normalCount++].z = z; 
+		} else if(s[1] == ' ' || s[1] == '\t') {
+			s = parseWavefrontFloat(skipWhite(s + 1, end), end, &x); 
+			s = parseWavefrontFloat(skipWhite(s, end), end, &y); 
+			s = parseWavefrontFloat(skipWhite(s, end), end, &z); 
+			state->position = (struct Vertex3DP *)arenaGrow(state->arena, state->position, &state->positionMax, state->positionCount, sizeof(struct Vertex3DP)); 
+			state->position[state->positionCount].x = x; 
+			state->position[state->positionCount].y = y; 
+			state->position[state->positionCount++].z = z; 
+		}
+	} else if(end - s > 6 && strncmp(s, "usemtl", 6) == 0) {
+		char name[64]; 
+		s = skipWhite(s + 6, end); 
+		int len = end - s < 63 ? (int)(end - s) : 63; 
+		memcpy(name, s, len); 
+		name[len] = 0; 
+		if(state->chunk) {
+			struct WavefrontChunk *chunk = state->chunk; 
+			chunk->usemtl = (struct WavefrontChunkMaterial *)arenaGrow(&chunk->arena, chunk->usemtl, &chunk->usemtlMax, chunk->usemtlCount, sizeof(struct WavefrontChunkMaterial)); 
+			chunk->usemtl[chunk->usemtlCount].face = chunk->faceCount; 
+			strcpy(chunk->usemtl[chunk->usemtlCount++].name, name); 
+		} else {
+			addWavefrontGroup(mod, state, name); 
 		}
 	}
-	
-	return mod; 
 }
 
-int cmpMaterialGroupImage(const void *one, const void *two)
+// Parse every complete line in the buffer,  returns where the trailing partial line starts.
+const char *parseWavefrontBuffer(const char *s, const char *end, struct WavefrontMesh *mod, struct WavefrontState *state)
 {
-	const struct MaterialGroup *a = (struct MaterialGroup *)one, *b = (struct MaterialGroup *)two; 
-	
-	return 	a->image < b->image?-1:a->image>b->image?1:0; 
+	for(;;) {
+		const char *eol = (const char *)memchr(s, '\n', end - s); 
+		if(!eol) return s; 
+		parseWavefrontLine(s, eol, mod, state); 
+		s = eol + 1; 
+	}
 }
 
-void freeWavefront(struct WavefrontModel *mod)
+// Single pass loader: read the file in large blocks and parse lines straight out of the block.
+void streamWavefront(FILE *file, struct WavefrontMesh *mod, struct WavefrontState *state)
 {
-	qsort(mod->group, mod->groupCount, sizeof(struct MaterialGroup), cmpMaterialGroupImage); 
-	Image *last = 0; 
-	int j; 
-	for(j = 0; j < mod->groupCount; j++) {
-		struct MaterialGroup *g = mod->group + j; 
-		if(g->image != 0 && g->image != last) {
-			freeImage(g->image); 
-			last = g->image; 
-			g->image = 0; 
+	size_t size = 65536, have = 0; 
+	char *buffer = (char *)arenaAlloc(state->arena, size); 
+	for(;;) {
+		size_t got = fread(buffer + have, 1, size - have, file); 
+		have += got; 
+		const char *rest = parseWavefrontBuffer(buffer, buffer + have, mod, state); 
+		if(got == 0) {
+			parseWavefrontLine(rest, buffer + have, mod, state); 	// last line has no newline
+			break; 
+		}
+		have = buffer + have - rest; 
+		memmove(buffer, rest, have); 
+		if(have == size) {
+			char *longer = (char *)arenaAlloc(state->arena, size * 2); 	// a very long line
+			memcpy(longer, buffer, have); 
+			buffer = longer; 
+			size *= 2; 
 		}
 	}
+}
 
-	if(mod->group) free(mod->group); 
-	mod->group = 0; 
-	if(mod->vert) free(mod->vert); 
-	mod->vert = 0; 
-	free(mod);
+static void parseWavefrontChunk(void *arg, int index)
+{
+	struct WavefrontChunk *chunk = (struct WavefrontChunk *)arg + index; 
+	chunk->state.chunk = chunk; 
+	chunk->state.arena = &chunk->arena; 
+	const char *rest = parseWavefrontBuffer(chunk->start, chunk->end, 0, &chunk->state); 
+	parseWavefrontLine(rest, chunk->end, 0, &chunk->state); 
 }
 
-void drawWavefrontPartial(struct WavefrontModel *mod, int transparent)
+// Turn a chunk's faces into triangles now that the lists before it are known.
+static void resolveWavefrontChunk(void *arg, int index)
 {
-	if(!mod) return; 
-#ifdef _PSP
-	//printf("Rendering item %d\n", i); 
-	sceGumMatrixMode(GU_MODEL); 
-	sceGumPushMatrix(); 
-	sceGumMultMatrix((ScePspFMatrix4 *)mod->matrix); 
-	int j = 0; 
-	int g; 
-	int jCount; 
-	//printf("item image: %08x\n", (int)item[i].image); 
-	sceGuEnable(GU_TEXTURE_2D); 
-	sceGuColor(0xffffffff); 
-	sceGuFrontFace(GU_CCW); 
+	struct WavefrontChunk *chunk = (struct WavefrontChunk *)arg + index; 
+	struct WavefrontState *state = &chunk->partState; 
+	int v[WAVEFRONT_MAX_CORNERS], t[WAVEFRONT_MAX_CORNERS], n[WAVEFRONT_MAX_CORNERS]; 
+	int f, m = 0, i; 
 
-	sceGuTexScale(1.0f, 1.0f); 
-	sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA); 
-	sceGuEnable(GU_LIGHTING); 
+	for(f = 0; f < chunk->faceCount; f++) {
+		struct WavefrontChunkFace *face = chunk->face + f; 
+		for(; m < chunk->usemtlCount && chunk->usemtl[m].face <= f; m++) chunk->usemtl[m].triangle = state->face; 
+		// the lists as they were when the serial loader reached this line.
+		state->positionCount = chunk->positionBase + face->positionCount; 
+		state->textureCount = chunk->textureBase + face->textureCount; 
+		state->normalCount = chunk->normalBase + face->normalCount; 
+		for(i = 0; i < face->corners; i++) {
+			int *corner = chunk->corner + (face->first + i) * 3; 
+			v[i] = resolveWavefrontIndex(corner[0], state->positionCount); 
+			t[i] = resolveWavefrontIndex(corner[1], state->textureCount); 
+			n[i] = resolveWavefrontIndex(corner[2], state->normalCount); 
+		}
+		fillWavefrontPolygon(&chunk->part, state, v, t, n, face->corners); 
+	}
+	for(; m < chunk->usemtlCount; m++) chunk->usemtl[m].triangle = state->face; 
+}
 
-	for(g = 0; g < mod->groupCount; g++) {
-		if(transparent == 0 && mod->group[g].transparent) continue; 
-		if(transparent == 1 && !mod->group[g].transparent) continue; 
-		if(mod->group[g].image) {
-			Image *source = mod->group[g].image; 
-			sceGuTexMode(GU_PSM_8888,  0,  0,  source->isSwizzled); 
-			sceGuTexImage(0,  source->textureWidth,  source->textureHeight,  source->textureWidth,  source->data); 
+struct WavefrontMerge {
+	struct WavefrontChunk *chunk; 
+	struct WavefrontMesh *mod; 
+	int *vertBase; 
+}; 
+
+static void copyWavefrontChunk(void *arg, int index)
+{
+	struct WavefrontMerge *merge = (struct WavefrontMerge *)arg; 
+	struct WavefrontChunk *chunk = merge->chunk + index; 
+	if(chunk->partState.face) memcpy(merge->mod->vert + merge->vertBase[index], chunk->part.vert, sizeof(struct Vertex3DTNP) * chunk->partState.face * 3); 
+}
+
+// Split the file at line boundaries and parse the pieces on the job threads.  Indices and material
+// groups are fixed up afterwards,  so the model comes out exactly as the serial parser would make it.
+// Returns 0 if the file is too small to be worth it.
+int parseWavefrontParallel(const char *data, size_t size, struct WavefrontMesh *mod, struct WavefrontState *state)
+{
+	int threads = wavefrontLoadThreads > 0 ? wavefrontLoadThreads : jobThreads() + 1; 
+	if(threads > (int)(size / WAVEFRONT_MIN_CHUNK)) threads = size / WAVEFRONT_MIN_CHUNK; 
+	if(threads < 2) return 0; 
+
+	struct WavefrontChunk *chunk = (struct WavefrontChunk *)arenaCalloc(state->arena, sizeof(struct WavefrontChunk) * threads); 
+	const char *start = data, *end = data + size; 
+	int i, m; 
+	for(i = 0; i < threads; i++) {
+		const char *split = end; 
+		if(i < threads - 1) {
+			split = data + size / threads * (i + 1); 
+			if(split < start) split = start; 
+			const char *eol = (const char *)memchr(split, '\n', end - split); 
+			split = eol ? eol + 1 : end; 
 		}
-		j = mod->group[g].first; 
-		jCount = mod->group[g].last; 
-		if(j >= jCount) printf("wavefrontmodel %s: skipping group %d of %d,  vert %d-%d\n", mod->name, g, mod->groupCount, j, jCount); 
-		while(j < jCount) {
-			int count = 30720; 
-			if(j + count > jCount) count = jCount - j; 
-			if(count <= 0) { printf("lost my place.\n");  continue;  }
-			if(mod->vert) sceGumDrawArray(GU_TRIANGLES, GU_VERTEX_32BITF|GU_NORMAL_32BITF|GU_TEXTURE_32BITF|GU_TRANSFORM_3D, count, 0, mod->vert + j); 
-			j = j + count; 
+		chunk[i].start = start; 
+		chunk[i].end = split; 
+		chunk[i].arena.name = "chunk"; 
+		start = split; 
+	}
+	runParallel(parseWavefrontChunk, chunk, threads); 
+
+	// join the position,  texture and normal lists.
+	for(i = 0; i < threads; i++) {
+		chunk[i].positionBase = state->positionCount; 
+		chunk[i].textureBase = state->textureCount; 
+		chunk[i].normalBase = state->normalCount; 
+		state->positionCount += chunk[i].state.positionCount; 
+		state->textureCount += chunk[i].state.textureCount; 
+		state->normalCount += chunk[i].state.normalCount; 
+	}
+	state->positionMax = state->positionCount; 
+	state->position = (struct Vertex3DP *)arenaAlloc(state->arena, sizeof(struct Vertex3DP) * (state->positionCount + 1)); 
+	state->textureMax = state->textureCount; 
+	state->texture = (struct Vertex3DT *)arenaAlloc(state->arena, sizeof(struct Vertex3DT) * (state->textureCount + 1)); 
+	state->normalMax = state->normalCount; 
+	state->normal = (struct Vertex3DP *)arenaAlloc(state->arena, sizeof(struct Vertex3DP) * (state->normalCount + 1)); 
+	for(i = 0; i < threads; i++) {
+		struct WavefrontState *part = &chunk[i].state; 
+		memcpy(state->position + chunk[i].positionBase, part->position, sizeof(struct Vertex3DP) * part->positionCount); 
+		memcpy(state->texture + chunk[i].textureBase, part->texture, sizeof(struct Vertex3DT) * part->textureCount); 
+		memcpy(state->normal + chunk[i].normalBase, part->normal, sizeof(struct Vertex3DP) * part->normalCount); 
+		chunk[i].partState.position = state->position; 
+		chunk[i].partState.texture = state->texture; 
+		chunk[i].partState.normal = state->normal; 
+	}
+	runParallel(resolveWavefrontChunk, chunk, threads); 
+
+	// material groups,  in file order.  Faces before the first usemtl get a default group like before.
+	int *vertBase = (int *)arenaAlloc(state->arena, sizeof(int) * threads); 
+	int faces = 0; 
+	for(i = 0; i < threads; i++) {
+		vertBase[i] = faces * 3; 
+		for(m = 0; m < chunk[i].usemtlCount; m++) {
+			state->face = faces + chunk[i].usemtl[m].triangle; 
+			if(mod->groupCount == 0 && state->face > 0) {
+				state->face = 0; 
+				addWavefrontGroup(mod, state, 0); 
+				state->face = faces + chunk[i].usemtl[m].triangle; 
+			}
+			addWavefrontGroup(mod, state, chunk[i].usemtl[m].name); 
+		}
+		if(chunk[i].partState.face) {
+			struct WavefrontMesh *part = &chunk[i].part; 
+			if(faces == 0) {
+				memcpy(mod->min, part->min, sizeof(mod->min)); 
+				memcpy(mod->max, part->max, sizeof(mod->max)); 
+			}
+			int k; 
+			for(k = 0; k < 3; k++) {
+				if(mod->min[k] > part->min[k]) mod->min[k] = part->min[k]; 
+				if(mod->max[k] < part->max[k]) mod->max[k] = part->max[k]; 
+			}
 		}
+		faces += chunk[i].partState.face; 
+	}
+	state->face = faces; 
+	if(mod->groupCount == 0 && faces > 0) {
+		state->face = 0; 
+		addWavefrontGroup(mod, state, 0); 
+		state->face = faces; 
+	}
+	for(i = 0; i < mod->groupCount; i++) {
+		mod->group[i].last = i + 1 < mod->groupCount ? mod->group[i + 1].first : faces * 3; 
 	}
-	sceGuFrontFace(GU_CW); 
-	sceGumPopMatrix(); 
-#else
-	//printf("Rendering item %d\n", i); 
-	glMatrixMode(GL_MODELVIEW); 
-	glPushMatrix(); 
-	glMultMatrixf((float *)mod->matrix); 
-	int j = 0; 
-	int g; 
-	int jCount; 
-	//printf("item image: %08x\n", (int)item[i].image); 
-	glEnable(GL_TEXTURE_2D); 
-	glFrontFace(GL_CCW); 
-	glColor3f(1, 1, 1); 
 
-	glEnable(GL_LIGHTING); 
-    glBlendFunc(GL_SRC_ALPHA,  GL_ONE_MINUS_SRC_ALPHA); 
-    glEnable(GL_BLEND); 
-    glAlphaFunc(GL_GREATER, 0); 
-    glEnable(GL_ALPHA_TEST); 
-    
-	for(g = 0; g < mod->groupCount; g++) {
-		if(transparent == 0 && mod->group[g].transparent) continue; 
-		if(transparent == 1 && !mod->group[g].transparent) continue; 
-		if(mod->group[g].image) {
-			Image *source = mod->group[g].image; 
-			if(source->texid == 0) uploadImage(source); 
-			glBindTexture(GL_TEXTURE_2D, source->texid); 
-		}
-		j = mod->group[g].first; 
-		jCount = mod->group[g].last; 
-		if(j >= jCount) printf("wavefrontmodel %s: skipping group %d of %d,  vert %d-%d\n", mod->name, g, mod->groupCount, j, jCount); 
-		glBegin(GL_TRIANGLES); 
-		for(j = mod->group[g].first; j < jCount; j++) {
-			if(mod->vert) {
-                struct Vertex3DTNP *v = mod->vert + j; 
-                glTexCoord2f(v->u, v->v); 
-                glNormal3f(v->nx, v->ny, v->nz); 
-                glVertex3f(v->x, v->y, v->z); 
-            }
-		}
-		glEnd(); 
+	state->vertMax = faces * 3; 
+	mod->vert = (struct Vertex3DTNP *)malloc(sizeof(struct Vertex3DTNP) * (faces * 3 + 1)); 
+	struct WavefrontMerge merge = { chunk, mod, vertBase }; 
+	runParallel(copyWavefrontChunk, &merge, threads); 
+
+	for(i = 0; i < threads; i++) {
+		free(chunk[i].part.vert); 
+		free(chunk[i].part.group); 
+		freeArena(&chunk[i].arena); 
 	}
-    glDisable(GL_ALPHA_TEST); 
-	glFrontFace(GL_CW); 
-	glPopMatrix(); 
-#endif
+	return 1; 
 }
-void drawWavefront(struct WavefrontModel *mod)
+
+// Every corner form,  "v",  "v/t",  "v//n" and "v/t/n",  with relative indices and one face out of
+// range,  through the serial parser and then repeated enough to be split between threads.  Returns
+// how many checks failed.
+static int checkWavefrontParse(const char *what, const char *text, size_t size, int parallel, int repeats)
 {
-	drawWavefrontPartial(mod, 3); 
+	// corners expected for the 5 good faces: position,  u,  v,  normal z
+	static const float expect[15][4] = {
+		{ 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 2, 0, 0, 1 }, 	// f 1//1 2//1 3//1
+		{ 1, 0, 0, 1 }, { 3, 0, 0, 1 }, { 2, 0, 0, 1 }, 	// f 2 4 3,  face normal
+		{ 0, 0, 1, 1 }, { 1, 1, 0, 1 }, { 3, 0, 1, 1 }, 	// f 1/1 2/2 4/1,  face normal
+		{ 0, 0, 1, 1 }, { 1, 1, 0, 1 }, { 2, 0, 1, 1 }, 	// f 1/1/1 2/2/1 3/1/1
+		{ 3, 1, 0, 1 }, { 2, 0, 1, 1 }, { 1, 0, 0, 1 }, 	// f -1/-1 -2/-2/-2 -3,  face normal at the ends
+	}; 
+	static const float position[4][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 } }; 
+	struct WavefrontMesh mod; 
+	struct WavefrontState state; 
+	struct Arena arena; 
+	int i, failed = 0, oldThreads = wavefrontLoadThreads; 
+
+	memset(&mod, 0, sizeof(mod)); 
+	memset(&state, 0, sizeof(state)); 
+	initArena(&arena, "load", 0); 
+	state.arena = &arena; 
+	wavefrontLoadThreads = 2; 
+	if(!parallel || !parseWavefrontParallel(text, size, &mod, &state)) {
+		if(parallel) failed++; 
+		parseWavefrontLine(parseWavefrontBuffer(text, text + size, &mod, &state), text + size, &mod, &state); 
+	}
+	wavefrontLoadThreads = oldThreads; 
+	if(state.face != 5 * repeats) failed++; 
+	for(i = 0; i < state.face * 3 && i < 15 * repeats; i++) {
+		const struct Vertex3DTNP *vert = mod.vert + i; 
+		const float *e = expect[i % 15], *p = position[(int)e[0]]; 
+		if(vert->x != p[0] || vert->y != p[1] || vert->z != p[2] || vert->u != e[1] || vert->v != e[2] || vert->nx != 0 || vert->ny != 0 || vert->nz != e[3]) {
+			if(failed < 4) printf("*** %s corner %d: %g %g %g uv %g %g normal %g %g %g\n", what, i, vert->x, vert->y, vert->z, vert->u, vert->v, vert->nx, vert->ny, vert->nz); 
+			failed++; 
+		}
+	}
+	printf("%s: %d faces of %d,  %s\n", what, state.face, 5 * repeats, failed ? "failed" : "ok"); 
+	free(mod.vert); 
+	free(mod.group); 
+	freeArena(&arena); 
+	return failed; 
 }
 
-void setWavefrontPos(struct WavefrontModel *model, float x, float y, float z)
+int checkWavefrontFaces()
 {
-	if(model == 0) return; 
-	model->matrix[12] = x; 
-	model->matrix[13] = y; 
-	model->matrix[14] = z; 
-	model->matrix[0] = 1;  //6; 
-	model->matrix[5] = 1;  //6; 
-	model->matrix[10] = 1;  //6; 
+	static const char *vertices = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nvt 0 0\nvt 1 1\nvn 0 0 1\nvn 0 0 -1\n"; 
+	static const char *faces = "f 1//1 2//1 3//1\nf 2 4 3\nf 1/1 2/2 4/1\nf 1/1/1 2/2/1 3/1/1\nf -1/-1 -2/-2/-2 -3\n"; 
+	int repeats = 2 * WAVEFRONT_MIN_CHUNK / (int)strlen(faces) + 1, i, failed = 0; 
+	size_t size = strlen(vertices) + strlen(faces) * repeats + 32; 
+	char *text = (char *)malloc(size); 
+	char *s = text; 
+
+	s += sprintf(s, "%s%sf 1/3 2 3\n", vertices, faces); 	// texture 3 of 2 is dropped
+	failed += checkWavefrontParse("serial", text, s - text, 0, 1); 
+	s = text + sprintf(text, "%s", vertices); 
+	for(i = 0; i < repeats; i++) s += sprintf(s, "%s", faces); 
+	failed += checkWavefrontParse("parallel", text, s - text, 1, repeats); 
+	free(text); 
+	return failed; 
 }
 
-float *getWavefrontMin(struct WavefrontModel *model)
+// Draw order: solid groups before transparent ones,  lit before unlit,  then by texture.  Untextured groups first,  and
+// the file order breaks ties so that loading is repeatable.
+static int compareWavefrontGroups(const struct MaterialGroup *a, int aIndex, const struct MaterialGroup *b, int bIndex)
 {
-	if(!model) return 0; 
-	return model->min; 
+	if(a->transparent != b->transparent) return a->transparent - b->transparent; 
+	if(a->unlit != b->unlit) return a->unlit - b->unlit; 
+	if(a->image != b->image) {
+		if(!a->image || !b->image) return a->image ? 1 : -1; 
+		int order = strcmp(a->image->filename, b->image->filename); 
+		if(order) return order; 
+		return a->image < b->image ? -1 : 1; 
+	}
+	return aIndex - bIndex; 
 }
 
-float *getWavefrontMax(struct WavefrontModel *model)
+#define WAVEFRONT_ATLAS_SIZE 2048 	// biggest atlas,  which every 2.1 card can take
+#define WAVEFRONT_ATLAS_PAD 2 	// texels of wrapped border around each packed texture against filtering bleed
+#define WAVEFRONT_ATLAS_TILES 16 	// most repeats of a tiling texture worth baking out
+
+struct AtlasEntry {
+	Image *image; 
+	float uvMin[2], uvMax[2]; 	// over every corner that uses it
+	int tiles[2]; 	// repeats baked out to cover that range
+	int w, h; 	// packed size,  border included
+	int atlas, x, y; 	// atlas -1 if it stays a texture of its own
+}; 
+
+static int positiveMod(int a, int b)
+{
+	int r = a % b; 
+	return r < 0 ? r + b : r; 
+}
+
+// Pack the model's textures into one or a few atlases and move the uvs to match.  Atlas uvs can't
+// wrap,  so a tiling texture is baked out as many times as its uvs run over,  starting from the whole
+// tile below the lowest one.  Big or many times repeated ones stay separate.  Runs on the corners,
+// before merging,  which then folds the groups sharing an atlas together.
+static void atlasWavefront(struct WavefrontMesh *mod, struct Arena *arena)
+{
+#ifndef _PSP
+	struct AtlasEntry *entry = (struct AtlasEntry *)arenaCalloc(arena, sizeof(struct AtlasEntry) * (mod->groupCount + 1)); 
+	int entryCount = 0, g, i, j, k; 
+
+	for(g = 0; g < mod->groupCount; g++) {
+		Image *image = mod->group[g].image; 
+		if(!image || !image->data) continue; 
+		for(i = 0; i < entryCount && entry[i].image != image; i++); 
+		if(i == entryCount) {
+			entry[entryCount].image = image; 
+			entry[entryCount].uvMin[0] = entry[entryCount].uvMin[1] = 1e30f; 
+			entry[entryCount].uvMax[0] = entry[entryCount].uvMax[1] = -1e30f; 
+			entryCount++; 
+		}
+		for(j = mod->group[g].first; j < mod->group[g].last; j++) {
+			const float uv[2] = { mod->vert[j].u, mod->vert[j].v }; 
+			for(k = 0; k < 2; k++) {
+				if(entry[i].uvMin[k] > uv[k]) entry[i].uvMin[k] = uv[k]; 
+				if(entry[i].uvMax[k] < uv[k]) entry[i].uvMax[k] = uv[k]; 
+			}
+		}
+	}
+	int separate = 0; 
+	for(i = 0; i < entryCount; i++) {
+		struct AtlasEntry *e = entry + i; 
+		for(k = 0; k < 2; k++) {
+			if(e->uvMin[k] > e->uvMax[k]) e->uvMin[k] = e->uvMax[k] = 0; 
+			e->uvMin[k] = floorf(e->uvMin[k]); 
+			e->tiles[k] = (int)ceilf(e->uvMax[k]) - (int)e->uvMin[k]; 
+			if(e->tiles[k] < 1) e->tiles[k] = 1; 
+		}
+		e->w = e->tiles[0] * e->image->textureWidth + WAVEFRONT_ATLAS_PAD * 2; 
+		e->h = e->tiles[1] * e->image->textureHeight + WAVEFRONT_ATLAS_PAD * 2; 
+		e->atlas = -1; 
+		if(e->w > WAVEFRONT_ATLAS_SIZE || e->h > WAVEFRONT_ATLAS_SIZE || e->tiles[0] * e->tiles[1] > WAVEFRONT_ATLAS_TILES) separate++; 
+		else e->atlas = 0; 
+	}
+	// tallest first,  then shelves left to right,  starting a new atlas when one fills up.
+	for(i = 1; i < entryCount; i++) {
+		struct AtlasEntry e = entry[i]; 
+		for(j = i; j > 0 && entry[j - 1].h < e.h; j--) entry[j] = entry[j - 1]; 
+		entry[j] = e; 
+	}
+	int atlasCount = 0, x = 0, shelfY = 0, shelfH = 0; 
+	int atlasW[16], atlasH[16], atlasEntries[16]; 
+	for(i = 0; i < entryCount; i++) {
+		struct AtlasEntry *e = entry + i; 
+		if(e->atlas < 0) continue; 
+		if(atlasCount > 0 && x + e->w > WAVEFRONT_ATLAS_SIZE) {
+			shelfY += shelfH; 
+			x = shelfH = 0; 
+		}
+		if(atlasCount == 0 || shelfY + e->h > WAVEFRONT_ATLAS_SIZE) {
+			if(atlasCount == 16) {
+				e->atlas = -1; 
+				separate++; 
+				continue; 
+			}
+			atlasW[atlasCount] = atlasH[atlasCount] = atlasEntries[atlasCount] = 0; 
+			atlasCount++; 
+			x = shelfY = shelfH = 0; 
+		}
+		e->atlas = atlasCount - 1; 
+		e->x = x; 
+		e->y = shelfY; 
+		x += e->w; 
+		if(shelfH < e->h) shelfH = e->h; 
+		if(atlasW[e->atlas] < x) atlasW[e->atlas] = x; 
+		if(atlasH[e->atlas] < shelfY + e->h) atlasH[e->atlas] = shelfY + e->h; 
+		atlasEntries[e->atlas]++; 
+	}
+
+	// bake them,  power of two sized.
+	Image *atlas[16]; 
+	for(k = 0; k < atlasCount; k++) {
+		atlas[k] = 0; 
+		if(atlasEntries[k] < 2) continue; 	// a texture on its own gains nothing
+		Image *image = (Image *)calloc(sizeof(Image), 1); 
+		for(image->textureWidth = 1; image->textureWidth < atlasW[k]; image->textureWidth <<= 1); 
+		for(image->textureHeight = 1; image->textureHeight < atlasH[k]; image->textureHeight <<= 1); 
+		image->imageWidth = image->textureWidth; 
+		image->imageHeight = image->textureHeight; 
+		image->data = (Color *)calloc(sizeof(Color), image->textureWidth * image->textureHeight); 
+		snprintf(image->filename, sizeof(image->filename), "%s atlas %d", mod->name, k); 
+		atlas[k] = image; 
+	}
+	int packed = 0; 
+	for(i = 0; i < entryCount; i++) {
+		struct AtlasEntry *e = entry + i; 
+		if(e->atlas < 0 || !atlas[e->atlas]) continue; 
+		const Image *from = e->image; 
+		Image *to = atlas[e->atlas]; 
+		for(j = 0; j < e->h; j++) {
+			const Color *row = from->data + positiveMod(j - WAVEFRONT_ATLAS_PAD, from->textureHeight) * from->textureWidth; 
+			Color *out = to->data + (e->y + j) * to->textureWidth + e->x; 
+			for(k = 0; k < e->w; k++) out[k] = row[positiveMod(k - WAVEFRONT_ATLAS_PAD, from->textureWidth)]; 
+		}
+		// uv 0 of the first tile lands just inside the border.
+		float scaleU = (float)from->textureWidth / to->textureWidth, scaleV = (float)from->textureHeight / to->textureHeight; 
+		float offsetU = (float)(e->x + WAVEFRONT_ATLAS_PAD) / to->textureWidth, offsetV = (float)(e->y + WAVEFRONT_ATLAS_PAD) / to->textureHeight; 
+		for(g = 0; g < mod->groupCount; g++) {
+			if(mod->group[g].image != from) continue; 
+			for(j = mod->group[g].first; j < mod->group[g].last; j++) {
+				mod->vert[j].u = offsetU + (mod->vert[j].u - e->uvMin[0]) * scaleU; 
+				mod->vert[j].v = offsetV + (mod->vert[j].v - e->uvMin[1]) * scaleV; 
+			}
+			mod->group[g].image = to; 
+		}
+		packed++; 
+	}
+	for(k = 0; k < atlasCount; k++) {
+		if(atlas[k]) printf("atlas %d for %s: %dx%d\n", k, mod->name, atlas[k]->textureWidth, atlas[k]->textureHeight); 
+	}
+	printf("packed %d of %d textures into atlases,  %d too big or repeated too often\n", packed, entryCount, separate); 
+#endif
+}
+
+// Draws and texture binds drawWavefront would make for the groups as they stand.
+static void countWavefrontDraws(struct WavefrontMesh *mod, int *draws, int *binds)
+{
+	Image *bound = 0; 
+	int g; 
+	*draws = *binds = 0; 
+	for(g = 0; g < mod->groupCount; g++) {
+		if(mod->group[g].first >= mod->group[g].last) continue; 
+		(*draws)++; 
+		if(mod->group[g].image && mod->group[g].image != bound) (*binds)++; 
+		if(mod->group[g].image) bound = mod->group[g].image; 
+	}
+}
+
+// Every usemtl starts a group,  even for a material seen before,  so exports come out as lots of
+// little groups rebinding the same texture.  Gather the triangles of each texture,  transparency and
+// lighting into one range,  in draw order.  Works on the corners,  so it runs before indexing.
+static void mergeWavefrontGroups(struct WavefrontMesh *mod, struct Arena *arena)
+{
+	int g, i, count = 0, drawsBefore, bindsBefore, draws, binds; 
+	int *order = (int *)arenaAlloc(arena, sizeof(int) * (mod->groupCount + 1)); 
+
+	countWavefrontDraws(mod, &drawsBefore, &bindsBefore); 
+	// insertion sort,  there are only ever a few hundred groups.
+	for(g = 0; g < mod->groupCount; g++) {
+		for(i = g; i > 0 && compareWavefrontGroups(mod->group + order[i - 1], order[i - 1], mod->group + g, g) > 0; i--) order[i] = order[i - 1]; 
+		order[i] = g; 
+	}
+	struct Vertex3DTNP *vert = (struct Vertex3DTNP *)malloc(sizeof(struct Vertex3DTNP) * (mod->vertCount + 1)); 
+	struct MaterialGroup *group = (struct MaterialGroup *)calloc(sizeof(struct MaterialGroup), mod->groupCount + 1); 
+	int vertCount = 0; 
+	for(i = 0; i < mod->groupCount; i++) {
+		const struct MaterialGroup *from = mod->group + order[i]; 
+		if(from->first >= from->last) continue; 
+		if(count == 0 || group[count - 1].image != from->image || group[count - 1].transparent != from->transparent || group[count - 1].unlit != from->unlit) {
+			group[count] = *from; 
+			group[count].first = group[count].last = vertCount; 
+			count++; 
+		}
+		memcpy(vert + vertCount, mod->vert + from->first, sizeof(struct Vertex3DTNP) * (from->last - from->first)); 
+		vertCount += from->last - from->first; 
+		group[count - 1].last = vertCount; 
+	}
+	free(mod->vert); 
+	free(mod->group); 
+	int groupsBefore = mod->groupCount; 
+	mod->vert = vert; 
+	mod->vertCount = vertCount; 
+	mod->group = group; 
+	mod->groupCount = count; 
+	countWavefrontDraws(mod, &draws, &binds); 
+	printf("merged %d groups into %d: %d draws and %d texture binds before,  %d and %d after\n", groupsBefore, count, drawsBefore, bindsBefore, draws, binds); 
+}
+
+// Reorder each group's triangles for the vertex cache,  then the solid ones for overdraw.  Transparent
+// groups keep their cache order,  since sorting them would change how they blend.
+static void optimizeWavefrontGroups(struct WavefrontMesh *mod, unsigned int *index, int indexCount, struct Vertex3DTNP *vert, int vertCount)
+{
+	float before = meshCacheMissRatio(index, indexCount, vertCount); 
+	int g; 
+	for(g = 0; g < mod->groupCount; g++) {
+		struct MaterialGroup *group = mod->group + g; 
+		if(group->last - group->first < 6) continue; 
+		optimizeVertexCache(index + group->first, group->last - group->first, vertCount); 
+		if(!group->transparent) optimizeOverdraw(index + group->first, group->last - group->first, &vert->x, sizeof(struct Vertex3DTNP), vertCount); 
+	}
+	printf("vertex cache: ACMR %.3f before,  %.3f after\n", before, meshCacheMissRatio(index, indexCount, vertCount)); 
+}
+
+// Vertices that can't move without tearing something open: those sharing a position with another
+// vertex (uv or normal seams) and those used by more than one group.
+static unsigned char *lockWavefrontSeams(struct WavefrontMesh *mod, unsigned int *index, struct Vertex3DTNP *vert, int vertCount, struct Arena *arena)
+{
+	unsigned char *lock = (unsigned char *)arenaCalloc(arena, vertCount + 1); 
+	int *owner = (int *)arenaAlloc(arena, sizeof(int) * (vertCount + 1)); 
+	int tableSize = 16, i, g; 
+	while(tableSize < vertCount * 2) tableSize *= 2; 
+	int *table = (int *)arenaAlloc(arena, sizeof(int) * tableSize); 
+	memset(table, -1, sizeof(int) * tableSize); 
+	for(i = 0; i < vertCount; i++) {
+		const float *p = &vert[i].x; 
+		unsigned int slot = (unsigned int)hashBytes(p, sizeof(float) * 3) & (tableSize - 1); 
+		while(table[slot] >= 0 && memcmp(&vert[table[slot]].x, p, sizeof(float) * 3) != 0) slot = (slot + 1) & (tableSize - 1); 
+		if(table[slot] < 0) table[slot] = i; 
+		else lock[i] = lock[table[slot]] = 1; 
+	}
+	memset(owner, -1, sizeof(int) * vertCount); 
+	for(g = 0; g < mod->groupCount; g++) {
+		for(i = mod->group[g].first; i < mod->group[g].last; i++) {
+			unsigned int v = index[i]; 
+			if(owner[v] >= 0 && owner[v] != g) lock[v] = 1; 
+			owner[v] = g; 
+		}
+	}
+	return lock; 
+}
+
+// Each level aims for half the triangles of the one before,  group by group,  and is appended to the
+// index.  Stops early once simplifying stops paying off.
+static void buildWavefrontLods(struct WavefrontMesh *mod, unsigned int **indexOut, int *countOut, struct Vertex3DTNP *vert, int vertCount, struct Arena *arena)
+{
+	unsigned int *index = *indexOut; 
+	int count = *countOut, previous = count, level, g; 
+	float error = 0; 
+	unsigned char *lock = lockWavefrontSeams(mod, index, vert, vertCount, arena); 
+
+	for(level = 0; level < WAVEFRONT_MAX_LOD; level++) {
+		int start = count; 
+		float levelError = 0; 
+		index = (unsigned int *)realloc(index, sizeof(unsigned int) * (count + previous + 1)); 
+		for(g = 0; g < mod->groupCount; g++) {
+			struct MaterialGroup *group = mod->group + g; 
+			int first = level ? group->lodFirst[level - 1] : group->first; 
+			int last = level ? group->lodLast[level - 1] : group->last; 
+			float groupError = 0; 
+			int made = simplifyMesh(index + count, index + first, last - first, &vert->x, sizeof(struct Vertex3DTNP), vertCount, lock, 
+				(last - first) / 6 * 3, &groupError); 
+			if(!(mod->flags & WAVEFRONT_NO_OPTIMIZE)) optimizeVertexCache(index + count, made, vertCount); 
+			group->lodFirst[level] = count; 
+			group->lodLast[level] = count + made; 
+			count += made; 
+			if(levelError < groupError) levelError = groupError; 
+		}
+		if(count - start > previous * 9 / 10) {
+			count = start; 	// hardly any smaller,  so not worth keeping
+			break; 
+		}
+		error += levelError; 	// each level is measured against the one before
+		mod->lodError[level] = error; 
+		printf("lod %d: %d triangles,  error %g\n", level + 1, (count - start) / 3, error); 
+		previous = count - start; 
+	}
+	mod->lodCount = level; 
+	*indexOut = index; 
+	*countOut = count; 
+}
+
+// Merge identical corners so each distinct vertex is stored once,  and draw through an index instead.
+// The groups keep their ranges,  which now count indices rather than vertices.
+void indexWavefront(struct WavefrontMesh *mod, struct Arena *arena)
+{
+	int count = mod->vertCount; 
+	int tableSize = 16, i; 
+	while(tableSize < count * 2) tableSize *= 2; 
+	struct ArenaMark mark = arenaMark(arena); 
+	int *table = (int *)arenaAlloc(arena, sizeof(int) * tableSize); 
+	unsigned int *index = (unsigned int *)malloc(sizeof(unsigned int) * (count + 1)); 
+	struct Vertex3DTNP *vert = (struct Vertex3DTNP *)malloc(sizeof(struct Vertex3DTNP) * (count + 1)); 
+	int unique = 0; 
+	memset(table, -1, sizeof(int) * tableSize); 
+	for(i = 0; i < count; i++) {
+		const struct Vertex3DTNP *v = mod->vert + i; 
+		unsigned int slot = (unsigned int)hashBytes(v, sizeof(*v)) & (tableSize - 1); 
+		while(table[slot] >= 0 && memcmp(vert + table[slot], v, sizeof(*v)) != 0) slot = (slot + 1) & (tableSize - 1); 
+		if(table[slot] < 0) {
+			table[slot] = unique; 
+			vert[unique++] = *v; 
+		}
+		index[i] = table[slot]; 
+	}
+	arenaRewind(arena, mark); 	// the lods can have the table's space
+#ifdef _PSP
+	if(unique > 65536) {
+		// the GE only takes 8 and 16 bit indices.
+		free(index); 
+		free(vert); 
+		return; 
+	}
+#endif
+	if(!(mod->flags & WAVEFRONT_NO_OPTIMIZE)) optimizeWavefrontGroups(mod, index, count, vert, unique); 
+	if(mod->flags & WAVEFRONT_LODS) buildWavefrontLods(mod, &index, &count, vert, unique, arena); 
+	printf("indexed %d verts into %d (%d%%)\n", mod->vertCount, unique, mod->vertCount ? unique * 100 / mod->vertCount : 100); 
+	free(mod->vert); 
+	mod->vert = (struct Vertex3DTNP *)realloc(vert, sizeof(struct Vertex3DTNP) * (unique + 1)); 
+	mod->vertCount = unique; 
+	mod->indexCount = count; 
+	if(unique <= 65536) {
+		unsigned short *index16 = (unsigned short *)index; 
+		for(i = 0; i < count; i++) index16[i] = (unsigned short)index[i]; 	// in place,  front to back
+		mod->index = realloc(index, sizeof(unsigned short) * (count + 1)); 
+		mod->indexSize = 2; 
+	} else {
+		mod->index = index; 
+		mod->indexSize = 4; 
+	}
+}
+
+// Ambient occlusion baked into a grey per vertex: the share of a cosine weighted hemisphere of rays
+// around the normal that get out without hitting the model,  which the fixed function lighting then
+// uses as the material colour.  Spread over the job threads in batches of vertices.
+#define WAVEFRONT_AO_RAYS 32 	// samples per vertex
+#define WAVEFRONT_AO_RANGE 0.1f 	// furthest an occluder counts,  as a fraction of the model's diagonal
+#define WAVEFRONT_AO_BATCH 256 	// vertices per job
+
+struct WavefrontOcclusion {
+	struct WavefrontMesh *mod; 
+	const struct Bvh *bvh; 
+	float range; 
+	float offset; 	// rays start this far out,  clear of their own triangles
+	float *inward; 	// per vertex,  unit direction towards the middle of the triangles using it
+	float direction[WAVEFRONT_AO_RAYS][3]; 	// around +z
+}; 
+
+static void occludeWavefrontVerts(void *arg, int index)
+{
+	struct WavefrontOcclusion *ao = (struct WavefrontOcclusion *)arg; 
+	struct WavefrontMesh *mod = ao->mod; 
+	int first = index * WAVEFRONT_AO_BATCH; 
+	int last = first + WAVEFRONT_AO_BATCH < mod->vertCount ? first + WAVEFRONT_AO_BATCH : mod->vertCount; 
+	int i, j, k; 
+
+	for(i = first; i < last; i++) {
+		const struct Vertex3DTNP *v = mod->vert + i; 
+		float n[3] = { v->nx, v->ny, v->nz }, t[3], b[3]; 
+		float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]); 
+		int open = WAVEFRONT_AO_RAYS; 
+		if(len > 0) {
+			for(k = 0; k < 3; k++) n[k] /= len; 
+			// a frame around the normal,  turned a different way at each vertex so the pattern becomes noise.
+			float angle = ((i * 2654435761u) >> 8) * (6.2831853f / 16777216); 
+			float c = cosf(angle), s = sinf(angle); 
+			float axis[3] = { fabsf(n[0]) < 0.9f ? 1.0f : 0.0f, fabsf(n[0]) < 0.9f ? 0.0f : 1.0f, 0 }; 
+			t[0] = axis[1] * n[2] - axis[2] * n[1]; 
+			t[1] = axis[2] * n[0] - axis[0] * n[2]; 
+			t[2] = axis[0] * n[1] - axis[1] * n[0]; 
+			len = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]); 
+			for(k = 0; k < 3; k++) t[k] /= len; 
+			b[0] = n[1] * t[2] - n[2] * t[1]; 
+			b[1] = n[2] * t[0] - n[0] * t[2]; 
+			b[2] = n[0] * t[1] - n[1] * t[0]; 
+			for(k = 0; k < 3; k++) {
+				float tk = t[k]; 
+				t[k] = c * tk + s * b[k]; 
+				b[k] = c * b[k] - s * tk; 
+			}
+			// off the surface and in over its own faces,  or a vertex in an inside corner sits on the other face.
+			const float *in = ao->inward + i * 3; 
+			struct BvhRay ray; 
+			ray.origin[0] = v->x + (n[0] + in[0]) * ao->offset; 
+			ray.origin[1] = v->y + (n[1] + in[1]) * ao->offset; 
+			ray.origin[2] = v->z + (n[2] + in[2]) * ao->offset; 
+			ray.maxT = ao->range; 
+			for(j = 0; j < WAVEFRONT_AO_RAYS; j++) {
+				const float *d = ao->direction[j]; 
+				for(k = 0; k < 3; k++) ray.dir[k] = t[k] * d[0] + b[k] * d[1] + n[k] * d[2]; 
+				open -= bvhRayAny(ao->bvh, &ray); 
+			}
+		}
+		// unoccluded comes out at GL's default diffuse of 0.8.
+		unsigned int grey = 204 * open / WAVEFRONT_AO_RAYS; 
+		mod->shade[i] = grey | (grey << 8) | (grey << 16) | 0xff000000u; 
+	}
+}
+
+static struct Bvh *getWavefrontBvh(struct WavefrontMesh *mod); 
+
+void bakeWavefrontOcclusion(struct WavefrontMesh *mod)
+{
+	struct WavefrontOcclusion ao; 
+	float diagonal = 0; 
+	int g, i, j, k; 
+	if(!mod->vert || mod->vertCount == 0) return; 
+	for(k = 0; k < 3; k++) diagonal += (mod->max[k] - mod->min[k]) * (mod->max[k] - mod->min[k]); 
+	diagonal = sqrtf(diagonal); 
+	ao.mod = mod; 
+	ao.bvh = getWavefrontBvh(mod); 
+	ao.range = diagonal * WAVEFRONT_AO_RANGE; 
+	ao.offset = diagonal * 1e-4f; 
+	// Hammersley points,  spread evenly over the disc and lifted onto the hemisphere.
+	for(i = 0; i < WAVEFRONT_AO_RAYS; i++) {
+		unsigned int bits = i; 
+		bits = (bits << 16) | (bits >> 16); 
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1); 
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2); 
+		bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4); 
+		bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8); 
+		float u = (i + 0.5f) / WAVEFRONT_AO_RAYS, phi = bits * (6.2831853f / 4294967296.0f); 
+		float r = sqrtf(u); 
+		ao.direction[i][0] = r * cosf(phi); 
+		ao.direction[i][1] = r * sinf(phi); 
+		ao.direction[i][2] = sqrtf(1 - u); 
+	}
+	ao.inward = (float *)calloc(sizeof(float) * 3, mod->vertCount); 
+	for(g = 0; g < mod->groupCount; g++) {
+		for(i = mod->group[g].first; i + 2 < mod->group[g].last; i += 3) {
+			int corner[3]; 
+			float middle[3] = { 0, 0, 0 }; 
+			for(j = 0; j < 3; j++) {
+				if(!mod->index) corner[j] = i + j; 
+				else if(mod->indexSize == 2) corner[j] = ((unsigned short *)mod->index)[i + j]; 
+				else corner[j] = ((unsigned int *)mod->index)[i + j]; 
+				for(k = 0; k < 3; k++) middle[k] += (&mod->vert[corner[j]].x)[k] / 3; 
+			}
+			for(j = 0; j < 3; j++) {
+				for(k = 0; k < 3; k++) ao.inward[corner[j] * 3 + k] += middle[k] - (&mod->vert[corner[j]].x)[k]; 
+			}
+		}
+	}
+	for(i = 0; i < mod->vertCount; i++) {
+		float *in = ao.inward + i * 3; 
+		float len = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]); 
+		for(k = 0; len > 0 && k < 3; k++) in[k] /= len; 
+	}
+	mod->shade = (Color *)malloc(sizeof(Color) * mod->vertCount); 
+	runParallel(occludeWavefrontVerts, &ao, (mod->vertCount + WAVEFRONT_AO_BATCH - 1) / WAVEFRONT_AO_BATCH); 
+	free(ao.inward); 
+	printf("baked occlusion for %s: %d verts,  %d rays each\n", mod->name, mod->vertCount, WAVEFRONT_AO_RAYS); 
+}
+
+static short quantizeShort(float value, float offset, float scale)
+{
+	float q = (value - offset) / scale; 
+	q = q < 0 ? q - 0.5f : q + 0.5f; 
+	if(q > 32767) q = 32767; 
+	if(q < -32767) q = -32767; 
+	return (short)q; 
+}
+
+static signed char quantizeByte(float value)
+{
+	float q = value * 127; 
+	q = q < 0 ? q - 0.5f : q + 0.5f; 
+	if(q > 127) q = 127; 
+	if(q < -127) q = -127; 
+	return (signed char)q; 
+}
+
+// Positions and uvs become shorts spread across their bounds,  and normals bytes.  The draw path puts
+// the bounds back with the model and texture matrices.  Positions share one scale,  from the longest
+// side,  since lighting would bend the normals under a squashing one.  Keeps the floats if anything
+// comes back further off than rounding should allow.
+void quantizeWavefront(struct WavefrontMesh *mod)
+{
+	float low[5], high[5], error[5], normalError = 0; 
+	int i, k; 
+
+	if(!mod->vert || mod->vertCount == 0) return; 
+	for(k = 0; k < 3; k++) {
+		low[k] = mod->min[k]; 
+		high[k] = mod->max[k]; 
+	}
+	low[3] = high[3] = mod->vert[0].u; 
+	low[4] = high[4] = mod->vert[0].v; 
+	for(i = 1; i < mod->vertCount; i++) {
+		const struct Vertex3DTNP *v = mod->vert + i; 
+		if(low[3] > v->u) low[3] = v->u; 
+		if(high[3] < v->u) high[3] = v->u; 
+		if(low[4] > v->v) low[4] = v->v; 
+		if(high[4] < v->v) high[4] = v->v; 
+	}
+	for(k = 0; k < 5; k++) {
+		mod->packOffset[k] = (low[k] + high[k]) / 2; 
+		mod->packScale[k] = (high[k] - low[k]) / 2 / 32767; 
+		if(!(mod->packScale[k] > 0)) mod->packScale[k] = 1.0f / 32767; 	// flat,  but keep the matrix invertible
+		error[k] = 0; 
+	}
+	for(k = 0; k < 3; k++) {
+		if(mod->packScale[k] < mod->packScale[(k + 1) % 3]) mod->packScale[k] = mod->packScale[(k + 1) % 3]; 
+		if(mod->packScale[k] < mod->packScale[(k + 2) % 3]) mod->packScale[k] = mod->packScale[(k + 2) % 3]; 
+	}
+
+	struct Vertex3DTNPfast *packed = (struct Vertex3DTNPfast *)malloc(sizeof(struct Vertex3DTNPfast) * (mod->vertCount + 1)); 
+	for(i = 0; i < mod->vertCount; i++) {
+		const struct Vertex3DTNP *v = mod->vert + i; 
+		struct Vertex3DTNPfast *p = packed + i; 
+		float in[5] = { v->x, v->y, v->z, v->u, v->v }; 
+		p->x = quantizeShort(v->x, mod->packOffset[0], mod->packScale[0]); 
+		p->y = quantizeShort(v->y, mod->packOffset[1], mod->packScale[1]); 
+		p->z = quantizeShort(v->z, mod->packOffset[2], mod->packScale[2]); 
+		p->u = quantizeShort(v->u, mod->packOffset[3], mod->packScale[3]); 
+		p->v = quantizeShort(v->v, mod->packOffset[4], mod->packScale[4]); 
+		short out[5] = { p->x, p->y, p->z, p->u, p->v }; 
+		for(k = 0; k < 5; k++) {
+			float e = fabsf(mod->packOffset[k] + out[k] * mod->packScale[k] - in[k]); 
+			if(!(e <= error[k])) error[k] = e; 
+		}
+
+		float length = sqrtf(v->nx * v->nx + v->ny * v->ny + v->nz * v->nz); 
+		p->nx = p->ny = p->nz = p->pad = 0; 
+		if(length == 0) continue; 
+		p->nx = quantizeByte(v->nx / length); 
+		p->ny = quantizeByte(v->ny / length); 
+		p->nz = quantizeByte(v->nz / length); 
+		// the angle lighting will be off by,  once GL_NORMALIZE has had its way.
+		float backLength = sqrtf((float)(p->nx * p->nx + p->ny * p->ny + p->nz * p->nz)); 
+		float dot = backLength > 0 ? (p->nx * v->nx + p->ny * v->ny + p->nz * v->nz) / (backLength * length) : -1; 
+		if(!(1 - dot <= normalError)) normalError = 1 - dot; 
+	}
+
+	int ok = normalError <= WAVEFRONT_NORMAL_ERROR; 
+	for(k = 0; k < 5; k++) {
+		// half a step from rounding,  plus float error in the check itself.
+		if(!(error[k] <= mod->packScale[k] * 0.51f + fabsf(mod->packOffset[k]) * 1e-6f)) ok = 0; 
+	}
+	printf("quantized %d verts: position error %g %g %g,  uv %g %g,  normal %.2f degrees%s\n", mod->vertCount, 
+		error[0], error[1], error[2], error[3], error[4], acosf(1 - normalError) * 180 / 3.14159265f, ok ? "" : ",  too far out,  keeping floats"); 
+	if(!ok) {
+		free(packed); 
+		return; 
+	}
+	if(!mod->cache.data) free(mod->vert); 	// a cached mesh is still mapped,  and goes with the mapping
+	mod->vert = 0; 
+	mod->packed = packed; 
+}
+
+// Compiled mesh cache: models/<name>/<name>.mesh holds the finished vertices and groups so that
+// later runs can map them straight in instead of parsing the obj again.
+#define MESH_CACHE_MAGIC 0x4853454d 	// "MESH"
+#define MESH_CACHE_VERSION 9
+
+struct MeshCacheSource {
+	long long time; 	// modification time
+	long long size; 	// -1 if the file is missing
+	unsigned long long hash; 
+}; 
+
+struct MeshCacheHeader {
+	unsigned int magic; 
+	unsigned int version; 
+	unsigned int vertexSize; 	// sizeof(struct Vertex3DTNP) when it was written
+	unsigned int fileSize; 
+	unsigned int flags; 	// the WAVEFRONT_CACHED_FLAGS it was built with
+	struct MeshCacheSource obj; 
+	struct MeshCacheSource mtl; 
+	int vertCount; 
+	int indexCount; 	// 0 if not indexed
+	int indexSize; 
+	int groupCount; 
+	int imageCount; 
+	int lodCount; 
+	float lodError[WAVEFRONT_MAX_LOD]; 
+	float min[3]; 
+	float max[3]; 
+	unsigned int vertOffset; 	// 16 byte aligned
+	unsigned int indexOffset; 
+	unsigned int groupOffset; 
+	unsigned int imageOffset; 
+	unsigned int shadeOffset; 	// 0 if the occlusion wasn't baked
+}; 
+
+struct MeshCacheGroup {
+	int first; 
+	int last; 
+	int image; 	// into the image table,  -1 for none
+	int transparent; 
+	int unlit; 
+	int lodFirst[WAVEFRONT_MAX_LOD]; 
+	int lodLast[WAVEFRONT_MAX_LOD]; 
+	float min[3]; 
+	float max[3]; 
+}; 
+
+struct MeshCacheImage {
+	char filename[256]; 
+}; 
+
+static void meshCachePaths(const char *fname, char *obj, char *mtl, char *cache)
+{
+	sprintf(obj, "models/%s/%s.obj", fname, fname); 
+	sprintf(mtl, "models/%s/%s.mtl", fname, fname); 
+	sprintf(cache, "models/%s/%s.mesh", fname, fname); 
+}
+
+// The cache is current if the source has the same time and size,  or failing that the same contents
+// (a fresh copy of the same file gets a new time).
+static int meshSourceCurrent(const char *path, const struct MeshCacheSource *source)
+{
+	long long time, size; 
+	packedFileStamp(path, &time, &size); 
+	if(size != source->size) return 0; 
+	if(time == source->time) return 1; 
+	return size < 0 || hashPackedFile(path) == source->hash; 
+}
+
+// count things of size bytes at offset,  all inside the file.
+static int meshCacheFits(const struct FileMap *map, unsigned int offset, int count, size_t size)
+{
+	if(count < 0 || offset > map->size) return 0; 
+	return (unsigned long long)count * size <= map->size - offset; 
+}
+
+static int meshCacheRange(int first, int last, int limit)
+{
+	return first >= 0 && first <= last && last <= limit; 
+}
+
+// Everything the header points at is used in place,  so a cut short or damaged file has to be caught
+// here rather than by the draws reading past the end of it.
+static int meshCacheSound(const struct FileMap *map)
+{
+	const struct MeshCacheHeader *header = (const struct MeshCacheHeader *)map->data; 
+	int i, l; 
+	if(header->indexCount && header->indexSize != 2 && header->indexSize != 4) return 0; 
+	if(header->lodCount < 0 || header->lodCount > WAVEFRONT_MAX_LOD || (header->lodCount && !header->indexCount)) return 0; 
+	if(!meshCacheFits(map, header->vertOffset, header->vertCount, sizeof(struct Vertex3DTNP))) return 0; 
+	if(header->indexCount && !meshCacheFits(map, header->indexOffset, header->indexCount, header->indexSize)) return 0; 
+	if(!meshCacheFits(map, header->groupOffset, header->groupCount, sizeof(struct MeshCacheGroup))) return 0; 
+	if(!meshCacheFits(map, header->imageOffset, header->imageCount, sizeof(struct MeshCacheImage))) return 0; 
+	if(header->shadeOffset && !meshCacheFits(map, header->shadeOffset, header->vertCount, sizeof(Color))) return 0; 
+	const char *index = map->data + header->indexOffset; 
+	for(i = 0; i < header->indexCount; i++) {
+		int v = header->indexSize == 2 ? ((const unsigned short *)index)[i] : (int)((const unsigned int *)index)[i]; 
+		if(v < 0 || v >= header->vertCount) return 0; 
+	}
+	const struct MeshCacheGroup *group = (const struct MeshCacheGroup *)(map->data + header->groupOffset); 
+	int limit = header->indexCount ? header->indexCount : header->vertCount; 
+	for(i = 0; i < header->groupCount; i++) {
+		if(!meshCacheRange(group[i].first, group[i].last, limit)) return 0; 
+		if(group[i].image < -1 || group[i].image >= header->imageCount) return 0; 
+		for(l = 0; l < header->lodCount; l++) {
+			if(!meshCacheRange(group[i].lodFirst[l], group[i].lodLast[l], header->indexCount)) return 0; 
+		}
+	}
+	const struct MeshCacheImage *imageName = (const struct MeshCacheImage *)(map->data + header->imageOffset); 
+	for(i = 0; i < header->imageCount; i++) {
+		if(!memchr(imageName[i].filename, 0, sizeof(imageName[i].filename))) return 0; 
+	}
+	return 1; 
+}
+
+int loadWavefrontCache(const char *fname, struct WavefrontMesh *mod, int flags)
+{
+	char objPath[256], mtlPath[256], path[256]; 
+	struct FileMap map; 
+	int i, j; 
+
+	meshCachePaths(fname, objPath, mtlPath, path); 
+	if(!mapPackedFile(path, &map)) return 0; 
+	const struct MeshCacheHeader *header = (const struct MeshCacheHeader *)map.data; 
+	if(map.size < sizeof(struct MeshCacheHeader) || header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION || 
+			header->vertexSize != sizeof(struct Vertex3DTNP) || header->fileSize != map.size) {
+		printf("%s is from another version,  ignoring it\n", path); 
+		unmapFile(&map); 
+		return 0; 
+	}
+	if(header->flags != (flags & WAVEFRONT_CACHED_FLAGS)) {
+		printf("%s was built with other options\n", path); 
+		unmapFile(&map); 
+		return 0; 
+	}
+	if(!meshSourceCurrent(objPath, &header->obj) || !meshSourceCurrent(mtlPath, &header->mtl)) {
+		printf("%s is stale\n", path); 
+		unmapFile(&map); 
+		return 0; 
+	}
+	if(!meshCacheSound(&map)) {
+		printf("*** %s is damaged,  rebuilding it\n", path); 
+		unmapFile(&map); 
+		return 0; 
+	}
+	const struct MeshCacheGroup *group = (const struct MeshCacheGroup *)(map.data + header->groupOffset); 
+	const struct MeshCacheImage *imageName = (const struct MeshCacheImage *)(map.data + header->imageOffset); 
+	Image **image = (Image **)calloc(sizeof(Image *), header->imageCount + 1); 
+	if(!(flags & WAVEFRONT_NO_TEXTURES)) {
+		for(i = 0; i < header->imageCount; i++) {
+			image[i] = loadMaterialImage(imageName[i].filename); 
+			// two names for the same picture,  the model only keeps one reference to each image.
+			for(j = 0; j < i; j++) {
+				if(image[i] && image[j] == image[i]) {
+					releaseAsset(image[i]); 
+					break; 
+				}
+			}
+		}
+	}
+	mod->groupCount = header->groupCount; 
+	mod->group = (struct MaterialGroup *)calloc(sizeof(struct MaterialGroup), header->groupCount + 1); 
+	for(i = 0; i < header->groupCount; i++) {
+		mod->group[i].first = group[i].first; 
+		mod->group[i].last = group[i].last; 
+		mod->group[i].image = group[i].image >= 0 ? image[group[i].image] : 0; 
+		mod->group[i].transparent = group[i].transparent; 
+		mod->group[i].unlit = group[i].unlit; 
+		memcpy(mod->group[i].lodFirst, group[i].lodFirst, sizeof(group[i].lodFirst)); 
+		memcpy(mod->group[i].lodLast, group[i].lodLast, sizeof(group[i].lodLast)); 
+		memcpy(mod->group[i].min, group[i].min, sizeof(group[i].min)); 
+		memcpy(mod->group[i].max, group[i].max, sizeof(group[i].max)); 
+	}
+	free(image); 
+	mod->vert = (struct Vertex3DTNP *)(map.data + header->vertOffset); 	// used in place
+	mod->vertCount = header->vertCount; 
+	mod->index = header->indexCount ? (void *)(map.data + header->indexOffset) : 0; 
+	mod->indexCount = header->indexCount; 
+	mod->indexSize = header->indexSize; 
+	memcpy(mod->min, header->min, sizeof(mod->min)); 
+	memcpy(mod->max, header->max, sizeof(mod->max)); 
+	mod->lodCount = header->lodCount; 
+	memcpy(mod->lodError, header->lodError, sizeof(mod->lodError)); 
+	if(header->shadeOffset) mod->shade = (Color *)(map.data + header->shadeOffset); 
+	mod->cache = map; 
+	printf("read %s: %d verts,  %d groups\n", path, mod->vertCount, mod->groupCount); 
+	return 1; 
+}
+
+void saveWavefrontCache(const char *fname, struct WavefrontMesh *mod)
+{
+	char objPath[256], mtlPath[256], path[256], temp[260]; 
+	struct MeshCacheHeader header; 
+	int i, j, k; 
+
+	meshCachePaths(fname, objPath, mtlPath, path); 
+	memset(&header, 0, sizeof(header)); 
+	header.magic = MESH_CACHE_MAGIC; 
+	header.version = MESH_CACHE_VERSION; 
+	header.vertexSize = sizeof(struct Vertex3DTNP); 
+	if(!fileStamp(objPath, &header.obj.time, &header.obj.size)) return; 	// only in a pack,  which can carry its own .mesh
+	header.obj.hash = hashFile(objPath); 
+	packedFileStamp(mtlPath, &header.mtl.time, &header.mtl.size); 
+	header.mtl.hash = hashPackedFile(mtlPath); 
+	header.vertCount = mod->vertCount; 
+	header.indexCount = mod->indexCount; 
+	header.indexSize = mod->indexSize; 
+	header.groupCount = mod->groupCount; 
+	memcpy(header.min, mod->min, sizeof(header.min)); 
+	memcpy(header.max, mod->max, sizeof(header.max)); 
+	header.flags = mod->flags & WAVEFRONT_CACHED_FLAGS; 
+	header.lodCount = mod->lodCount; 
+	memcpy(header.lodError, mod->lodError, sizeof(header.lodError)); 
+
+	// one image table entry per distinct image.
+	struct MeshCacheGroup *group = (struct MeshCacheGroup *)calloc(sizeof(struct MeshCacheGroup), mod->groupCount + 1); 
+	struct MeshCacheImage *image = (struct MeshCacheImage *)calloc(sizeof(struct MeshCacheImage), mod->groupCount + 1); 
+	Image **seen = (Image **)calloc(sizeof(Image *), mod->groupCount + 1); 
+	for(i = 0; i < mod->groupCount; i++) {
+		group[i].first = mod->group[i].first; 
+		group[i].last = mod->group[i].last; 
+		group[i].transparent = mod->group[i].transparent; 
+		group[i].unlit = mod->group[i].unlit; 
+		memcpy(group[i].lodFirst, mod->group[i].lodFirst, sizeof(group[i].lodFirst)); 
+		memcpy(group[i].lodLast, mod->group[i].lodLast, sizeof(group[i].lodLast)); 
+		memcpy(group[i].min, mod->group[i].min, sizeof(group[i].min)); 
+		memcpy(group[i].max, mod->group[i].max, sizeof(group[i].max)); 
+		group[i].image = -1; 
+		if(!mod->group[i].image) continue; 
+		for(j = 0; j < header.imageCount && seen[j] != mod->group[i].image; j++); 
+		if(j == header.imageCount) {
+			seen[j] = mod->group[i].image; 
+			strcpy(image[j].filename, mod->group[i].image->filename); 
+			// name this model's own file,  not whichever copy was loaded first.
+			const struct MaterialSet *materials = (const struct MaterialSet *)mod->materials; 
+			for(k = 0; materials && k < materials->count; k++) {
+				if(materials->material[k].image == seen[j]) {
+					strcpy(image[j].filename, materials->material[k].imagePath); 
+					break; 
+				}
+			}
+			header.imageCount++; 
+		}
+		group[i].image = j; 
+	}
+	header.vertOffset = (sizeof(header) + 15) & ~15; 
+	header.indexOffset = header.vertOffset + sizeof(struct Vertex3DTNP) * mod->vertCount; 
+	header.groupOffset = (header.indexOffset + mod->indexSize * mod->indexCount + 3) & ~3; 
+	header.imageOffset = header.groupOffset + sizeof(struct MeshCacheGroup) * mod->groupCount; 
+	header.fileSize = header.imageOffset + sizeof(struct MeshCacheImage) * header.imageCount; 
+	if(mod->shade) {
+		header.shadeOffset = header.fileSize; 
+		header.fileSize += sizeof(Color) * mod->vertCount; 
+	}
+
+	// write a temporary and move it into place,  so a half written cache is never seen.
+	sprintf(temp, "%s.tmp", path); 
+	FILE *file = fopen(temp, "wb"); 
+	if(file) {
+		static const char pad[16] = {0}; 
+		int ok = fwrite(&header, sizeof(header), 1, file) == 1; 
+		ok = ok && fwrite(pad, header.vertOffset - sizeof(header), 1, file) <= 1; 
+		ok = ok && fwrite(mod->vert, sizeof(struct Vertex3DTNP), mod->vertCount, file) == (size_t)mod->vertCount; 
+		if(mod->indexCount) ok = ok && fwrite(mod->index, mod->indexSize, mod->indexCount, file) == (size_t)mod->indexCount; 
+		ok = ok && fwrite(pad, header.groupOffset - header.indexOffset - mod->indexSize * mod->indexCount, 1, file) <= 1; 
+		ok = ok && fwrite(group, sizeof(struct MeshCacheGroup), mod->groupCount, file) == (size_t)mod->groupCount; 
+		ok = ok && fwrite(image, sizeof(struct MeshCacheImage), header.imageCount, file) == (size_t)header.imageCount; 
+		if(mod->shade) ok = ok && fwrite(mod->shade, sizeof(Color), mod->vertCount, file) == (size_t)mod->vertCount; 
+		ok = fclose(file) == 0 && ok; 
+#ifdef _WIN32
+		if(ok) remove(path); 
+#endif
+		if(!ok || rename(temp, path) != 0) {
+			printf("*** Couldn't write %s\n", path); 
+			remove(temp); 
+		}
+	} else {
+		printf("*** Couldn't write %s\n", temp); 
+	}
+	free(seen); 
+	free(image); 
+	free(group); 
+}
+
+static void freeWavefrontMesh(struct WavefrontMesh *mod); 
+
+// Loading a model that is already loaded with the same options shares its mesh.
+static struct WavefrontMesh *shareWavefront(const char *key, struct WavefrontMesh *mod)
+{
+	struct WavefrontMesh *shared = (struct WavefrontMesh *)addAsset(ASSET_MESH, key, 0, mod, 0); 
+	if(shared != mod) freeWavefrontMesh(mod); 
+	return shared; 
+}
+
+// Bounds for each group to be culled by,  from the float vertices before any quantizing.
+static void boundWavefrontGroups(struct WavefrontMesh *mod)
+{
+	int g, j, k; 
+	for(g = 0; g < mod->groupCount; g++) {
+		struct MaterialGroup *group = mod->group + g; 
+		for(k = 0; k < 3; k++) {
+			group->min[k] = mod->max[k]; 
+			group->max[k] = mod->min[k]; 
+		}
+		for(j = group->first; j < group->last; j++) {
+			int v = !mod->index ? j : mod->indexSize == 2 ? ((unsigned short *)mod->index)[j] : ((unsigned int *)mod->index)[j]; 
+			const float *position = &mod->vert[v].x; 
+			for(k = 0; k < 3; k++) {
+				if(group->min[k] > position[k]) group->min[k] = position[k]; 
+				if(group->max[k] < position[k]) group->max[k] = position[k]; 
+			}
+		}
+		if(group->first >= group->last) {
+			memset(group->min, 0, sizeof(group->min)); 
+			memset(group->max, 0, sizeof(group->max)); 
+		}
+	}
+}
+
+static struct WavefrontMesh *buildWavefront(const char *fname, int flags)
+{
+	char path[256]; 
+	struct WavefrontMesh *mod = (struct WavefrontMesh *)calloc(sizeof(struct WavefrontMesh), 1); 
+	strcpy(mod->name, fname); 
+	mod->flags = flags; 
+	struct Material *material; 
+	int materialCount = 0; 
+	FILE *file; 
+	struct FileMap map; 
+	struct WavefrontState state; 
+	struct Arena arena; 	// everything that only lasts the load,  freed in one go at the end
+	int i, j; 
+
+	int useCache = !(flags & (WAVEFRONT_LEGACY_PARSER | WAVEFRONT_NO_CACHE | WAVEFRONT_NO_INDEX | WAVEFRONT_NO_OPTIMIZE | WAVEFRONT_ATLAS)); 
+	if(useCache && loadWavefrontCache(fname, mod, flags)) {
+		if(flags & WAVEFRONT_QUANTIZE) quantizeWavefront(mod); 
+		return mod; 
+	}
+
+	// a copy,  so that the use counts are this model's own.
+	initArena(&arena, "load", 0); 
+	struct MaterialSet *materials = acquireMaterials(fname, flags); 
+	materialCount = materials->count; 
+	material = (struct Material *)arenaCalloc(&arena, sizeof(struct Material) * (materialCount + 1)); 	// findMaterial falls back on the first
+	memcpy(material, materials->material, sizeof(struct Material) * materialCount); 
+	mod->materials = materials; 
+
+	printf("read obj for '%s'\n", fname); 
+	sprintf(path, "models/%s/%s.obj", fname, fname); 
+	memset(&state, 0, sizeof(state)); 
+	state.material = material; 
+	state.materialCount = materialCount; 
+	state.arena = &arena; 
+	struct ArenaMark parsed = arenaMark(&arena); 
+	
+	//printf("item[nextItem].vert = %08x\n", (int)item[nextItem].vert); 
+	int mapped = !(flags & (WAVEFRONT_LEGACY_PARSER | WAVEFRONT_NO_MMAP)) && mapPackedFile(path, &map); 
+	file = mapped ? 0 : fopen(path, "rb"); 
+	if(!mapped && !file) mapped = mapPackedFile(path, &map); 	// only in a pack,  which is parsed in memory whatever the flags
+	if(mapped) {
+		// tokenize straight out of the mapping,  no copies and no line length limit.
+		const char *end = map.data + map.size; 
+		if(!parseWavefrontParallel(map.data, map.size, mod, &state)) {
+			parseWavefrontLine(parseWavefrontBuffer(map.data, end, mod, &state), end, mod, &state); 
+		}
+		unmapFile(&map); 
+	} else {
+		// no mapping,  so fall back to buffered reads.
+		if(!file) {
+			printf("Couldn't find %s\n", path); 
+			releaseAsset(materials); 
+			freeArena(&arena); 
+			free(mod); 
+			return 0; 
+		}
+		if(flags & WAVEFRONT_LEGACY_PARSER) loadWavefrontTwoPass(file, mod, &state); 
+		else streamWavefront(file, mod, &state); 
+		fclose(file); 
+	}
+	if((flags & WAVEFRONT_LEGACY_PARSER) && !mapped) {
+		mod->vertCount = state.faceMax * 3; 
+	} else {
+		mod->vertCount = state.face * 3; 
+		printf("Found %d image verts,  %d texture verts,  %d normal verts,  %d groups and %d faces.\n", state.positionCount, state.textureCount, state.normalCount, mod->groupCount, state.face); 
+	}
+	arenaRewind(&arena, parsed); 	// the lists are done with,  the steps below reuse their space
+	state.texture = 0; 
+	state.normal = 0; 
+	state.position = 0; 
+	if(flags & WAVEFRONT_ATLAS) atlasWavefront(mod, &arena); 
+	if(!(flags & WAVEFRONT_NO_MERGE)) mergeWavefrontGroups(mod, &arena); 
+	if(!(flags & WAVEFRONT_NO_INDEX)) indexWavefront(mod, &arena); 
+	if(flags & WAVEFRONT_OCCLUSION) bakeWavefrontOcclusion(mod); 
+	boundWavefrontGroups(mod); 
+	// now clean up the materials that weren't used,  if any
+	for(i = 0; i < materialCount; i++) {
+		if(material[i].useCount == 0) {
+			printf("*** Material '%s' unused!\n", material[i].name); 
+		}
+	}
+	// the material set keeps its images,  the model takes its own reference to each one it draws with.
+	for(i = 0; i < mod->groupCount; i++) {
+		Image *image = mod->group[i].image; 
+		for(j = 0; j < i && mod->group[j].image != image; j++); 
+		if(image && j == i) retainAsset(image); 
+	}
+	if(useCache && !(flags & WAVEFRONT_NO_TEXTURES)) saveWavefrontCache(fname, mod); 
+	if(flags & WAVEFRONT_QUANTIZE) quantizeWavefront(mod); 
+	freeArena(&arena); 
+	
+	return mod; 
+}
+
+// The PSP draws swizzled textures,  the bigger ones from VRAM.  Its allocator has no lock,  so the
+// images are only swizzled here on the GL thread once the mesh is loaded.
+static void swizzleWavefrontImages(struct WavefrontMesh *mod)
+{
+#ifdef _PSP
+	int i; 
+	for(i = 0; i < mod->groupCount; i++) {
+		Image *image = mod->group[i].image; 
+		if(image && !image->isSwizzled) swizzleFast(image, image->textureWidth > 64 || image->textureHeight > 64); 
+	}
+#endif
+}
+
+static struct WavefrontModel *openWavefront(const char *fname, int flags)
+{
+	char key[280]; 
+	int i; 
+	snprintf(key, sizeof(key), "models/%s/%s.obj?%d", fname, fname, flags); 
+	struct WavefrontMesh *mesh = (struct WavefrontMesh *)findAsset(ASSET_MESH, key, 0); 
+	if(!mesh) {
+		mesh = buildWavefront(fname, flags); 
+		if(!mesh) return 0; 
+		mesh = shareWavefront(key, mesh); 
+	}
+	struct WavefrontModel *model = (struct WavefrontModel *)calloc(sizeof(struct WavefrontModel), 1); 
+	for(i = 0; i < 16; i++) {
+		model->matrix[i] = (i % 4) == (i/4)?1.0f:0; 
+	}
+	model->mesh = mesh; 
+	return model; 
+}
+
+struct WavefrontModel *loadWavefront(const char *fname)
+{
+	struct WavefrontModel *model = openWavefront(fname, wavefrontLoadFlags); 
+	if(model) swizzleWavefrontImages(model->mesh); 
+	return model; 
+}
+
+// Background loading: the obj,  cache and png work happens on a job thread,  and the GL thread picks
+// the finished model up in pollWavefrontLoads,  which queues its textures to stream in.
+struct WavefrontLoad {
+	char name[64]; 
+	int flags; 	// wavefrontLoadFlags when it was asked for
+	struct WavefrontModel *model; 	// 0 if it failed
+	volatile int loaded; 	// set by the job thread once model is
+	int ready; 	// textures queued,  finishWavefrontLoad can hand it over
+	struct WavefrontLoad *next; 
+}; 
+
+static struct WavefrontLoad *pendingLoads = 0; 	// not ready yet,  only touched on the GL thread
+
+static void loadWavefrontJob(void *arg, int index)
+{
+	struct WavefrontLoad *load = (struct WavefrontLoad *)arg; 
+	load->model = openWavefront(load->name, load->flags); 
+}
+
+struct WavefrontLoad *loadWavefrontAsync(const char *fname)
+{
+	struct WavefrontLoad *load = (struct WavefrontLoad *)calloc(sizeof(struct WavefrontLoad), 1); 
+	snprintf(load->name, sizeof(load->name), "%s", fname); 
+	load->flags = wavefrontLoadFlags; 
+	load->next = pendingLoads; 
+	pendingLoads = load; 
+	runAsync(loadWavefrontJob, load, &load->loaded); 
+	return load; 
+}
+
+// Copies of the arrays in buffer objects,  drawn from once they're all there.  The client arrays
+// stay,  the collision queries,  the cache and hot reloading still read them.
+static void queueWavefrontBuffers(struct WavefrontMesh *mod)
+{
+#ifndef _PSP
+	if(!wavefrontUseBuffers || !glBufferObjects) return; 
+	int vertSize = mod->packed ? sizeof(struct Vertex3DTNPfast) : sizeof(struct Vertex3DTNP); 
+	const void *vert = mod->packed ? (const void *)mod->packed : (const void *)mod->vert; 
+	if(!mod->vertexBuffer && vert) queueBufferUpload(&mod->vertexBuffer, GL_ARRAY_BUFFER, vert, vertSize * mod->vertCount); 
+	if(!mod->indexBuffer && mod->index) queueBufferUpload(&mod->indexBuffer, GL_ELEMENT_ARRAY_BUFFER, mod->index, mod->indexSize * mod->indexCount); 
+	if(!mod->shadeBuffer && mod->shade) queueBufferUpload(&mod->shadeBuffer, GL_ARRAY_BUFFER, mod->shade, sizeof(Color) * mod->vertCount); 
+#endif
+}
+
+static void queueWavefrontTextures(struct WavefrontMesh *mod)
+{
+#ifndef _PSP
+	int i; 
+	for(i = 0; i < mod->groupCount; i++) queueImageUpload(mod->group[i].image); 
+	queueWavefrontBuffers(mod); 
+#endif
+}
+
+// Once a frame on the GL thread.  Returns how many loads are still going.
+int pollWavefrontLoads()
+{
+	struct WavefrontLoad **link = &pendingLoads; 
+	int waiting = 0; 
+	while(*link) {
+		struct WavefrontLoad *load = *link; 
+		if(asyncDone(&load->loaded)) {
+			if(load->model) {
+				swizzleWavefrontImages(load->model->mesh); 
+				queueWavefrontTextures(load->model->mesh); 
+			}
+			load->ready = 1; 
+			*link = load->next; 
+			continue; 
+		}
+		waiting++; 
+		link = &load->next; 
+	}
+	return waiting; 
+}
+
+struct WavefrontModel *finishWavefrontLoad(struct WavefrontLoad **load)
+{
+	if(!*load || !(*load)->ready) return 0; 
+	struct WavefrontModel *model = (*load)->model; 
+	free(*load); 
+	*load = 0; 
+	return model; 
+}
+
+int cmpMaterialGroupImage(const void *one, const void *two)
+{
+	const struct MaterialGroup *a = (struct MaterialGroup *)one, *b = (struct MaterialGroup *)two; 
+	
+	return 	a->image < b->image?-1:a->image>b->image?1:0; 
+}
+
+static void freeWavefrontMesh(struct WavefrontMesh *mod)
+{
+	if(!mod || releaseAsset(mod) > 0) return; 	// someone else still has it
+	qsort(mod->group, mod->groupCount, sizeof(struct MaterialGroup), cmpMaterialGroupImage); 
+	Image *last = 0; 
+	int j; 
+	for(j = 0; j < mod->groupCount; j++) {
+		struct MaterialGroup *g = mod->group + j; 
+		if(g->image != 0 && g->image != last) {
+			releaseMaterialImage(g->image); 
+			last = g->image; 
+			g->image = 0; 
+		}
+	}
+
+	if(mod->group) free(mod->group); 
+	mod->group = 0; 
+#ifndef _PSP
+	// only the GL thread makes buffers,  a model dropped on a loading thread never has any.
+	if(mod->vert) cancelUploads(mod->vert); 	// cancelUploads(0) would take the textures too
+	if(mod->packed) cancelUploads(mod->packed); 
+	if(mod->index) cancelUploads(mod->index); 
+	if(mod->shade) cancelUploads(mod->shade); 
+	if(mod->vertexBuffer) pglDeleteBuffers(1, &mod->vertexBuffer); 
+	if(mod->indexBuffer) pglDeleteBuffers(1, &mod->indexBuffer); 
+	if(mod->shadeBuffer) pglDeleteBuffers(1, &mod->shadeBuffer); 
+#endif
+	if(mod->materials) releaseAsset(mod->materials); 
+	if(mod->cache.data) {
+		unmapFile(&mod->cache); 
+	} else {
+		if(mod->vert) free(mod->vert); 
+		if(mod->index) free(mod->index); 
+		if(mod->shade) free(mod->shade); 
+	}
+	mod->shade = 0; 
+	if(mod->packed) free(mod->packed); 
+	mod->packed = 0; 
+	if(mod->bvh) {
+		freeBvh(mod->bvh); 
+		free(mod->bvh); 
+	}
+	mod->vert = 0; 
+	mod->index = 0; 
+	free(mod);
+}
+
+void freeWavefront(struct WavefrontModel *model)
+{
+	if(!model) return; 
+	freeWavefrontMesh(model->mesh); 
+	free(model); 
+}
+
+// Hot reloading: a file that changed on disk is reparsed on the GL thread between frames and swapped
+// into the mesh or image already shared out,  so whatever holds them sees the new one next frame.
+// Models and images that don't use the file are left alone.
+static int reloadMaterialImage(Image *image, const char *path)
+{
+	Image *fresh = loadPng(path); 
+	if(!fresh) {
+		printf("*** Couldn't reload %s,  keeping the old one\n", path); 
+		return 0; 
+	}
+	swizzleFast(fresh, fresh->textureWidth > 64 || fresh->textureHeight > 64); 
+#ifndef _PSP
+	cancelUploads(image); 	// anything still queued would read the old pixels
+#endif
+	Image old = *image; 
+	*image = *fresh; 
+	image->texid = old.texid; 	// still drawn with until the new pixels are all in
+	*fresh = old; 
+	fresh->texid = 0; 
+	freeImage(fresh); 
+	updateAsset(image, path, hashPackedFile(path)); 
+#ifndef _PSP
+	queueImageReplace(image); 
+#endif
+	printf("reloaded %s\n", path); 
+	return 1; 
+}
+
+static int reloadWavefrontMesh(struct WavefrontMesh *mod)
+{
+	struct WavefrontMesh *fresh = buildWavefront(mod->name, mod->flags); 
+	if(!fresh) {
+		printf("*** Couldn't reload %s,  keeping the old one\n", mod->name); 
+		return 0; 
+	}
+	struct WavefrontMesh old = *mod; 
+	*mod = *fresh; 
+	*fresh = old; 	// the old contents in a shell that isn't registered,  so freeWavefrontMesh frees it all
+	freeWavefrontMesh(fresh); 
+	swizzleWavefrontImages(mod); 
+	queueWavefrontTextures(mod); 
+	printf("reloaded %s\n", mod->name); 
+	return 1; 
+}
+
+// The parsed .mtl stops being handed out,  the models still using it keep it until they're reloaded.
+static void forgetMaterials(const char *fname)
+{
+	char key[280]; 
+	int k; 
+	for(k = 0; k < 2; k++) {
+		snprintf(key, sizeof(key), "models/%s/%s.mtl%s", fname, fname, k ? "?notextures" : ""); 
+		void *set = findAsset(ASSET_MATERIALS, key, 0); 
+		if(!set) continue; 
+		updateAsset(set, 0, 0); 
+		releaseAsset(set); 
+	}
+}
+
+// 1 if the model draws with path,  2 if that's through an image loaded from another file with the same contents.
+static int wavefrontUsesImage(struct WavefrontMesh *mod, const char *path, Image *image)
+{
+	struct MaterialSet *set = (struct MaterialSet *)mod->materials; 
+	int i, uses = 0; 
+	if(!set) {
+		// from the cache,  which doesn't keep which file each image was for,  so reloading it is the way to find out.
+		size_t len = strlen(mod->name); 
+		for(i = 0; i < mod->groupCount; i++) {
+			if(image && mod->group[i].image == image) return 2; 
+		}
+		return strncmp(path, "models/", 7) == 0 && strncmp(path + 7, mod->name, len) == 0 && path[7 + len] == '/' ? 2 : 0; 
+	}
+	for(i = 0; i < set->count; i++) {
+		int same = strcmp(set->material[i].imagePath, path) == 0; 
+		if(same && !uses) uses = 1; 
+		if(same != (image && set->material[i].image == image)) uses = 2; 
+	}
+	return uses; 
+}
+
+int reloadWavefrontFile(const char *path)
+{
+	char name[64]; 
+	const char *file = strrchr(path, '/'); 
+	const char *dir = file; 
+	if(!file) return 0; 
+	while(dir > path && dir[-1] != '/') dir--; 
+	if(file - dir >= (int)sizeof(name)) return 0; 
+	memcpy(name, dir, file - dir); 
+	name[file - dir] = 0; 
+	file++; 
+	const char *ext = strrchr(file, '.'); 
+	if(!ext) return 0; 
+	int isPng = strcmp(ext, ".png") == 0; 
+	int isModel = (strcmp(ext, ".obj") == 0 || strcmp(ext, ".mtl") == 0) && strncmp(file, name, ext - file) == 0 && (int)strlen(name) == ext - file; 
+	if(!isPng && !isModel) return 0; 	// the .mesh caches we write ourselves come through here too
+
+	int reloaded = 0, i; 
+	Image *image = 0; 
+	if(isPng) {
+		image = (Image *)findAsset(ASSET_IMAGE, path, 0); 
+		if(image) {
+			reloaded += reloadMaterialImage(image, path); 
+			releaseAsset(image); 	// findAsset's reference,  the models have their own
+		}
+	}
+	if(strcmp(ext, ".mtl") == 0) forgetMaterials(name); 
+
+	int meshCount = listAssets(ASSET_MESH, 0, 0); 
+	struct WavefrontMesh **mesh = (struct WavefrontMesh **)malloc(sizeof(struct WavefrontMesh *) * (meshCount + 1)); 
+	meshCount = listAssets(ASSET_MESH, (void **)mesh, meshCount); 
+	for(i = 0; i < meshCount; i++) {
+		struct WavefrontMesh *mod = mesh[i]; 
+		if(isModel) {
+			if(strcmp(mod->name, name) == 0) reloaded += reloadWavefrontMesh(mod); 
+			continue; 
+		}
+		// a png swapped in place shows up by itself,  unless the model baked it into an atlas,  or it was
+		// sharing the image with another file that has just stopped looking the same.
+		if(mod->flags & WAVEFRONT_NO_TEXTURES) continue; 
+		int uses = wavefrontUsesImage(mod, path, image); 
+		if(!uses) continue; 
+		if(uses == 1 && image && !(mod->flags & WAVEFRONT_ATLAS)) continue; 
+		forgetMaterials(mod->name); 
+		reloaded += reloadWavefrontMesh(mod); 
+	}
+	free(mesh); 
+	return reloaded; 
+}
+
+// The level of detail when it doesn't depend on where the model is,  -1 when it does.
+static int fixedWavefrontLod(struct WavefrontMesh *mod)
+{
+	if(mod->lodCount == 0 || !mod->index) return 0; 
+	if(wavefrontLodLevel >= 0) return wavefrontLodLevel < mod->lodCount ? wavefrontLodLevel : mod->lodCount; 
+	if(wavefrontLodBias <= 0) return 0; 
+#ifdef _PSP
+	return 0; 
+#else
+	return -1; 
+#endif
+}
+
+#ifndef _PSP
+// The coarsest level whose error still comes out under wavefrontLodBias pixels,  view takes model
+// space to eye space.
+static int screenWavefrontLod(struct WavefrontMesh *mod, const float *view, const float *projection)
+{
+	float center[3], radius = 0; 
+	int k, level = 0; 
+	for(k = 0; k < 3; k++) {
+		center[k] = (mod->min[k] + mod->max[k]) / 2; 
+		radius += (mod->max[k] - center[k]) * (mod->max[k] - center[k]); 
+	}
+	float scale = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]); 
+	float distance = -(view[2] * center[0] + view[6] * center[1] + view[10] * center[2] + view[14]); 
+	if(distance <= sqrtf(radius) * scale) return 0; 	// we're inside it
+	float pixels = scale * projection[5] * camera.height / 2 / distance; 	// on screen size of one model unit
+	while(level < mod->lodCount && mod->lodError[level] * pixels <= wavefrontLodBias) level++; 
+	return level; 
+}
+#endif
+
+// Reads the matrices back,  so the model's own matrix should already be applied.
+static int selectWavefrontLod(struct WavefrontMesh *mod)
+{
+	int level = fixedWavefrontLod(mod); 
+#ifndef _PSP
+	if(level < 0) {
+		float view[16], projection[16]; 
+		glGetFloatv(GL_MODELVIEW_MATRIX, view); 
+		glGetFloatv(GL_PROJECTION_MATRIX, projection); 
+		level = screenWavefrontLod(mod, view, projection); 
+	}
+#endif
+	return level; 
+}
+
+#ifndef _PSP
+// Fixed function state every model is drawn with.
+static void beginWavefrontState()
+{
+	glEnable(GL_TEXTURE_2D); 
+	glFrontFace(GL_CCW); 
+	glColor3f(1, 1, 1); 
+
+	glEnable(GL_LIGHTING); 
+    glBlendFunc(GL_SRC_ALPHA,  GL_ONE_MINUS_SRC_ALPHA); 
+    glEnable(GL_BLEND); 
+    glAlphaFunc(GL_GREATER, 0); 
+    glEnable(GL_ALPHA_TEST); 
+}
+
+static void endWavefrontState()
+{
+    glDisable(GL_ALPHA_TEST); 
+	glFrontFace(GL_CW); 
+}
+
+// Arrays for a model's vertices.  They come from the buffer objects once they're in,  where the
+// array addresses become offsets into them.  Returns whether they're bound,  *indexBase is what the
+// index offsets are added to.
+static int beginWavefrontArrays(struct WavefrontMesh *mod, const char **indexBase)
+{
+	const char *vertBase = mod->packed ? (const char *)mod->packed : (const char *)mod->vert; 
+	const char *shadeBase = (const char *)mod->shade; 
+	*indexBase = (const char *)mod->index; 
+	int buffers = glBufferObjects && wavefrontUseBuffers; 
+	if(buffers) {
+		if(!mod->vertexBuffer || (mod->index && !mod->indexBuffer) || (mod->shade && !mod->shadeBuffer)) queueWavefrontBuffers(mod); 
+		if(mod->vertexBuffer) vertBase = 0; 
+		if(mod->indexBuffer) *indexBase = 0; 
+		if(mod->shadeBuffer) shadeBase = 0; 
+		pglBindBuffer(GL_ARRAY_BUFFER, mod->vertexBuffer); 
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mod->indexBuffer); 
+	}
+	if(mod->packed) {
+		glMatrixMode(GL_TEXTURE); 
+		glPushMatrix(); 
+		glLoadIdentity(); 
+		glTranslatef(mod->packOffset[3], mod->packOffset[4], 0); 
+		glScalef(mod->packScale[3], mod->packScale[4], 1); 
+		glMatrixMode(GL_MODELVIEW); 
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY); 
+		glEnableClientState(GL_NORMAL_ARRAY); 
+		glEnableClientState(GL_VERTEX_ARRAY); 
+		glTexCoordPointer(2, GL_SHORT, sizeof(struct Vertex3DTNPfast), vertBase + offsetof(struct Vertex3DTNPfast, u)); 
+		glNormalPointer(GL_BYTE, sizeof(struct Vertex3DTNPfast), vertBase + offsetof(struct Vertex3DTNPfast, nx)); 
+		glVertexPointer(3, GL_SHORT, sizeof(struct Vertex3DTNPfast), vertBase + offsetof(struct Vertex3DTNPfast, x)); 
+	} else if(mod->vert) {
+		// Vertex3DTNP is laid out the way GL_T2F_N3F_V3F wants it.
+		glInterleavedArrays(GL_T2F_N3F_V3F, sizeof(struct Vertex3DTNP), vertBase); 
+	}
+	if(mod->shade) {
+		// the baked occlusion stands in for the material's ambient and diffuse.
+		glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE); 
+		glEnable(GL_COLOR_MATERIAL); 
+		glEnableClientState(GL_COLOR_ARRAY); 
+		if(buffers) pglBindBuffer(GL_ARRAY_BUFFER, mod->shadeBuffer); 
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, shadeBase); 
+	}
+	if(buffers) pglBindBuffer(GL_ARRAY_BUFFER, 0); 	// the pointers keep the buffers they were set with
+	return buffers; 
+}
+
+// Alpha tested texels show what's behind them,  so textures with any need the alpha tested shaders
+// and stay out of the occlusion buffer.
+// The padding out to a power of two counts,  texture coordinates can wrap into it.  Each image
+// is looked through once,  and again if its pixels are replaced.
+struct WavefrontSeeThrough {
+	const Image *image; 
+	const Color *data; 
+	int seeThrough; 
+}; 
+static struct WavefrontSeeThrough *seeThrough = 0; 
+static int seeThroughCount = 0; 
+static int seeThroughMax = 0; 
+
+static int imageSeeThrough(const Image *image)
+{
+	int i, x, y; 
+	if(!image) return 0; 
+	if(!image->data || image->isSwizzled) return 1; 	// can't tell
+	for(i = 0; i < seeThroughCount; i++) {
+		if(seeThrough[i].image == image && seeThrough[i].data == image->data) return seeThrough[i].seeThrough; 
+	}
+	for(i = 0; i < seeThroughCount && seeThrough[i].image != image; i++); 
+	if(i == seeThroughCount) {
+		seeThrough = (struct WavefrontSeeThrough *)growArray(seeThrough, &seeThroughMax, seeThroughCount, sizeof(struct WavefrontSeeThrough)); 
+		seeThroughCount++; 
+	}
+	struct WavefrontSeeThrough *s = seeThrough + i; 
+	s->image = image; 
+	s->data = image->data; 
+	s->seeThrough = image->imageHeight < image->textureHeight || image->imageWidth < image->textureWidth; 	// rows or columns that were never loaded
+	for(y = 0; y < image->imageHeight && !s->seeThrough; y++) {
+		const Color *row = image->data + y * image->textureWidth; 
+		for(x = 0; x < image->imageWidth; x++) {
+			if((row[x] >> 24) == 0) {
+				s->seeThrough = 1; 
+				break; 
+			}
+		}
+	}
+	return s->seeThrough; 
+}
+
+// Shaders: GL_LIGHT0's lighting,  GL_MODULATE texturing and the alpha test done in GLSL,  with a
+// program for each mix of them so a group only runs what it needs.  They're all built up front and
+// the linked binaries kept in models/ where the driver can save them,  so later runs skip compiling.
+// The instanced ones take a matrix and a tint per instance as well.  Drawing falls back to fixed
+// function with wavefrontUseShaders = 0 or if any of them won't build.
+#define WAVEFRONT_PROGRAM_LIT 1 	// unlit groups get gl_Color as it is
+#define WAVEFRONT_PROGRAM_TEXTURED 2 
+#define WAVEFRONT_PROGRAM_ALPHA_TEST 4 	// discards what glAlphaFunc(GL_GREATER, 0) would,  which costs early depth testing
+#define WAVEFRONT_PROGRAM_INSTANCED 8 
+#define WAVEFRONT_PROGRAMS 16 
+#define WAVEFRONT_INSTANCE_ATTRIBUTE 12 	// the matrix takes 12 to 15,  which only alias texture units 4 to 7
+#define WAVEFRONT_TINT_ATTRIBUTE 11 
+
+struct WavefrontProgram {
+	unsigned int program; 
+	int shaded; 	// uniforms,  -1 where the permutation doesn't have them
+	int packOffset; 
+	int packScale; 
+}; 
+struct WavefrontShading {
+	struct WavefrontProgram *current; 	// 0 until a group picks one
+	struct WavefrontMesh *mod; 	// the one current's uniforms were set for
+	int instanced; 	// WAVEFRONT_PROGRAM_INSTANCED or 0
+	int alphaTest; 	// every group needs it,  for tints that may be see-through
+	int texture; 	// bound now,  groups without an image draw with it like fixed function does
+	int switches; 
+}; 
+static struct WavefrontProgram wavefrontProgram[WAVEFRONT_PROGRAMS]; 
+static int wavefrontProgramsTried = 0; 
+static int wavefrontProgramsBuilt = 0; 	// a bit per permutation
+
+static const char *wavefrontVertexShader = 
+	"varying vec4 lit; \n"
+	"#ifdef LIT\n"
+	"uniform int shaded; \n"	// gl_Color is the baked occlusion,  standing in for the material
+	"#endif\n"
+	"#ifdef INSTANCED\n"
+	"uniform vec3 packOffset; \n"
+	"uniform vec3 packScale; \n"
+	"attribute mat4 instance; \n"
+	"attribute vec4 tint; \n"
+	"#endif\n"
+	"void main()\n"
+	"{\n"
+	"#ifdef INSTANCED\n"
+	"	vec4 position = instance * vec4(packOffset + packScale * gl_Vertex.xyz, 1.0); \n"
+	"#else\n"
+	"	vec4 position = gl_Vertex; \n"
+	"#endif\n"
+	"#ifdef LIT\n"
+	"	vec4 eye = gl_ModelViewMatrix * position; \n"
+	"#ifdef INSTANCED\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * (mat3(instance) * gl_Normal)); \n"
+	"#else\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * gl_Normal); \n"
+	"#endif\n"
+	"	vec4 toLight = gl_LightSource[0].position; \n"
+	"	vec3 light = normalize(toLight.w == 0.0 ? toLight.xyz : toLight.xyz - eye.xyz); \n"
+	"	vec4 ambient = shaded != 0 ? gl_Color : gl_FrontMaterial.ambient; \n"
+	"	vec4 diffuse = shaded != 0 ? gl_Color : gl_FrontMaterial.diffuse; \n"
+	"	vec3 color = gl_FrontMaterial.emission.rgb + ambient.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb) + \n"
+	"		diffuse.rgb * gl_LightSource[0].diffuse.rgb * max(dot(normal, light), 0.0); \n"
+	"	lit = vec4(clamp(color, 0.0, 1.0), diffuse.a); \n"
+	"#else\n"
+	"	lit = gl_Color; \n"
+	"#endif\n"
+	"#ifdef INSTANCED\n"
+	"	lit *= tint; \n"
+	"#endif\n"
+	"#ifdef TEXTURED\n"
+	"	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0; \n"
+	"#endif\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * position; \n"
+	"}\n"; 
+static const char *wavefrontFragmentShader = 
+	"varying vec4 lit; \n"
+	"#ifdef TEXTURED\n"
+	"uniform sampler2D image; \n"
+	"#endif\n"
+	"void main()\n"
+	"{\n"
+	"#ifdef TEXTURED\n"
+	"	vec4 color = lit * texture2D(image, gl_TexCoord[0].st); \n"	// GL_MODULATE
+	"#else\n"
+	"	vec4 color = lit; \n"
+	"#endif\n"
+	"#ifdef ALPHA_TEST\n"
+	"	if(color.a <= 0.0) discard; \n"
+	"#endif\n"
+	"	gl_FragColor = color; \n"
+	"}\n"; 
+
+// Returns how many permutations there are now,  the instanced ones only with instancing.
+static int buildWavefrontPrograms(int useCache)
+{
+	static const struct ProgramAttribute attribute[] = { { "instance", WAVEFRONT_INSTANCE_ATTRIBUTE }, { "tint", WAVEFRONT_TINT_ATTRIBUTE } }; 
+	char name[64], path[256], vertex[4096], fragment[2048]; 
+	int p, built = 0, cached = 0; 
+	wavefrontProgramsTried = 1; 
+	if(!glShaders) return 0; 
+	for(p = 0; p < WAVEFRONT_PROGRAMS; p++) {
+		struct WavefrontProgram *program = wavefrontProgram + p; 
+		int fromCache = 0; 
+		if((p & WAVEFRONT_PROGRAM_INSTANCED) && !glInstancing) continue; 
+		snprintf(name, sizeof(name), "wavefront%s%s%s%s", p & WAVEFRONT_PROGRAM_LIT ? "-lit" : "-unlit", p & WAVEFRONT_PROGRAM_TEXTURED ? "-textured" : "", 
+			p & WAVEFRONT_PROGRAM_ALPHA_TEST ? "-alphatest" : "", p & WAVEFRONT_PROGRAM_INSTANCED ? "-instanced" : ""); 
+		snprintf(path, sizeof(path), "models/%s.program", name); 
+		// #version has to come first,  then what this one is.
+		char defines[128]; 
+		snprintf(defines, sizeof(defines), "#version 120\n%s%s%s%s", p & WAVEFRONT_PROGRAM_LIT ? "#define LIT\n" : "", p & WAVEFRONT_PROGRAM_TEXTURED ? "#define TEXTURED\n" : "", 
+			p & WAVEFRONT_PROGRAM_ALPHA_TEST ? "#define ALPHA_TEST\n" : "", p & WAVEFRONT_PROGRAM_INSTANCED ? "#define INSTANCED\n" : ""); 
+		snprintf(vertex, sizeof(vertex), "%s%s", defines, wavefrontVertexShader); 
+		snprintf(fragment, sizeof(fragment), "%s%s", defines, wavefrontFragmentShader); 
+		program->program = buildCachedProgram(name, vertex, fragment, attribute, 2, useCache ? path : 0, &fromCache); 
+		if(!program->program) continue; 
+		program->shaded = pglGetUniformLocation(program->program, "shaded"); 
+		program->packOffset = pglGetUniformLocation(program->program, "packOffset"); 
+		program->packScale = pglGetUniformLocation(program->program, "packScale"); 
+		pglUseProgram(program->program); 
+		pglUniform1i(pglGetUniformLocation(program->program, "image"), 0); 
+		wavefrontProgramsBuilt |= 1 << p; 
+		built++; 
+		cached += fromCache; 
+	}
+	pglUseProgram(0); 
+	printf("built %d shader permutations,  %d from saved binaries\n", built, cached); 
+	return built; 
+}
+
+// The programs for instanced or plain drawing,  0 with fixed function.
+static struct WavefrontShading *beginWavefrontShading(struct WavefrontShading *shading, int instanced, int alphaTest)
+{
+	int need = instanced ? 0xff00 : 0xff; 	// a bit per permutation
+	GLint texture = 0; 
+	if(!wavefrontUseShaders) return 0; 
+	if(!wavefrontProgramsTried) buildWavefrontPrograms(1); 
+	if((wavefrontProgramsBuilt & need) != need) return 0; 
+	memset(shading, 0, sizeof(*shading)); 
+	shading->instanced = instanced ? WAVEFRONT_PROGRAM_INSTANCED : 0; 
+	shading->alphaTest = alphaTest; 
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture); 
+	shading->texture = texture; 
+	return shading; 
+}
+
+static void endWavefrontShading(struct WavefrontShading *shading)
+{
+	if(shading) pglUseProgram(0); 
+}
+
+// The least a group needs.  Groups without an image use what's bound,  whose alpha isn't known
+// unless it was bound here.
+static void useWavefrontProgram(struct WavefrontShading *shading, struct WavefrontMesh *mod, int g, const Image *bound)
+{
+	const struct MaterialGroup *group = mod->group + g; 
+	const Image *image = group->image ? group->image : bound; 
+	int texture = group->image ? group->image->texid : shading->texture; 
+	int p = shading->instanced; 
+	if(!group->unlit) p |= WAVEFRONT_PROGRAM_LIT; 
+	if(texture) p |= WAVEFRONT_PROGRAM_TEXTURED; 
+	if(shading->alphaTest || group->transparent || (texture && (!image || imageSeeThrough(image)))) p |= WAVEFRONT_PROGRAM_ALPHA_TEST; 
+	struct WavefrontProgram *program = wavefrontProgram + p; 
+	if(program == shading->current && mod == shading->mod) return; 
+	if(!shading->current) glDisable(GL_ALPHA_TEST); 	// it would still run after the shaders,  endWavefrontState turns it off anyway
+	if(program != shading->current) {
+		pglUseProgram(program->program); 
+		shading->switches++; 
+	}
+	if(program->shaded >= 0) pglUniform1i(program->shaded, mod->shade != 0); 
+	if(program->packOffset >= 0) {
+		if(mod->packed) {
+			pglUniform3f(program->packOffset, mod->packOffset[0], mod->packOffset[1], mod->packOffset[2]); 
+			pglUniform3f(program->packScale, mod->packScale[0], mod->packScale[1], mod->packScale[2]); 
+		} else {
+			pglUniform3f(program->packOffset, 0, 0, 0); 
+			pglUniform3f(program->packScale, 1, 1, 1); 
+		}
+	}
+	shading->current = program; 
+	shading->mod = mod; 
+}
+
+// One group at the given level,  instanced when instances isn't 0,  with shading's programs or
+// fixed function if that's 0.  Returns 1 if it bound a texture.
+static int drawWavefrontGroup(struct WavefrontMesh *mod, int g, int lod, const char *indexBase, Image **bound, int instances, struct WavefrontShading *shading)
+{
+	int j, jCount, binds = 0; 
+	if(mod->group[g].image && mod->group[g].image != *bound) {
+		Image *source = mod->group[g].image; 
+		*bound = source; 
+		// streamed in by runUploads,  texture 0 leaves it untextured until then.
+		if(source->texid == 0) queueImageUpload(source); 
+		glBindTexture(GL_TEXTURE_2D, source->texid); 
+		if(shading) shading->texture = source->texid; 
+		binds = 1; 
+	}
+	j = lod ? mod->group[g].lodFirst[lod - 1] : mod->group[g].first; 
+	jCount = lod ? mod->group[g].lodLast[lod - 1] : mod->group[g].last; 
+	if(j >= jCount && !lod) printf("wavefrontmodel %s: skipping group %d of %d,  vert %d-%d\n", mod->name, g, mod->groupCount, j, jCount); 
+	if((!mod->vert && !mod->packed) || j >= jCount) return binds; 
+	int unlit = !shading && mod->group[g].unlit; 
+	if(shading) useWavefrontProgram(shading, mod, g, *bound); 
+	if(unlit) glDisable(GL_LIGHTING); 
+	GLenum type = mod->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; 
+	if(instances && mod->index) pglDrawElementsInstanced(GL_TRIANGLES, jCount - j, type, indexBase + j * mod->indexSize, instances); 
+	else if(instances) pglDrawArraysInstanced(GL_TRIANGLES, j, jCount - j, instances); 
+	else if(mod->index) glDrawElements(GL_TRIANGLES, jCount - j, type, indexBase + j * mod->indexSize); 
+	else glDrawArrays(GL_TRIANGLES, j, jCount - j); 
+	if(unlit) glEnable(GL_LIGHTING); 
+	return binds; 
+}
+
+static void drawWavefrontGroups(struct WavefrontMesh *mod, int transparent, int lod, const char *indexBase, Image **bound, int instances, struct WavefrontShading *shading)
+{
+	int g; 
+	for(g = 0; g < mod->groupCount; g++) {
+		if(transparent == 0 && mod->group[g].transparent) continue; 
+		if(transparent == 1 && !mod->group[g].transparent) continue; 
+		drawWavefrontGroup(mod, g, lod, indexBase, bound, instances, shading); 
+	}
+}
+
+static void endWavefrontArrays(struct WavefrontMesh *mod, int buffers)
+{
+	if(buffers) pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); 
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY); 
+	glDisableClientState(GL_NORMAL_ARRAY); 
+	glDisableClientState(GL_VERTEX_ARRAY); 
+	if(mod->shade) {
+		static const GLfloat ambient[] = { 0.2f, 0.2f, 0.2f, 1 }, diffuse[] = { 0.8f, 0.8f, 0.8f, 1 }; 	// GL's defaults
+		glDisableClientState(GL_COLOR_ARRAY); 
+		glDisable(GL_COLOR_MATERIAL); 	// leaves the material at the last vertex's colour
+		glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient); 
+		glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse); 
+		glColor3f(1, 1, 1); 
+	}
+	if(mod->packed) {
+		glMatrixMode(GL_TEXTURE); 
+		glPopMatrix(); 
+		glMatrixMode(GL_MODELVIEW); 
+	}
+}
+#endif
+
+int loadWavefrontShaders(int useCache)
+{
+#ifdef _PSP
+	return 0; 
+#else
+	int p; 
+	for(p = 0; p < WAVEFRONT_PROGRAMS; p++) freeProgram(wavefrontProgram[p].program); 
+	memset(wavefrontProgram, 0, sizeof(wavefrontProgram)); 
+	wavefrontProgramsBuilt = 0; 
+	return buildWavefrontPrograms(useCache); 
+#endif
+}
+
+void drawWavefrontPartial(struct WavefrontModel *model, int transparent)
+{
+	Image *bound = 0; 	// groups are sorted by texture,  so most of them can skip the bind
+	if(!model) return; 
+	struct WavefrontMesh *mod = model->mesh; 
+#ifdef _PSP
+	//printf("Rendering item %d\n", i); 
+	sceGumMatrixMode(GU_MODEL); 
+	sceGumPushMatrix(); 
+	sceGumMultMatrix((ScePspFMatrix4 *)model->matrix); 
+	int lod = selectWavefrontLod(mod); 
+	int j = 0; 
+	int g; 
+	int jCount; 
+	//printf("item image: %08x\n", (int)item[i].image); 
+	sceGuEnable(GU_TEXTURE_2D); 
+	sceGuColor(0xffffffff); 
+	sceGuFrontFace(GU_CCW); 
+
+	sceGuTexScale(1.0f, 1.0f); 
+	if(mod->packed) {
+		// the GE reads 16 bit values as -1..1,  so the scales are 32768 times the per step ones.
+		ScePspFVector3 offset = { mod->packOffset[0], mod->packOffset[1], mod->packOffset[2] }; 
+		ScePspFVector3 scale = { mod->packScale[0] * 32768, mod->packScale[1] * 32768, mod->packScale[2] * 32768 }; 
+		sceGumTranslate(&offset); 
+		sceGumScale(&scale); 
+		sceGuTexScale(mod->packScale[3] * 32768, mod->packScale[4] * 32768); 
+		sceGuTexOffset(mod->packOffset[3], mod->packOffset[4]); 
+	}
+	sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA); 
+	sceGuEnable(GU_LIGHTING); 
+
+	for(g = 0; g < mod->groupCount; g++) {
+		if(transparent == 0 && mod->group[g].transparent) continue; 
+		if(transparent == 1 && !mod->group[g].transparent) continue; 
+		if(mod->group[g].image && mod->group[g].image != bound) {
+			Image *source = mod->group[g].image; 
+			bound = source; 
+			sceGuTexMode(GU_PSM_8888,  0,  0,  source->isSwizzled); 
+			sceGuTexImage(0,  source->textureWidth,  source->textureHeight,  source->textureWidth,  source->data); 
+		}
+		j = lod ? mod->group[g].lodFirst[lod - 1] : mod->group[g].first; 
+		jCount = lod ? mod->group[g].lodLast[lod - 1] : mod->group[g].last; 
+		if(j >= jCount && !lod) printf("wavefrontmodel %s: skipping group %d of %d,  vert %d-%d\n", mod->name, g, mod->groupCount, j, jCount); 
+		while(j < jCount) {
+			int count = 30720; 
+			if(j + count > jCount) count = jCount - j; 
+			if(count <= 0) { printf("lost my place.\n");  continue;  }
+			if(mod->packed && mod->index) sceGumDrawArray(GU_TRIANGLES, GU_INDEX_16BIT|GU_VERTEX_16BIT|GU_NORMAL_8BIT|GU_TEXTURE_16BIT|GU_TRANSFORM_3D, count, (unsigned short *)mod->index + j, mod->packed); 
+			else if(mod->packed) sceGumDrawArray(GU_TRIANGLES, GU_VERTEX_16BIT|GU_NORMAL_8BIT|GU_TEXTURE_16BIT|GU_TRANSFORM_3D, count, 0, mod->packed + j); 
+			else if(mod->vert && mod->index) sceGumDrawArray(GU_TRIANGLES, GU_INDEX_16BIT|GU_VERTEX_32BITF|GU_NORMAL_32BITF|GU_TEXTURE_32BITF|GU_TRANSFORM_3D, count, (unsigned short *)mod->index + j, mod->vert); 
+			else if(mod->vert) sceGumDrawArray(GU_TRIANGLES, GU_VERTEX_32BITF|GU_NORMAL_32BITF|GU_TEXTURE_32BITF|GU_TRANSFORM_3D, count, 0, mod->vert + j); 
+			j = j + count; 
+		}
+	}
+	if(mod->packed) {
+		sceGuTexScale(1.0f, 1.0f); 
+		sceGuTexOffset(0.0f, 0.0f); 
+	}
+	sceGuFrontFace(GU_CW); 
+	sceGumPopMatrix(); 
+#else
+	//printf("Rendering item %d\n", i); 
+	glMatrixMode(GL_MODELVIEW); 
+	glPushMatrix(); 
+	glMultMatrixf((float *)model->matrix); 
+	int lod = selectWavefrontLod(mod); 
+	const char *indexBase; 
+	beginWavefrontState(); 
+	int buffers = beginWavefrontArrays(mod, &indexBase); 
+	if(mod->packed) {
+		glTranslatef(mod->packOffset[0], mod->packOffset[1], mod->packOffset[2]); 
+		glScalef(mod->packScale[0], mod->packScale[1], mod->packScale[2]); 
+		glEnable(GL_NORMALIZE); 
+	}
+	struct WavefrontShading shading; 
+	struct WavefrontShading *shaded = beginWavefrontShading(&shading, 0, 0); 
+	drawWavefrontGroups(mod, transparent, lod, indexBase, &bound, 0, shaded); 
+	endWavefrontShading(shaded); 
+	if(mod->packed) glDisable(GL_NORMALIZE); 
+	endWavefrontArrays(mod, buffers); 
+	endWavefrontState(); 
+	glPopMatrix(); 
+#endif
+}
+void drawWavefront(struct WavefrontModel *model)
+{
+	drawWavefrontPartial(model, 3); 
+}
+
+// Instancing: one model drawn at many matrices.  Where GL has instanced arrays the matrices and
+// tints go up in a buffer and the instanced shader permutations draw each group once for all of
+// them.  Otherwise the arrays and state are set up once and only the matrix and light change
+// between instances.  Either way the instances are grouped by level of detail.
+#ifndef _PSP
+static unsigned int instanceBuffer = 0; 
+
+// Each level's instances are run[level] to run[level + 1] of matrix and color.
+static void drawWavefrontInstanced(struct WavefrontMesh *mod, const float *matrix, const Color *color, int count, const int *run, struct WavefrontShading *shading)
+{
+	Image *bound = 0; 
+	const char *indexBase; 
+	int k, lod; 
+	beginWavefrontState(); 
+	int buffers = beginWavefrontArrays(mod, &indexBase); 
+	int matrixBytes = sizeof(float) * 16 * count; 
+
+	if(!instanceBuffer) pglGenBuffers(1, &instanceBuffer); 
+	pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer); 
+	pglBufferData(GL_ARRAY_BUFFER, matrixBytes + (color ? sizeof(Color) * count : 0), 0, GL_STREAM_DRAW); 	// orphans the last lot rather than waiting on it
+	pglBufferSubData(GL_ARRAY_BUFFER, 0, matrixBytes, matrix); 
+	if(color) pglBufferSubData(GL_ARRAY_BUFFER, matrixBytes, sizeof(Color) * count, color); 
+
+	for(k = 0; k < 4; k++) {
+		pglEnableVertexAttribArray(WAVEFRONT_INSTANCE_ATTRIBUTE + k); 
+		pglVertexAttribDivisor(WAVEFRONT_INSTANCE_ATTRIBUTE + k, 1); 
+	}
+	if(color) {
+		pglEnableVertexAttribArray(WAVEFRONT_TINT_ATTRIBUTE); 
+		pglVertexAttribDivisor(WAVEFRONT_TINT_ATTRIBUTE, 1); 
+	} else {
+		pglVertexAttrib4f(WAVEFRONT_TINT_ATTRIBUTE, 1, 1, 1, 1); 
+	}
+	for(lod = 0; lod <= mod->lodCount; lod++) {
+		int first = run[lod], n = run[lod + 1] - run[lod]; 
+		if(n == 0) continue; 
+		// no base instance before 4.2,  so each level points the attributes at its own run.
+		for(k = 0; k < 4; k++) pglVertexAttribPointer(WAVEFRONT_INSTANCE_ATTRIBUTE + k, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (const char *)0 + sizeof(float) * (16 * first + 4 * k)); 
+		if(color) pglVertexAttribPointer(WAVEFRONT_TINT_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Color), (const char *)0 + matrixBytes + sizeof(Color) * first); 
+		drawWavefrontGroups(mod, 3, lod, indexBase, &bound, n, shading); 
+	}
+	for(k = 0; k < 5; k++) {
+		int attribute = k < 4 ? WAVEFRONT_INSTANCE_ATTRIBUTE + k : WAVEFRONT_TINT_ATTRIBUTE; 
+		pglVertexAttribDivisor(attribute, 0); 
+		pglDisableVertexAttribArray(attribute); 
+	}
+	pglBindBuffer(GL_ARRAY_BUFFER, 0); 
+	endWavefrontShading(shading); 
+	endWavefrontArrays(mod, buffers); 
+	endWavefrontState(); 
+}
+
+// Without instancing the tint scales GL_LIGHT0 and the scene ambient,  which comes to the same as
+// scaling the lit colour short of clamping.  Alpha isn't tinted.
+static void drawWavefrontBatched(struct WavefrontMesh *mod, const float *matrix, const Color *color, int count, const int *run)
+{
+	GLfloat lightAmbient[4], lightDiffuse[4], sceneAmbient[4]; 
+	Image *bound = 0; 
+	const char *indexBase; 
+	int i, k, lod; 
+	beginWavefrontState(); 
+	int buffers = beginWavefrontArrays(mod, &indexBase); 
+	Color tinted = 0xffffffff; 
+	struct WavefrontShading shading; 
+	struct WavefrontShading *shaded = beginWavefrontShading(&shading, 0, 0); 
+
+	glGetLightfv(GL_LIGHT0, GL_AMBIENT, lightAmbient); 
+	glGetLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse); 
+	glGetFloatv(GL_LIGHT_MODEL_AMBIENT, sceneAmbient); 
+	glEnable(GL_NORMALIZE); 	// the instances may be scaled
+	glMatrixMode(GL_MODELVIEW); 
+	for(lod = 0; lod <= mod->lodCount; lod++) {
+		for(i = run[lod]; i < run[lod + 1]; i++) {
+			if(color && color[i] != tinted) {
+				GLfloat ambient[4], diffuse[4], scene[4]; 
+				tinted = color[i]; 
+				for(k = 0; k < 4; k++) {
+					float scale = k < 3 ? ((tinted >> (k * 8)) & 0xff) / 255.0f : 1; 
+					ambient[k] = lightAmbient[k] * scale; 
+					diffuse[k] = lightDiffuse[k] * scale; 
+					scene[k] = sceneAmbient[k] * scale; 
+				}
+				glLightfv(GL_LIGHT0, GL_AMBIENT, ambient); 
+				glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse); 
+				glLightModelfv(GL_LIGHT_MODEL_AMBIENT, scene); 
+			}
+			glPushMatrix(); 
+			glMultMatrixf(matrix + 16 * i); 
+			if(mod->packed) {
+				glTranslatef(mod->packOffset[0], mod->packOffset[1], mod->packOffset[2]); 
+				glScalef(mod->packScale[0], mod->packScale[1], mod->packScale[2]); 
+			}
+			drawWavefrontGroups(mod, 3, lod, indexBase, &bound, 0, shaded); 
+			glPopMatrix(); 
+		}
+	}
+	if(tinted != 0xffffffff) {
+		glLightfv(GL_LIGHT0, GL_AMBIENT, lightAmbient); 
+		glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse); 
+		glLightModelfv(GL_LIGHT_MODEL_AMBIENT, sceneAmbient); 
+	}
+	endWavefrontShading(shaded); 
+	glDisable(GL_NORMALIZE); 
+	endWavefrontArrays(mod, buffers); 
+	endWavefrontState(); 
+}
+
+static void multiplyMatrix(float *out, const float *a, const float *b)
+{
+	int i, j; 
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 4; j++) out[i * 4 + j] = a[j] * b[i * 4] + a[4 + j] * b[i * 4 + 1] + a[8 + j] * b[i * 4 + 2] + a[12 + j] * b[i * 4 + 3]; 
+	}
+}
+#endif
+
+void drawWavefrontInstances(struct WavefrontModel *model, const float *matrix, const Color *color, int count)
+{
+	int i; 
+	if(!model || count <= 0) return; 
+#ifdef _PSP
+	struct WavefrontModel instance = *model; 
+	for(i = 0; i < count; i++) {
+		memcpy(instance.matrix, matrix + 16 * i, sizeof(instance.matrix)); 
+		drawWavefront(&instance); 
+	}
+#else
+	struct WavefrontMesh *mod = model->mesh; 
+	struct ArenaMark mark = arenaMark(&frameArena); 
+	int levels = mod->lodCount + 1; 
+	int *run = (int *)arenaCalloc(&frameArena, sizeof(int) * (levels + 1)); 
+	int lod = fixedWavefrontLod(mod); 
+	if(lod >= 0) {
+		for(i = lod + 1; i <= levels; i++) run[i] = count; 
+	} else {
+		// counting sort by level,  so each level is one run.
+		float view[16], projection[16], eye[16]; 
+		unsigned char *level = (unsigned char *)arenaAlloc(&frameArena, count); 
+		int *next = (int *)arenaAlloc(&frameArena, sizeof(int) * levels); 
+		float *sortedMatrix = (float *)arenaAlloc(&frameArena, sizeof(float) * 16 * count); 
+		Color *sortedColor = color ? (Color *)arenaAlloc(&frameArena, sizeof(Color) * count) : 0; 
+		glGetFloatv(GL_MODELVIEW_MATRIX, view); 
+		glGetFloatv(GL_PROJECTION_MATRIX, projection); 
+		for(i = 0; i < count; i++) {
+			multiplyMatrix(eye, view, matrix + 16 * i); 
+			level[i] = screenWavefrontLod(mod, eye, projection); 
+			run[level[i] + 1]++; 
+		}
+		for(i = 0; i < levels; i++) {
+			run[i + 1] += run[i]; 
+			next[i] = run[i]; 
+		}
+		for(i = 0; i < count; i++) {
+			int to = next[level[i]]++; 
+			memcpy(sortedMatrix + 16 * to, matrix + 16 * i, sizeof(float) * 16); 
+			if(color) sortedColor[to] = color[i]; 
+		}
+		matrix = sortedMatrix; 
+		color = sortedColor; 
+	}
+	struct WavefrontShading shading; 
+	if(wavefrontUseInstancing && beginWavefrontShading(&shading, 1, color != 0)) drawWavefrontInstanced(mod, matrix, color, count, run, &shading); 
+	else drawWavefrontBatched(mod, matrix, color, count, run); 
+	arenaRewind(&frameArena, mark); 
+#endif
+}
+
+// The render queue: queueWavefront only notes each model and where it's placed,  the rest waits for
+// drawWavefrontQueue and most of it runs on the job threads.  The queued models are split between
+// jobs that each cull theirs to the frustum,  then their groups all together in one batch and to
+// the occluders,  pick the levels of detail and sort what's left by 64 bit keys.  Those sorted runs
+// are merged in pairs,  and the merged items recorded as plain draw commands a slice per job.  All
+// the GL thread does is replay the commands.  Each texture gets bound and each model's arrays set up
+// once however the models came in,  and transparent groups come last,  back to front across all
+// the models.  Keys,  high bits first:
+//   solid        pass 0 (2) | state (3) | texture (14) | model (14) | depth front to back (16)
+//   transparent  pass 1 (2) | depth back to front (16) | state (3) | texture (14) | model (14)
+// where state is whether the model is quantized and whether it's shaded,  which change the fixed
+// function setup,  and whether the group is unlit,  which changes the shader,  and depth is the top
+// of the float's bits,  which sort like the floats.
+#ifndef _PSP
+#define WAVEFRONT_QUEUE_JOBS 16 	// most the queue is split between
+#define WAVEFRONT_QUEUE_SLICE 256 	// fewest commands worth recording on a job of their own
+
+struct WavefrontQueued {
+	struct WavefrontMesh *mod; 
+	float view[16]; 	// model to eye space when it was queued
+	float draw[16]; 	// view with the packing's offset and scale,  what the replay loads
+	int lod; 
+}; 
+struct WavefrontQueueItem {
+	unsigned long long key; 
+	int queued; 	// which WavefrontQueued
+	int group; 
+}; 
+struct WavefrontQueueJob {
+	struct Arena arena; 	// its items and boxes,  reset once the commands are replayed
+	int first, last; 	// the queued models it prepares
+	struct WavefrontQueueItem *item; 	// what's left of their groups,  sorted
+	int itemCount; 
+	int itemMax; 
+	int culled; 
+}; 
+struct WavefrontQueueRun {
+	struct WavefrontQueueItem *item; 
+	int count; 
+}; 
+struct WavefrontQueueMerge {
+	const struct WavefrontQueueRun *from; 
+	int fromCount; 
+	struct WavefrontQueueRun *to; 	// half as many,  rounded up
+}; 
+// One per draw,  with what has to change before it.  Plain data,  so it can be made off the GL thread.
+struct WavefrontCommand {
+	struct WavefrontMesh *mod; 
+	const float *matrix; 	// loaded before the draw,  0 to keep the last one
+	int arrays; 	// set up mod's arrays first
+	int group; 
+	int lod; 
+}; 
+struct WavefrontRecord {
+	const struct WavefrontQueueItem *item; 
+	struct WavefrontCommand *command; 	// one for each item
+	int count; 
+	int slices; 
+}; 
+static struct WavefrontQueued *queued = 0; 	// in frameArena,  so they have to be drawn before it's reset
+static int queuedCount = 0; 
+static int queuedMax = 0; 
+static int queueFrame = 1; 	// models queued since the last drawWavefrontQueue have queueFrame set to this
+static int queueSlotCount = 0; 
+static float queueProjection[16]; 	// from when the last model was queued,  for the frustum and the levels of detail
+static struct WavefrontQueueJob queueJob[WAVEFRONT_QUEUE_JOBS]; 
+
+static unsigned long long wavefrontQueueKey(int transparent, int state, int texture, int slot, float depth)
+{
+	union { float f; unsigned int u; } bits; 
+	bits.f = depth > 0 ? depth : 0; 
+	unsigned long long z = bits.u >> 16; 
+	unsigned long long material = ((unsigned long long)state << 28) | ((unsigned long long)(texture & 0x3fff) << 14) | (slot & 0x3fff); 
+	if(transparent) return (1ull << 62) | ((0xffff - z) << 31) | material; 
+	return (material << 16) | z; 
+}
+
+static int cmpWavefrontQueueItem(const void *a, const void *b)
+{
+	unsigned long long keyA = ((const struct WavefrontQueueItem *)a)->key; 
+	unsigned long long keyB = ((const struct WavefrontQueueItem *)b)->key; 
+	return keyA < keyB ? -1 : keyA > keyB ? 1 : 0; 
+}
+
+// Everything here is the job's own or only read,  occludedBox included.
+static void prepareWavefrontQueue(void *arg, int index)
+{
+	struct WavefrontQueueJob *job = queueJob + index; 
+	struct CullBoxes boxes; 
+	float plane[24], center[3]; 
+	int i, g, k; 
+	initCullBoxes(&boxes, &job->arena); 
+	frustumPlanes(plane, queueProjection); 
+	for(i = job->first; i < job->last; i++) {
+		struct WavefrontQueued *q = queued + i; 
+		struct WavefrontMesh *mod = q->mod; 
+		if(!cullBox(plane, mod->min, mod->max, q->view)) {
+			job->culled += mod->groupCount; 
+			continue; 
+		}
+		q->lod = fixedWavefrontLod(mod); 
+		if(q->lod < 0) q->lod = screenWavefrontLod(mod, q->view, queueProjection); 
+		memcpy(q->draw, q->view, sizeof(q->draw)); 
+		if(mod->packed) {
+			// glTranslatef then glScalef,  done here.
+			for(k = 0; k < 4; k++) {
+				q->draw[12 + k] += q->view[k] * mod->packOffset[0] + q->view[4 + k] * mod->packOffset[1] + q->view[8 + k] * mod->packOffset[2]; 
+				q->draw[k] *= mod->packScale[0]; 
+				q->draw[4 + k] *= mod->packScale[1]; 
+				q->draw[8 + k] *= mod->packScale[2]; 
+			}
+		}
+		for(k = 0; k < 3; k++) center[k] = (mod->min[k] + mod->max[k]) / 2; 
+		float depth = -(q->view[2] * center[0] + q->view[6] * center[1] + q->view[10] * center[2] + q->view[14]); 
+		int state = (mod->packed ? 1 : 0) | (mod->shade ? 2 : 0); 
+		for(g = 0; g < mod->groupCount; g++) {
+			struct MaterialGroup *group = mod->group + g; 
+			int first = q->lod ? group->lodFirst[q->lod - 1] : group->first; 
+			int last = q->lod ? group->lodLast[q->lod - 1] : group->last; 
+			if(first >= last) continue; 
+			job->item = (struct WavefrontQueueItem *)arenaGrow(&job->arena, job->item, &job->itemMax, job->itemCount, sizeof(struct WavefrontQueueItem)); 
+			struct WavefrontQueueItem *item = job->item + job->itemCount++; 
+			item->key = wavefrontQueueKey(group->transparent, state | (group->unlit ? 4 : 0), group->image ? group->image->texid : 0, mod->queueSlot, depth); 
+			item->queued = i; 
+			item->group = g; 
+			addCullBox(&boxes, group->min, group->max, q->view); 
+		}
+	}
+	int *visible = (int *)arenaAlloc(&job->arena, sizeof(int) * (job->itemCount + 1)); 
+	int visibleCount = cullBoxes(&boxes, plane, visible); 
+	int kept = 0; 
+	for(i = 0; i < visibleCount; i++) {
+		struct WavefrontQueueItem *item = job->item + visible[i]; 
+		const struct MaterialGroup *group = queued[item->queued].mod->group + item->group; 
+		if(!occludedBox(group->min, group->max, queued[item->queued].view)) job->item[kept++] = *item; 	// in order,  so it never overwrites one still to come
+	}
+	job->culled += job->itemCount - kept; 
+	job->itemCount = kept; 
+	qsort(job->item, job->itemCount, sizeof(struct WavefrontQueueItem), cmpWavefrontQueueItem); 
+}
+
+// Runs index * 2 and index * 2 + 1,  if there is one,  into to[index],  the first on equal keys.
+static void mergeWavefrontRuns(void *arg, int index)
+{
+	const struct WavefrontQueueMerge *merge = (const struct WavefrontQueueMerge *)arg; 
+	const struct WavefrontQueueRun *a = merge->from + index * 2, *b = a + 1; 
+	struct WavefrontQueueItem *to = merge->to[index].item; 
+	int i = 0, j = 0, bCount = index * 2 + 1 < merge->fromCount ? b->count : 0; 
+	while(i < a->count && j < bCount) {
+		if(b->item[j].key < a->item[i].key) *to++ = b->item[j++]; 
+		else *to++ = a->item[i++]; 
+	}
+	memcpy(to, a->item + i, sizeof(struct WavefrontQueueItem) * (a->count - i)); 
+	to += a->count - i; 
+	if(j < bCount) memcpy(to, b->item + j, sizeof(struct WavefrontQueueItem) * (bCount - j)); 
+}
+
+// Each slice looks back at the item before it,  so they don't depend on each other.
+static void recordWavefrontCommands(void *arg, int index)
+{
+	const struct WavefrontRecord *record = (const struct WavefrontRecord *)arg; 
+	int i = (int)((long long)record->count * index / record->slices); 
+	int last = (int)((long long)record->count * (index + 1) / record->slices); 
+	for(; i < last; i++) {
+		const struct WavefrontQueueItem *item = record->item + i, *before = i ? item - 1 : 0; 
+		const struct WavefrontQueued *q = queued + item->queued; 
+		struct WavefrontCommand *command = record->command + i; 
+		command->mod = q->mod; 
+		command->matrix = !before || before->queued != item->queued ? q->draw : 0; 
+		command->arrays = !before || queued[before->queued].mod != q->mod; 
+		command->group = item->group; 
+		command->lod = q->lod; 
+	}
+}
+#endif
+
+void queueWavefront(struct WavefrontModel *model)
+{
+	if(!model) return; 
+#ifdef _PSP
+	drawWavefront(model); 	// no queue,  it goes straight out
+#else
+	struct WavefrontMesh *mod = model->mesh; 
+	float view[16]; 
+	glGetFloatv(GL_MODELVIEW_MATRIX, view); 
+	glGetFloatv(GL_PROJECTION_MATRIX, queueProjection); 
+	queued = (struct WavefrontQueued *)arenaGrow(&frameArena, queued, &queuedMax, queuedCount, sizeof(struct WavefrontQueued)); 
+	struct WavefrontQueued *q = queued + queuedCount++; 
+	q->mod = mod; 
+	multiplyMatrix(q->view, view, model->matrix); 
+	if(mod->queueFrame != queueFrame) {
+		mod->queueFrame = queueFrame; 	// models of the same mesh share a slot,  so they share the arrays
+		mod->queueSlot = queueSlotCount++; 
+	}
+#endif
+}
+
+int drawWavefrontQueue(int *binds, int *stateChanges, int *culled)
+{
+	int draws = 0, bindCount = 0, changes = 0, culledCount = 0; 
+#ifndef _PSP
+	struct WavefrontMesh *arrays = 0; 	// whose arrays are set up
+	const char *indexBase = 0; 
+	Image *bound = 0; 
+	int buffers = 0, normalized = 0; 
+	int i, count = 0; 
+	struct WavefrontShading shading, *shaded = 0; 
+
+	int jobs = wavefrontQueueThreads > 0 ? wavefrontQueueThreads : jobThreads() + 1; 
+	if(jobs > WAVEFRONT_QUEUE_JOBS) jobs = WAVEFRONT_QUEUE_JOBS; 
+	if(jobs > queuedCount) jobs = queuedCount; 
+	for(i = 0; i < jobs; i++) {
+		struct WavefrontQueueJob *job = queueJob + i; 
+		job->arena.name = "queue"; 
+		job->first = (int)((long long)queuedCount * i / jobs); 
+		job->last = (int)((long long)queuedCount * (i + 1) / jobs); 
+		job->item = 0; 
+		job->itemCount = job->itemMax = 0; 
+		job->culled = 0; 
+	}
+	runParallel(prepareWavefrontQueue, 0, jobs); 
+
+	// merged a pair of runs per job until there's one,  between two lists in frameArena.
+	struct WavefrontQueueRun *run = (struct WavefrontQueueRun *)arenaAlloc(&frameArena, sizeof(struct WavefrontQueueRun) * (jobs + 1)); 
+	int runCount = jobs; 
+	for(i = 0; i < jobs; i++) {
+		run[i].item = queueJob[i].item; 
+		run[i].count = queueJob[i].itemCount; 
+		count += queueJob[i].itemCount; 
+		culledCount += queueJob[i].culled; 
+	}
+	struct WavefrontQueueItem *list[2]; 
+	list[0] = (struct WavefrontQueueItem *)arenaAlloc(&frameArena, sizeof(struct WavefrontQueueItem) * (count + 1)); 
+	list[1] = (struct WavefrontQueueItem *)arenaAlloc(&frameArena, sizeof(struct WavefrontQueueItem) * (count + 1)); 
+	int into = 0; 
+	while(runCount > 1) {
+		struct WavefrontQueueMerge merge; 
+		int offset = 0; 
+		merge.from = run; 
+		merge.fromCount = runCount; 
+		merge.to = (struct WavefrontQueueRun *)arenaAlloc(&frameArena, sizeof(struct WavefrontQueueRun) * ((runCount + 1) / 2)); 
+		for(i = 0; i < (runCount + 1) / 2; i++) {
+			merge.to[i].item = list[into] + offset; 
+			merge.to[i].count = run[i * 2].count + (i * 2 + 1 < runCount ? run[i * 2 + 1].count : 0); 
+			offset += merge.to[i].count; 
+		}
+		runParallel(mergeWavefrontRuns, &merge, (runCount + 1) / 2); 
+		run = merge.to; 
+		runCount = (runCount + 1) / 2; 
+		into ^= 1; 
+	}
+
+	struct WavefrontRecord record; 
+	record.item = runCount ? run[0].item : 0; 
+	record.count = count; 
+	record.command = (struct WavefrontCommand *)arenaAlloc(&frameArena, sizeof(struct WavefrontCommand) * (count + 1)); 
+	record.slices = count / WAVEFRONT_QUEUE_SLICE < jobs ? count / WAVEFRONT_QUEUE_SLICE : jobs; 
+	if(record.slices < 1) record.slices = 1; 
+	if(count) runParallel(recordWavefrontCommands, &record, record.slices); 
+
+	if(count) {
+		beginWavefrontState(); 
+		shaded = beginWavefrontShading(&shading, 0, 0); 
+		glMatrixMode(GL_MODELVIEW); 
+		glPushMatrix(); 
+		changes++; 
+	}
+	for(i = 0; i < count; i++) {
+		const struct WavefrontCommand *command = record.command + i; 
+		struct WavefrontMesh *mod = command->mod; 
+		if(command->arrays) {
+			if(arrays) endWavefrontArrays(arrays, buffers); 
+			buffers = beginWavefrontArrays(mod, &indexBase); 
+			if((mod->packed != 0) != normalized) {
+				normalized = mod->packed != 0; 
+				if(normalized) glEnable(GL_NORMALIZE); 
+				else glDisable(GL_NORMALIZE); 
+			}
+			arrays = mod; 
+			changes++; 
+		}
+		if(command->matrix) {
+			glLoadMatrixf(command->matrix); 
+			changes++; 
+		}
+		bindCount += drawWavefrontGroup(mod, command->group, command->lod, indexBase, &bound, 0, shaded); 
+		draws++; 
+	}
+	if(arrays) {
+		endWavefrontArrays(arrays, buffers); 
+		if(normalized) glDisable(GL_NORMALIZE); 
+		glPopMatrix(); 
+		endWavefrontShading(shaded); 
+		if(shaded) changes += shading.switches; 
+		endWavefrontState(); 
+	}
+	// the merged lists and commands were in frameArena,  which gets them back when it's reset.
+	for(i = 0; i < jobs; i++) resetArena(&queueJob[i].arena); 
+	queued = 0; 
+	queuedCount = queuedMax = 0; 
+	queueFrame++; 
+	queueSlotCount = 0; 
+#endif
+	if(binds) *binds = bindCount; 
+	if(stateChanges) *stateChanges = changes; 
+	if(culled) *culled = culledCount; 
+	return draws; 
+}
+
+// The solid groups go into the occlusion buffer as they're placed now,  in eye space.  Packed vertices
+// are unpacked into frameArena first.  Always at full detail: the simplified levels stray from the
+// real surface by up to their lodError,  outwards as well,  and would hide things that show.
+void addWavefrontOccluder(struct WavefrontModel *model)
+{
+	if(!model || (!model->mesh->vert && !model->mesh->packed)) return; 
+#ifndef _PSP
+	struct WavefrontMesh *mod = model->mesh; 
+	float view[16], eye[16]; 
+	int g, i, k; 
+	glGetFloatv(GL_MODELVIEW_MATRIX, view); 
+	multiplyMatrix(eye, view, model->matrix); 
+	const float *position = &mod->vert->x; 
+	int stride = sizeof(struct Vertex3DTNP); 
+	if(mod->packed) {
+		float *unpacked = (float *)arenaAlloc(&frameArena, sizeof(float) * 3 * (mod->vertCount + 1)); 
+		for(i = 0; i < mod->vertCount; i++) {
+			const short *p = &mod->packed[i].x; 
+			for(k = 0; k < 3; k++) unpacked[i * 3 + k] = mod->packOffset[k] + p[k] * mod->packScale[k]; 
+		}
+		position = unpacked; 
+		stride = sizeof(float) * 3; 
+	}
+	for(g = 0; g < mod->groupCount; g++) {
+		const struct MaterialGroup *group = mod->group + g; 
+		if(group->transparent || imageSeeThrough(group->image)) continue; 	// see-through bits hide nothing
+		int first = group->first, last = group->last; 
+		if(first >= last) continue; 
+		if(mod->index) addOccluder(position, stride, (const char *)mod->index + first * mod->indexSize, mod->indexSize, last - first, eye); 
+		else addOccluder((const float *)((const char *)position + first * stride), stride, 0, 0, last - first, eye); 
+	}
+#endif
+}
+
+void setWavefrontPos(struct WavefrontModel *model, float x, float y, float z)
+{
+	if(model == 0) return; 
+	model->matrix[12] = x; 
+	model->matrix[13] = y; 
+	model->matrix[14] = z; 
+	model->matrix[0] = 1;  //6; 
+	model->matrix[5] = 1;  //6; 
+	model->matrix[10] = 1;  //6; 
+}
+
+// Vertices and indices actually drawn,  and the memory they take.
+void getWavefrontSize(struct WavefrontModel *model, int *vertCount, int *indexCount, int *bytes)
+{
+	*vertCount = model ? model->mesh->vertCount : 0; 
+	*indexCount = model ? model->mesh->indexCount : 0; 
+	*bytes = 0; 
+	if(!model) return; 
+	*bytes = model->mesh->vertCount * (int)(model->mesh->packed ? sizeof(struct Vertex3DTNPfast) : sizeof(struct Vertex3DTNP)) + model->mesh->indexCount * model->mesh->indexSize; 
+}
+
+// Draw calls and texture binds drawWavefront makes at full detail.
+int getWavefrontDraws(struct WavefrontModel *model, int *binds)
+{
+	int draws = 0; 
+	*binds = 0; 
+	if(model) countWavefrontDraws(model->mesh, &draws, binds); 
+	return draws; 
+}
+
+// The distinct textures the groups use.
+int getWavefrontImages(struct WavefrontModel *model, Image **image, int maxImages)
+{
+	int g, i, count = 0; 
+	if(!model) return 0; 
+	for(g = 0; g < model->mesh->groupCount; g++) {
+		Image *source = model->mesh->group[g].image; 
+		for(i = 0; i < count && i < maxImages && image[i] != source; i++); 
+		if(!source || i < count) continue; 
+		if(count < maxImages) image[count] = source; 
+		count++; 
+	}
+	return count; 
+}
+
+int getWavefrontLod(struct WavefrontModel *model, int level, int *triangles, float *error)
+{
+	int g; 
+	*triangles = 0; 
+	*error = 0; 
+	if(!model) return 0; 
+	for(g = 0; g < model->mesh->groupCount; g++) {
+		const struct MaterialGroup *group = model->mesh->group + g; 
+		if(level == 0) *triangles += (group->last - group->first) / 3; 
+		else if(level <= model->mesh->lodCount) *triangles += (group->lodLast[level - 1] - group->lodFirst[level - 1]) / 3; 
+	}
+	if(level > 0 && level <= model->mesh->lodCount) *error = model->mesh->lodError[level - 1]; 
+	return model->mesh->lodCount; 
+}
+
+float *getWavefrontMin(struct WavefrontModel *model)
+{
+	if(!model) return 0; 
+	return model->mesh->min; 
+}
+
+float *getWavefrontMax(struct WavefrontModel *model)
+{
+	if(!model) return 0; 
+	return model->mesh->max; 
+}
+
+float *getWavefrontMatrix(struct WavefrontModel *model)
+{
+	if(!model) return 0; 
+	return model->matrix; 
+}
+
+// Collision queries run on a BVH of the full detail triangles,  in model space.  It's built the first
+// time one is asked for,  from the packed vertices if the floats have gone.
+static struct Bvh *getWavefrontBvh(struct WavefrontMesh *mod)
+{
+	if(mod->bvh) return mod->bvh; 
+	int g, i, k, count = 0; 
+	for(g = 0; g < mod->groupCount; g++) if(count < mod->group[g].last) count = mod->group[g].last; 
+	unsigned int *index = (unsigned int *)malloc(sizeof(unsigned int) * (count > 0 ? count : 1)); 
+	for(i = 0; i < count; i++) {
+		if(!mod->index) index[i] = i; 
+		else if(mod->indexSize == 2) index[i] = ((unsigned short *)mod->index)[i]; 
+		else index[i] = ((unsigned int *)mod->index)[i]; 
+	}
+	float *position = 0; 
+	if(mod->packed) {
+		position = (float *)malloc(sizeof(float) * 3 * (mod->vertCount > 0 ? mod->vertCount : 1)); 
+		for(i = 0; i < mod->vertCount; i++) {
+			const short *p = &mod->packed[i].x; 
+			for(k = 0; k < 3; k++) position[i * 3 + k] = mod->packOffset[k] + p[k] * mod->packScale[k]; 
+		}
+	}
+	mod->bvh = (struct Bvh *)malloc(sizeof(struct Bvh)); 
+	if(position) buildBvh(mod->bvh, index, count, position, sizeof(float) * 3); 
+	else buildBvh(mod->bvh, index, count, &mod->vert->x, sizeof(struct Vertex3DTNP)); 
+	printf("bvh for %s: %d triangles,  %d nodes\n", mod->name, mod->bvh->triCount, mod->bvh->nodeCount); 
+	free(position); 
+	free(index); 
+	return mod->bvh; 
+}
+
+int castWavefrontRay(struct WavefrontModel *model, const struct BvhRay *ray, struct BvhHit *hit)
+{
+	hit->triangle = -1; 
+	if(!model) return 0; 
+	return bvhRayNearest(getWavefrontBvh(model->mesh), ray, hit); 
+}
+
+int castWavefrontRays(struct WavefrontModel *model, const struct BvhRay *ray, int count, struct BvhHit *hit, int any)
+{
+	int i; 
+	if(!model) {
+		for(i = 0; i < count; i++) hit[i].triangle = -1; 
+		return 0; 
+	}
+	return bvhRayBatch(getWavefrontBvh(model->mesh), ray, count, hit, any); 
+}
+
+int overlapWavefrontSphere(struct WavefrontModel *model, const float *center, float radius, int *triangle, int maxTriangles)
+{
+	if(!model) return 0; 
+	return bvhOverlapSphere(getWavefrontBvh(model->mesh), center, radius, triangle, maxTriangles); 
+}
+
+int overlapWavefrontBox(struct WavefrontModel *model, const float *min, const float *max, int *triangle, int maxTriangles)
+{
+	if(!model) return 0; 
+	return bvhOverlapBox(getWavefrontBvh(model->mesh), min, max, triangle, maxTriangles); 
+}
+
+int sweepWavefrontSphere(struct WavefrontModel *model, const struct BvhRay *path, float radius, struct BvhHit *hit)
 {
+	hit->triangle = -1; 
 	if(!model) return 0; 
-	return model->max; 
+	return bvhSweepSphere(getWavefrontBvh(model->mesh), path, radius, hit); 
 }
@@ -4,10 +4,54 @@
 #define WAVEFRONT_H
 
 // wavefront.c
+#define WAVEFRONT_LEGACY_PARSER 1	// original two pass fgets/sscanf parser, for comparison
+#define WAVEFRONT_NO_TEXTURES 2	// don't load the map_Kd images
+#define WAVEFRONT_NO_MMAP 4	// stream the obj with buffered reads instead of mapping it
+#define WAVEFRONT_NO_CACHE 8	// always parse the obj, don't read or write the .mesh cache
+#define WAVEFRONT_NO_INDEX 16	// keep one vertex per triangle corner instead of indexing shared ones
+#define WAVEFRONT_NO_OPTIMIZE 32	// index the triangles in file order, skip the vertex cache and overdraw reordering
+#define WAVEFRONT_QUANTIZE 64	// keep the vertices as 14 byte Vertex3DTNPfast instead of 32 byte floats
+#define WAVEFRONT_LODS 128	// also build simplified levels of detail to draw when the model is small on screen
+#define WAVEFRONT_NO_MERGE 256	// keep a group per usemtl in file order instead of one per texture, sorted for drawing
+#define WAVEFRONT_ATLAS 512	// pack the textures into atlases so the model draws in a call or two, skips the .mesh cache
+#define WAVEFRONT_OCCLUSION 1024	// bake ambient occlusion into a colour per vertex on the job threads, kept in the .mesh cache, GL only
+extern int wavefrontLoadFlags;	// WAVEFRONT_* options used by loadWavefront
+extern int wavefrontLoadThreads;	// threads to parse a mapped obj with, 0 = one per core
+extern int wavefrontQueueThreads;	// jobs drawWavefrontQueue culls, sorts and records on, 0 = one per core, 1 = all on the GL thread
+extern float wavefrontLodBias;	// pixels of simplification error allowed on screen, 0 always draws full detail
+extern int wavefrontLodLevel;	// -1 picks levels by screen size, otherwise always draw this one
+extern int wavefrontUseBuffers;	// 1 = draw from buffer objects once they're streamed in, 0 = always from the client arrays
+extern int wavefrontUseInstancing;	// 1 = drawWavefrontInstances uses hardware instancing where there is some, 0 = always batches them
+extern int wavefrontUseShaders;	// 1 = draws with a shader per lighting, texturing and alpha test mix where GL has them, 0 = fixed function
 struct WavefrontModel;
-struct WavefrontModel *loadWavefront(const char *fname);
-void freeWavefront(struct WavefrontModel *model);
+struct WavefrontModel *loadWavefront(const char *fname);	// a new model with its own matrix each call, the mesh is shared with others loaded with the same flags
+void freeWavefront(struct WavefrontModel *model);	// the mesh and textures stay while other models use them
+int reloadWavefrontFile(const char *path);	// a changed .obj, .mtl or .png, reparses what uses it in place on the GL thread, returns how many models and images changed
+struct WavefrontLoad;
+struct WavefrontLoad *loadWavefrontAsync(const char *fname);	// loads on a job thread with wavefrontLoadFlags as they are now, later changes don't reach it
+int pollWavefrontLoads();	// call each frame on the GL thread, queues finished models' textures for runUploads, returns how many are still loading
+struct WavefrontModel *finishWavefrontLoad(struct WavefrontLoad **load);	// 0 until it's ready, then the model and *load is cleared
 void setWavefrontPos(struct WavefrontModel *model, float x, float y, float z);
 void drawWavefront(struct WavefrontModel *model);
 void drawWavefrontPartial(struct WavefrontModel *mod, int transparent);	// 0 = solid, 1 = trans, 3 = both
+void queueWavefront(struct WavefrontModel *model);	// adds it to the render queue as it's placed now, for drawWavefrontQueue
+int drawWavefrontQueue(int *binds, int *stateChanges, int *culled);	// culls everything queued to the frustum and any occluders, sorts it by state, texture and depth and records the draws on the job threads, then replays them, returns the draws
+void addWavefrontOccluder(struct WavefrontModel *model);	// rasterizes its solid groups at full detail into the occlusion buffer as it's placed now, see hiz.h
+int checkWavefrontFaces();	// parses faces with every corner form serially and split between threads, returns how many checks failed
+int loadWavefrontShaders(int useCache);	// builds the shaders now rather than at the first draw, from binaries saved in models/ when useCache is 1, returns how many built
+void drawWavefrontInstances(struct WavefrontModel *model, const float *matrix, const Color *color, int count);	// 16 floats per instance in place of the model's matrix, color tints each, 0 for none
+int getWavefrontLod(struct WavefrontModel *model, int level, int *triangles, float *error);	// returns how many simplified levels there are
+void getWavefrontSize(struct WavefrontModel *model, int *vertCount, int *indexCount, int *bytes);	// indexCount is 0 if not indexed
+int getWavefrontDraws(struct WavefrontModel *model, int *binds);	// draw calls and texture binds drawWavefront makes at full detail
+int getWavefrontImages(struct WavefrontModel *model, Image **image, int maxImages);	// distinct textures, returns how many even past maxImages
+float *getWavefrontMin(struct WavefrontModel *model);	// bounding box, model space
+float *getWavefrontMax(struct WavefrontModel *model);
+float *getWavefrontMatrix(struct WavefrontModel *model);	// 16 floats, column major like GL
+struct BvhRay;
+struct BvhHit;
+int castWavefrontRay(struct WavefrontModel *model, const struct BvhRay *ray, struct BvhHit *hit);	// nearest hit in model space, see bvh.h
+int castWavefrontRays(struct WavefrontModel *model, const struct BvhRay *ray, int count, struct BvhHit *hit, int any);	// returns how many hit
+int overlapWavefrontSphere(struct WavefrontModel *model, const float *center, float radius, int *triangle, int maxTriangles);	// returns the number touching
+int overlapWavefrontBox(struct WavefrontModel *model, const float *min, const float *max, int *triangle, int maxTriangles);
+int sweepWavefrontSphere(struct WavefrontModel *model, const struct BvhRay *path, float radius, struct BvhHit *hit);	// first contact along path
 #endif